@@ -8,11 +8,15 @@ LOCAL_DESCRIPTION := Video scaling library
 LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/include
 LOCAL_CFLAGS := -DVSCALE_API_EXPORTS -fvisibility=hidden -std=gnu99
 LOCAL_SRC_FILES := \
-	src/vscale.c
+	src/vscale.c \
+	src/vscale_calib.c
 LOCAL_LIBRARIES := \
+	libfutils \
 	libpomp \
 	libulog \
 	libmedia-buffers \
+	libmedia-buffers-memory \
+	libmedia-buffers-memory-generic \
 	libvideo-defs \
 	libvideo-scale-core
 LOCAL_CONFIG_FILES := config.in
@@ -20,7 +24,8 @@ $(call load-config)
 LOCAL_CONDITIONAL_LIBRARIES := \
 	CONFIG_VSCALE_HISI:libvideo-scale-hisi \
 	CONFIG_VSCALE_QCOM:libvideo-scale-qcom \
-	CONFIG_VSCALE_LIBYUV:libvideo-scale-libyuv
+	CONFIG_VSCALE_LIBYUV:libvideo-scale-libyuv \
+	CONFIG_VSCALE_GENERIC:libvideo-scale-generic
 LOCAL_EXPORT_LDLIBS := -lvideo-scale-core
 include $(BUILD_LIBRARY)
 
@@ -33,12 +38,22 @@ LOCAL_DESCRIPTION := Video scaling library: core files
 LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/core/include
 LOCAL_CFLAGS := -DVSCALE_API_EXPORTS -fvisibility=hidden -std=gnu99
 LOCAL_SRC_FILES := \
+	core/src/vscale_color.c \
 	core/src/vscale_core.c \
-	core/src/vscale_enums.c
+	core/src/vscale_enums.c \
+	core/src/vscale_fit.c \
+	core/src/vscale_mem.c \
+	core/src/vscale_numa.c \
+	core/src/vscale_orient.c \
+	core/src/vscale_roi.c \
+	core/src/vscale_tensor.c \
+	core/src/vscale_warp.c
 LOCAL_LIBRARIES := \
 	libfutils \
 	libulog \
 	libmedia-buffers \
+	libmedia-buffers-memory \
+	libmedia-buffers-memory-generic \
 	libvideo-defs
 include $(BUILD_LIBRARY)
 
@@ -64,6 +79,31 @@ LOCAL_LIBRARIES := \
 	libyuv
 include $(BUILD_LIBRARY)
 
+# Generic implementation (C and SIMD kernels); can be enabled in the product
+# configuration
+include $(CLEAR_VARS)
+LOCAL_MODULE := libvideo-scale-generic
+LOCAL_CATEGORY_PATH := libs
+LOCAL_DESCRIPTION := Video scaling library: generic implementation
+LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)/generic/include
+LOCAL_CFLAGS := -DVSCALE_API_EXPORTS -fvisibility=hidden -std=gnu11
+LOCAL_SRC_FILES := \
+	generic/src/vscale_generic.c \
+	generic/src/vscale_generic_kernels.c \
+	generic/src/vscale_generic_neon.c \
+	generic/src/vscale_generic_x86.c
+LOCAL_LIBRARIES := \
+	libfutils \
+	libmedia-buffers \
+	libmedia-buffers-memory \
+	libmedia-buffers-memory-generic \
+	libpomp \
+	libulog \
+	libvideo-defs \
+	libvideo-metadata \
+	libvideo-scale-core
+include $(BUILD_LIBRARY)
+
 # Scaling program
 include $(CLEAR_VARS)
 LOCAL_MODULE := vscale
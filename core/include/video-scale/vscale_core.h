@@ -51,23 +51,61 @@ extern "C" {
 
 
 /**
- * mbuf ancillary data key for the input timestamp.
+ * mbuf ancillary data key for the scaler timestamps.
  *
- * Content is a 64bits microseconds value on a monotonic clock
+ * Content is a struct vscale_timestamps; on input frames only the
+ * input_time field is set
  */
-#define VSCALE_ANCILLARY_KEY_INPUT_TIME "vscale.input_time"
+#define VSCALE_ANCILLARY_KEY_TIMESTAMPS "vscale.timestamps"
+
+
+/**
+ * Deprecated mbuf ancillary data key for the input timestamp, now an alias
+ * of VSCALE_ANCILLARY_KEY_TIMESTAMPS; use vscale_frame_get_timestamps()
+ * instead.
+ *
+ * Content starts with the 64bits microseconds input_time field of struct
+ * vscale_timestamps, so that readers of a single 64bits value still get the
+ * input timestamp. The former dequeue and output timestamp keys have no
+ * such alias, since the other fields are not at the start of the content:
+ * their readers must use vscale_frame_get_timestamps()
+ */
+#define VSCALE_ANCILLARY_KEY_INPUT_TIME VSCALE_ANCILLARY_KEY_TIMESTAMPS
+
+
 /**
- * mbuf ancillary data key for the dequeue timestamp.
+ * mbuf ancillary data key for the scaler per-frame stage timings.
  *
- * Content is a 64bits microseconds value on a monotonic clock
+ * Content is a struct vscale_timings; only set on output frames when
+ * config.timings is true
  */
-#define VSCALE_ANCILLARY_KEY_DEQUEUE_TIME "vscale.dequeue_time"
+#define VSCALE_ANCILLARY_KEY_TIMINGS "vscale.timings"
+
+
 /**
- * mbuf ancillary data key for the output timestamp.
+ * mbuf ancillary data key for the regions of interest of an input frame.
  *
- * Content is a 64bits microseconds value on a monotonic clock
+ * Content is an array of struct vdef_rect in input frame coordinates (see
+ * vscale_frame_set_rois()); it is not copied to the output frames
  */
-#define VSCALE_ANCILLARY_KEY_OUTPUT_TIME "vscale.output_time"
+#define VSCALE_ANCILLARY_KEY_ROIS "vscale.rois"
+
+
+/**
+ * mbuf ancillary data key for the region of interest of an output frame.
+ *
+ * Content is a struct vscale_roi
+ */
+#define VSCALE_ANCILLARY_KEY_ROI "vscale.roi"
+
+
+/**
+ * mbuf ancillary data key for the warp of an input frame.
+ *
+ * Content is a struct vscale_warp followed by its mesh, if any (see
+ * vscale_frame_set_warp()); it is not copied to the output frames
+ */
+#define VSCALE_ANCILLARY_KEY_WARP "vscale.warp"
 
 
 /* Forward declarations */
@@ -76,7 +114,9 @@ struct vscale_scaler;
 
 /* Supported scaling implementations */
 enum vscale_scaler_implem {
-	/* Automatically select scaler */
+	/* Automatically select scaler: when several implementations support
+	 * the configuration, the fastest one is selected by running a short
+	 * calibration on first use (see vscale_get_used_implem()) */
 	VSCALE_SCALER_IMPLEM_AUTO = 0,
 
 	/* 'libyuv' scaler implementation */
@@ -87,6 +127,9 @@ enum vscale_scaler_implem {
 
 	/* Qualcomm scaler implementation */
 	VSCALE_SCALER_IMPLEM_QCOM,
+
+	/* Generic CPU scaler implementation (built-in C/SIMD kernels) */
+	VSCALE_SCALER_IMPLEM_GENERIC,
 };
 
 
@@ -109,6 +152,220 @@ enum vscale_filter_mode {
 };
 
 
+/* Scaler timestamps ancillary data
+ * (64bits microseconds values on a monotonic clock) */
+struct vscale_timestamps {
+	/* Input timestamp: frame accepted by the input queue; must stay the
+	 * first field (see VSCALE_ANCILLARY_KEY_INPUT_TIME) */
+	uint64_t input_time;
+
+	/* Dequeue timestamp: frame dequeued by the scaler */
+	uint64_t dequeue_time;
+
+	/* Output timestamp: output frame complete */
+	uint64_t output_time;
+};
+
+
+/* Scaling stages of an input frame */
+enum vscale_stage {
+	/* Output memory allocation (output buffer pool or callback
+	 * function) */
+	VSCALE_STAGE_ALLOC = 0,
+
+	/* Input frame parsing and input and output planes mapping */
+	VSCALE_STAGE_MAP,
+
+	/* Scaling, including the color or tensor conversion and the
+	 * slices output */
+	VSCALE_STAGE_SCALE,
+
+	/* Input ancillary data and metadata copy to the output frame */
+	VSCALE_STAGE_COPY,
+
+	/* Output frame creation and scaler ancillary data (not the output
+	 * frame finalization and output, which happen after the timings are
+	 * attached to the frame) */
+	VSCALE_STAGE_OUTPUT,
+
+	/* Number of stages */
+	VSCALE_STAGE_COUNT,
+};
+
+
+/* Scaler per-frame stage timings ancillary data (64bits microseconds
+ * values): for each stage, wall time on a monotonic clock and CPU time of
+ * the scaling thread (CLOCK_THREAD_CPUTIME_ID); the work of the other
+ * scaling threads is not included in the CPU time, a CPU time much lower
+ * than the wall time means that the scaling thread was waiting for them
+ * or was not scheduled. The output frames of the regions of interest of
+ * an input frame carry the timings of the input frame up to their own
+ * output, the allocation being shared. */
+struct vscale_timings {
+	struct {
+		uint64_t wall_time;
+		uint64_t cpu_time;
+	} stage[VSCALE_STAGE_COUNT];
+};
+
+
+/* Region of interest of an output frame */
+struct vscale_roi {
+	/* Index of the region in the input frame regions (after the
+	 * invalid regions are dropped) */
+	unsigned int index;
+
+	/* Number of regions, i.e. output frames, of the input frame */
+	unsigned int count;
+
+	/* Cropped region in input frame coordinates, aligned on even
+	 * offsets and dimensions and clipped to the frame */
+	struct vdef_rect rect;
+
+	/* Output frames of an input frame are packed back to back in one
+	 * buffer: offset of this output frame in the buffer, and size of
+	 * each output frame in bytes */
+	size_t offset;
+	size_t size;
+};
+
+
+/* Input warp types */
+enum vscale_warp_type {
+	/* No warp (default) */
+	VSCALE_WARP_TYPE_NONE = 0,
+
+	/* Affine transform */
+	VSCALE_WARP_TYPE_AFFINE,
+
+	/* Mesh of source positions, bilinearly interpolated */
+	VSCALE_WARP_TYPE_MESH,
+};
+
+
+/* Input warp, e.g. for electronic image stabilization or lens distortion
+ * correction: the input frame is resampled through the warp while it is
+ * scaled. The warp maps each position (x, y) of the warped input frame to
+ * the position (sx, sy) of the input frame it is sampled from, in input
+ * luma pixel coordinates (pixel centers on integer values); positions
+ * outside of the input frame are clamped to its edges */
+struct vscale_warp {
+	enum vscale_warp_type type;
+
+	/* Affine transform: sx = matrix[0] * x + matrix[1] * y + matrix[2]
+	 * and sy = matrix[3] * x + matrix[4] * y + matrix[5] */
+	float matrix[6];
+
+	/* Mesh: mesh_cols x mesh_rows nodes (at least 2 x 2) evenly spread
+	 * over the input frame, the first and last ones on its border
+	 * pixels; mesh holds the (sx, sy) positions of the nodes, row after
+	 * row */
+	unsigned int mesh_cols;
+	unsigned int mesh_rows;
+	const float *mesh;
+};
+
+
+/* Memory types */
+enum vscale_mem_type {
+	/* Heap memory (default) */
+	VSCALE_MEM_TYPE_GENERIC = 0,
+
+	/* Sealed memfd memory, mappable by other processes; the memfd
+	 * description of output frames is set in the VSCALE_ANCILLARY_KEY_MEMFD
+	 * ancillary data (see vscale_mem.h) */
+	VSCALE_MEM_TYPE_MEMFD,
+
+	/* Memory backed by 2 MiB huge pages, reducing TLB misses on large
+	 * frames: explicit huge pages (MAP_HUGETLB) when some are reserved,
+	 * otherwise transparent huge pages (MADV_HUGEPAGE), otherwise regular
+	 * pages */
+	VSCALE_MEM_TYPE_HUGE_PAGES,
+};
+
+
+/* NUMA placement policies */
+enum vscale_numa_policy {
+	/* No NUMA placement (default) */
+	VSCALE_NUMA_POLICY_NONE = 0,
+
+	/* Place the scaling thread and the output buffers on the NUMA node
+	 * of the first input frame memory */
+	VSCALE_NUMA_POLICY_AUTO,
+
+	/* Place the scaling thread and the output buffers on a given
+	 * NUMA node */
+	VSCALE_NUMA_POLICY_NODE,
+};
+
+
+/* Output orientations, applied to the scaled image */
+enum vscale_orientation {
+	/* No rotation nor mirror (default) */
+	VSCALE_ORIENTATION_NORMAL = 0,
+
+	/* 90 degrees clockwise rotation */
+	VSCALE_ORIENTATION_ROTATE_90,
+
+	/* 180 degrees rotation */
+	VSCALE_ORIENTATION_ROTATE_180,
+
+	/* 270 degrees clockwise rotation */
+	VSCALE_ORIENTATION_ROTATE_270,
+
+	/* Horizontal mirror (left and right swapped) */
+	VSCALE_ORIENTATION_MIRROR_H,
+
+	/* Vertical mirror (top and bottom swapped) */
+	VSCALE_ORIENTATION_MIRROR_V,
+};
+
+
+/* Fit modes, when the input and output aspect ratios differ */
+enum vscale_fit_mode {
+	/* The input is stretched to the output resolution (default) */
+	VSCALE_FIT_MODE_STRETCH = 0,
+
+	/* The whole input is scaled to fit in the output, which is padded
+	 * with the pad color above and below or on the sides */
+	VSCALE_FIT_MODE_FIT,
+
+	/* The input is scaled to fill the whole output, its sides or top
+	 * and bottom are cropped */
+	VSCALE_FIT_MODE_FILL,
+};
+
+
+/* Tensor output formats, for machine learning preprocessing; tensors are
+ * RGB frames converted from the scaled YUV frames with the input color
+ * matrix and range, float samples are in the host byte order */
+enum vscale_tensor_format {
+	/* No tensor, YUV output in the input format (default) */
+	VSCALE_TENSOR_FORMAT_NONE = 0,
+
+	/* Packed 8-bit RGB (vdef_rgb) */
+	VSCALE_TENSOR_FORMAT_RGB8,
+
+	/* Planar 8-bit RGB (vscale_rgb_planar) */
+	VSCALE_TENSOR_FORMAT_RGB8_PLANAR,
+
+	/* Planar half precision float RGB, normalized
+	 * (vscale_rgb_planar_f16) */
+	VSCALE_TENSOR_FORMAT_RGB_F16_PLANAR,
+
+	/* Planar single precision float RGB, normalized
+	 * (vscale_rgb_planar_f32) */
+	VSCALE_TENSOR_FORMAT_RGB_F32_PLANAR,
+};
+
+
+/* Planar RGB raw formats of the tensor outputs (the sample size tells the
+ * float formats apart from the 8-bit format) */
+VSCALE_API extern const struct vdef_raw_format vscale_rgb_planar;
+VSCALE_API extern const struct vdef_raw_format vscale_rgb_planar_f16;
+VSCALE_API extern const struct vdef_raw_format vscale_rgb_planar_f32;
+
+
 /* Scaler initial configuration, implementation specific extension
  * Each implementation might provide implementation specific configuration with
  * a structure compatible with this base structure (i.e. which starts with the
@@ -133,11 +390,32 @@ struct vscale_config {
 	 * lower filtering mode */
 	enum vscale_filter_mode filter_mode;
 
+	/* Adaptive filtering mode (optional): if true, filter_mode is the
+	 * highest quality mode used; the scaler steps down to lower quality
+	 * modes when the scaling time exceeds the frame interval (computed
+	 * from the input frames timestamps) and back up when there is
+	 * enough headroom; only relevant for CPU scaling implementations */
+	bool adaptive_filter_mode;
+
 	/* Preferred scaling thread count (0 means no preference,
-	 * use the default value; 1 means no multi-threading;
-	 * only relevant for CPU scaling implementations) */
+	 * use the default value; 1 means no multi-threading; 2 or more
+	 * scales the luma and chroma planes concurrently; only relevant
+	 * for CPU scaling implementations) */
 	uint32_t preferred_thread_count;
 
+	/* Pre-warm the scaler (optional): the output buffers are allocated
+	 * and their pages touched, and a dummy frame is scaled with the
+	 * configured geometry on the scaling threads before vscale_new()
+	 * returns, so that the first frames do not pay for the lazy
+	 * initializations; vscale_new() takes longer */
+	bool prewarm;
+
+	/* Per-frame timings (optional): if true, the output frames carry
+	 * VSCALE_ANCILLARY_KEY_TIMINGS ancillary data with the wall and CPU
+	 * time of each scaling stage (see vscale_frame_get_timings()); only
+	 * relevant for CPU scaling implementations */
+	bool timings;
+
 	/* Input configuration */
 	struct {
 		/* Input buffer pool preferred minimum buffer count, used
@@ -150,6 +428,50 @@ struct vscale_config {
 
 		/* Input format information (width and height are mandatory) */
 		struct vdef_format_info info;
+
+		/* Progressive input (optional): if true, input frames can be
+		 * pushed before being complete, e.g. as soon as the first
+		 * slice is available; the producer then reports the number
+		 * of available rows with vscale_set_input_rows(), and the
+		 * scaler only reads source rows reported as available */
+		bool progressive;
+
+		/* Frame rate decimation (optional): input frames are
+		 * rejected by the input queue filter from their timestamps,
+		 * before any scaling work; the first frame is always kept;
+		 * rejected frames make mbuf_raw_video_frame_queue_push()
+		 * fail (see vscale_is_decimated()), and are counted in the
+		 * decimated_count statistics */
+		struct {
+			/* Target output frame rate (optional, a null
+			 * numerator means no target); the kept frames
+			 * follow the target period, with a timestamp jitter
+			 * tolerance of 1/8 of the period */
+			struct vdef_frac framerate;
+
+			/* Keep one input frame in every keep_one_in input
+			 * frames (optional, 0 or 1 means all frames) */
+			unsigned int keep_one_in;
+
+			/* Minimum interval between the timestamps of the
+			 * kept frames in microseconds (optional, 0 means no
+			 * minimum) */
+			uint64_t min_interval_us;
+		} decimation;
+
+		/* Input warp (optional, zero-filled means none), applied to
+		 * the input frames without VSCALE_ANCILLARY_KEY_WARP ancillary
+		 * data (see vscale_frame_set_warp()); the mesh is copied
+		 * internally; only supported by the generic implementation,
+		 * and not applied to regions of interest */
+		struct vscale_warp warp;
+
+		/* Input frames can carry their own warp (see
+		 * vscale_frame_set_warp()); only supported by the generic
+		 * implementation, which VSCALE_SCALER_IMPLEM_AUTO then
+		 * selects; the other implementations reject the frames with
+		 * a warp */
+		bool frame_warps;
 	} input;
 	struct {
 		/* Output buffer pool preferred minimum buffer count, used
@@ -158,13 +480,110 @@ struct vscale_config {
 		size_t preferred_min_buf_count;
 
 		/* Preferred output buffers data format (optional,
-		 * can be zero-filled) */
+		 * can be zero-filled); vdef_gray selects the luma-only
+		 * output: only the luma plane is scaled, into single-plane
+		 * gray frames, and the chroma planes are neither processed
+		 * nor allocated (ignored with tensor output); other formats
+		 * are currently ignored */
 		struct vdef_raw_format preferred_format;
 
-		/* Output format information (width and height are mandatory) */
+		/* Output format information (width and height are mandatory);
+		 * if info.matrix_coefs is not VDEF_MATRIX_COEFS_UNKNOWN, the
+		 * output is converted from the input color matrix and range
+		 * (BT.601 if unknown) to info.matrix_coefs and
+		 * info.full_range while scaling, otherwise the output frames
+		 * keep the input color properties; identity (GBR) matrices
+		 * are not supported */
 		struct vdef_format_info info;
+
+		/* Output slice height in lines (optional, 0 means no slices):
+		 * when not 0, the output frame is scaled in horizontal slices
+		 * of (at least) this height, published through the
+		 * slice_output callback function as soon as they are scaled;
+		 * the height can be rounded up by the implementation so
+		 * that slices boundaries fall on whole source lines */
+		unsigned int slice_height;
+
+		/* Output buffers memory type (optional, 0 means heap memory);
+		 * buffers other than heap memory are pooled and reused */
+		enum vscale_mem_type mem_type;
+
+		/* Output orientation (optional, 0 means none); info.resolution
+		 * is the oriented resolution, i.e. the input is scaled to
+		 * height x width before a 90 or 270 degrees rotation; only
+		 * NORMAL and MIRROR_H are compatible with slices, other
+		 * orientations scale the whole frame at once; the libyuv
+		 * implementation only supports NORMAL and MIRROR_V */
+		enum vscale_orientation orientation;
+
+		/* Fit mode (optional, 0 means stretch); pixels are assumed
+		 * to be square, and the aspect ratio is the one before the
+		 * orientation is applied */
+		enum vscale_fit_mode fit_mode;
+
+		/* Pad color for VSCALE_FIT_MODE_FIT as 0xRRGGBB (optional,
+		 * 0 means black), converted with the output color matrix
+		 * and range */
+		uint32_t pad_color;
+
+		/* Sharpening strength (optional, 0 means none, must not be
+		 * negative): the scaled luma is unsharp masked as it is
+		 * scaled, each pixel getting strength times its difference
+		 * with the average of its 4 neighbours (values from 0.25 to
+		 * 1 suit downscaled previews, the strength is clamped
+		 * below 4); only supported by the generic implementation,
+		 * and not applied to warped frames */
+		float sharpen;
+
+		/* Tensor output (optional, 0 means none); the tensor has the
+		 * output resolution, and info.matrix_coefs is ignored */
+		struct {
+			enum vscale_tensor_format format;
+
+			/* Float tensors normalization of the R, G and B
+			 * channels: (v - mean) * scale, with v in [0, 255]
+			 * (optional, a 0 scale means 1) */
+			float mean[3];
+			float scale[3];
+		} tensor;
+
+		/* Maximum number of regions of interest per input frame
+		 * (optional, 0 means no regions of interest): each region
+		 * of an input frame with VSCALE_ANCILLARY_KEY_ROIS ancillary
+		 * data is cropped and scaled to its own output frame (or
+		 * tensor) with the output resolution, fit mode and
+		 * orientation; the output frames of an input frame share one
+		 * buffer and carry VSCALE_ANCILLARY_KEY_ROI ancillary data;
+		 * slices are not used for regions of interest, and input
+		 * frames without regions are scaled whole */
+		unsigned int max_rois;
+
+		/* Output buffer pool (optional, can be NULL): when not NULL
+		 * and no get_output_mem callback function is provided, the
+		 * output frames are scaled into buffers taken from this pool,
+		 * which must be large enough for the output frames of all the
+		 * regions of interest of a frame; mem_type is ignored */
+		struct mbuf_pool *pool;
+
+		/* Output planes stride and scanline (rows count) alignments
+		 * (optional, 0 or 1 means no alignment): the output frame
+		 * planes are contiguous, each plane stride is rounded up to a
+		 * multiple of plane_stride_align[i] bytes and its size to a
+		 * multiple of plane_scanline_align[i] strides; the padding
+		 * bytes are left unset; not used for tensors */
+		unsigned int plane_stride_align[VDEF_RAW_MAX_PLANE_COUNT];
+		unsigned int plane_scanline_align[VDEF_RAW_MAX_PLANE_COUNT];
 	} output;
 
+	/* NUMA placement (optional, ignored on single-node machines) */
+	struct {
+		/* Placement policy */
+		enum vscale_numa_policy policy;
+
+		/* NUMA node, if policy is VSCALE_NUMA_POLICY_NODE */
+		unsigned int node;
+	} numa;
+
 	/* Implementation specific extensions (optional, can be NULL)
 	 * If not null, implem_cfg must match the following requirements:
 	 *  - this->implem_cfg->implem == this->implem
@@ -191,6 +610,26 @@ struct vscale_input_buffer_constraints {
 };
 
 
+/* Scaler statistics */
+struct vscale_stats {
+	/* Number of scaled frames */
+	uint64_t frame_count;
+
+	/* Average scaling time per frame in microseconds */
+	uint32_t scale_time_us;
+
+	/* Filtering mode in use (can change over time if the adaptive
+	 * filtering mode is enabled) */
+	enum vscale_filter_mode filter_mode;
+
+	/* Number of filtering mode changes (adaptive filtering mode) */
+	unsigned int filter_mode_changes;
+
+	/* Number of input frames rejected by the frame rate decimation */
+	uint64_t decimated_count;
+};
+
+
 /* Scaler callback functions */
 struct vscale_cbs {
 	/* Frame output callback function (mandatory)
@@ -198,7 +637,9 @@ struct vscale_cbs {
 	 * application must reference it if needed after returning from the
 	 * callback function. The status is 0 in case of success, a negative
 	 * errno otherwise. In case of error no frame is output and frame
-	 * is NULL.
+	 * is NULL; the function is called once per failed input frame.
+	 * An input frame can produce several output frames (see
+	 * output.max_rois), all with the timestamp of the input frame.
 	 * @param scaler: scaler instance handle
 	 * @param status: frame output status
 	 * @param frame: scaler output frame
@@ -208,6 +649,69 @@ struct vscale_cbs {
 			     struct mbuf_raw_video_frame *frame,
 			     void *userdata);
 
+	/* Direct frame output callback function (optional)
+	 * When defined, each output frame is passed to this function from
+	 * the scaling thread as soon as it is finalized, instead of being
+	 * passed to the frame_output callback function through the
+	 * pomp_loop (e.g. to push it directly into the input queue of the
+	 * next element); frame_output is then only called for errors, and
+	 * the pomp_loop only for flush and stop notifications. Frames
+	 * output this way are no longer discarded by vscale_flush(). The
+	 * library retains ownership of the output buffer and the
+	 * application must reference it if needed after returning from the
+	 * callback function.
+	 * @warning this function is called from the scaling thread
+	 * @param scaler: scaler instance handle
+	 * @param frame: scaler output frame
+	 * @param userdata: user data pointer */
+	void (*frame_output_direct)(struct vscale_scaler *scaler,
+				    struct mbuf_raw_video_frame *frame,
+				    void *userdata);
+
+	/* Output memory allocation callback function (optional)
+	 * When defined, the scaler calls this function to get the memory
+	 * the next output frame is scaled into, instead of allocating it;
+	 * this allows writing directly to caller-provided buffers (e.g. a
+	 * memory-mapped file). The memory must be at least size bytes long;
+	 * the planes are tightly packed as described by frame_info. With
+	 * regions of interest, the memory holds the output frames of all
+	 * the regions of the input frame back to back. The output frame
+	 * takes its own reference on the memory. In case of
+	 * error the frame is dropped and the error is reported through the
+	 * frame_output callback function.
+	 * @warning this function is called from the scaling thread
+	 * @param scaler: scaler instance handle
+	 * @param frame_info: output frame information
+	 * @param size: required memory size in bytes
+	 * @param mem: memory to scale the frame into (output)
+	 * @param userdata: user data pointer
+	 * @return 0 on success, negative errno value in case of error */
+	int (*get_output_mem)(struct vscale_scaler *scaler,
+			      const struct vdef_raw_frame *frame_info,
+			      size_t size,
+			      struct mbuf_mem **mem,
+			      void *userdata);
+
+	/* Output slice callback function (optional, only used if
+	 * output.slice_height is not 0)
+	 * Called each time a slice of an output frame is scaled: the luma
+	 * lines [y, y + height) and the corresponding chroma lines of the
+	 * planes are complete. The frame itself is output through the
+	 * frame_output callback function once all slices are scaled.
+	 * @warning this function is called from the scaling thread
+	 * @param scaler: scaler instance handle
+	 * @param frame_info: output frame information
+	 * @param planes: output frame planes
+	 * @param y: first complete line
+	 * @param height: number of complete lines
+	 * @param userdata: user data pointer */
+	void (*slice_output)(struct vscale_scaler *scaler,
+			     const struct vdef_raw_frame *frame_info,
+			     const uint8_t *const *planes,
+			     unsigned int y,
+			     unsigned int height,
+			     void *userdata);
+
 	/* Flush callback function, called when flushing is complete (optional)
 	 * @param scaler: scaler instance handle
 	 * @param userdata: user data pointer */
@@ -220,6 +724,72 @@ struct vscale_cbs {
 };
 
 
+/**
+ * Get the scaler timestamps of a frame.
+ * The timestamps are read from the VSCALE_ANCILLARY_KEY_TIMESTAMPS
+ * ancillary data.
+ * @param frame: frame to get the timestamps from
+ * @param ts: pointer to a vscale_timestamps structure (output)
+ * @return 0 on success, -ENOENT if the frame has no scaler timestamps,
+ *         negative errno value in case of error
+ */
+VSCALE_API int vscale_frame_get_timestamps(struct mbuf_raw_video_frame *frame,
+					   struct vscale_timestamps *ts);
+
+
+/**
+ * Get the scaler stage timings of an output frame.
+ * The timings are read from the VSCALE_ANCILLARY_KEY_TIMINGS ancillary
+ * data, only set when config.timings is true.
+ * @param frame: output frame to get the timings from
+ * @param timings: pointer to a vscale_timings structure (output)
+ * @return 0 on success, -ENOENT if the frame has no scaler timings,
+ *         negative errno value in case of error
+ */
+VSCALE_API int vscale_frame_get_timings(struct mbuf_raw_video_frame *frame,
+					struct vscale_timings *timings);
+
+
+/**
+ * Set the regions of interest of an input frame.
+ * The regions are set in the VSCALE_ANCILLARY_KEY_ROIS ancillary data;
+ * they are only used if config.output.max_rois is not 0.
+ * @param frame: input frame, not finalized yet
+ * @param rois: regions of interest in input frame coordinates
+ * @param count: number of regions of interest
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_frame_set_rois(struct mbuf_raw_video_frame *frame,
+				     const struct vdef_rect *rois,
+				     unsigned int count);
+
+
+/**
+ * Get the region of interest of an output frame.
+ * The region is read from the VSCALE_ANCILLARY_KEY_ROI ancillary data.
+ * @param frame: output frame to get the region of interest from
+ * @param roi: pointer to a vscale_roi structure (output)
+ * @return 0 on success, -ENOENT if the frame is not the output of a region
+ *         of interest, negative errno value in case of error
+ */
+VSCALE_API int vscale_frame_get_roi(struct mbuf_raw_video_frame *frame,
+				    struct vscale_roi *roi);
+
+
+/**
+ * Set the warp of an input frame.
+ * The warp and its mesh are copied in the VSCALE_ANCILLARY_KEY_WARP
+ * ancillary data; it replaces config.input.warp for this frame (a
+ * VSCALE_WARP_TYPE_NONE warp disables it). Implementations other than the
+ * generic one ignore it.
+ * @param frame: input frame, not finalized yet
+ * @param warp: warp of the frame
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_frame_set_warp(struct mbuf_raw_video_frame *frame,
+				     const struct vscale_warp *warp);
+
+
 /**
  * Get an enum vscale_scaler_implem value from a string.
  * Valid strings are only the suffix of the implementation name (eg. 'LIBYUV').
@@ -241,6 +811,105 @@ VSCALE_API const char *
 vscale_scaler_implem_to_str(enum vscale_scaler_implem implem);
 
 
+/**
+ * Get an enum vscale_mem_type value from a string.
+ * Valid strings are only the suffix of the memory type name (eg. 'MEMFD').
+ * The case is ignored.
+ * @param str: memory type name to convert
+ * @return the enum vscale_mem_type value or VSCALE_MEM_TYPE_GENERIC
+ *         if unknown
+ */
+VSCALE_API enum vscale_mem_type vscale_mem_type_from_str(const char *str);
+
+
+/**
+ * Get a string from an enum vscale_mem_type value.
+ * @param type: memory type value to convert
+ * @return a string description of the memory type
+ */
+VSCALE_API const char *vscale_mem_type_to_str(enum vscale_mem_type type);
+
+
+/**
+ * Get an enum vscale_numa_policy value from a string.
+ * Valid strings are only the suffix of the NUMA policy name (eg. 'AUTO').
+ * The case is ignored.
+ * @param str: NUMA policy name to convert
+ * @return the enum vscale_numa_policy value or VSCALE_NUMA_POLICY_NONE
+ *         if unknown
+ */
+VSCALE_API enum vscale_numa_policy vscale_numa_policy_from_str(const char *str);
+
+
+/**
+ * Get a string from an enum vscale_numa_policy value.
+ * @param policy: NUMA policy value to convert
+ * @return a string description of the NUMA policy
+ */
+VSCALE_API const char *
+vscale_numa_policy_to_str(enum vscale_numa_policy policy);
+
+
+/**
+ * Get an enum vscale_orientation value from a string.
+ * Valid strings are only the suffix of the orientation name (eg. 'ROTATE_90').
+ * The case is ignored.
+ * @param str: orientation name to convert
+ * @return the enum vscale_orientation value or VSCALE_ORIENTATION_NORMAL
+ *         if unknown
+ */
+VSCALE_API enum vscale_orientation vscale_orientation_from_str(const char *str);
+
+
+/**
+ * Get a string from an enum vscale_orientation value.
+ * @param orientation: orientation value to convert
+ * @return a string description of the orientation
+ */
+VSCALE_API const char *
+vscale_orientation_to_str(enum vscale_orientation orientation);
+
+
+/**
+ * Get an enum vscale_fit_mode value from a string.
+ * Valid strings are only the suffix of the fit mode name (eg. 'FIT').
+ * The case is ignored.
+ * @param str: fit mode name to convert
+ * @return the enum vscale_fit_mode value or VSCALE_FIT_MODE_STRETCH
+ *         if unknown
+ */
+VSCALE_API enum vscale_fit_mode vscale_fit_mode_from_str(const char *str);
+
+
+/**
+ * Get a string from an enum vscale_fit_mode value.
+ * @param mode: fit mode value to convert
+ * @return a string description of the fit mode
+ */
+VSCALE_API const char *vscale_fit_mode_to_str(enum vscale_fit_mode mode);
+
+
+/**
+ * Get an enum vscale_tensor_format value from a string.
+ * Valid strings are only the suffix of the tensor format name
+ * (eg. 'RGB8_PLANAR'). The case is ignored.
+ * @param str: tensor format name to convert
+ * @return the enum vscale_tensor_format value or VSCALE_TENSOR_FORMAT_NONE
+ *         if unknown
+ */
+VSCALE_API enum vscale_tensor_format
+vscale_tensor_format_from_str(const char *str);
+
+
+/**
+ * Get a string from an enum vscale_tensor_format value.
+ * @param format: tensor format value to convert
+ * @return a string description of the tensor format
+ */
+VSCALE_API const char *
+vscale_tensor_format_to_str(enum vscale_tensor_format format);
+
+
 /**
  * Get an enum vscale_filter_mode value from a string.
  * Valid strings are only the suffix of the filter mode name (eg. 'LINEAR').
@@ -260,6 +929,14 @@ VSCALE_API enum vscale_filter_mode vscale_filter_mode_from_str(const char *str);
 VSCALE_API const char *vscale_filter_mode_to_str(enum vscale_filter_mode mode);
 
 
+/**
+ * Get a string from an enum vscale_stage value.
+ * @param stage: scaling stage value to convert
+ * @return a string description of the scaling stage
+ */
+VSCALE_API const char *vscale_stage_to_str(enum vscale_stage stage);
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
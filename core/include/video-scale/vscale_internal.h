@@ -28,6 +28,7 @@
 #define _VSCALE_INTERNAL_H
 
 #include <inttypes.h>
+#include <stddef.h>
 
 #include <video-scale/vscale_core.h>
 
@@ -150,6 +151,32 @@ struct vscale_ops {
 	int (*get_input_buffer_constraints)(
 		const struct vdef_raw_format *format,
 		struct vscale_input_buffer_constraints *constraints);
+
+	/**
+	 * Get the scaler statistics (optional).
+	 * The caller must provide a statistics structure to fill.
+	 * If the implementation does not provide statistics, the pointer
+	 * can be NULL.
+	 * @param base: base instance
+	 * @param stats: pointer to a vscale_stats structure (output)
+	 * @return 0 on success, negative errno value in case of error
+	 */
+	int (*get_stats)(struct vscale_scaler *base,
+			 struct vscale_stats *stats);
+
+	/**
+	 * Report the progress of a progressive input frame (optional).
+	 * If the implementation does not support progressive input, the
+	 * pointer can be NULL.
+	 * @note this function can be called from any thread
+	 * @param base: base instance
+	 * @param frame: input frame
+	 * @param rows: number of rows available from the top of the frame
+	 * @return 0 on success, negative errno value in case of error
+	 */
+	int (*set_input_rows)(struct vscale_scaler *base,
+			      struct mbuf_raw_video_frame *frame,
+			      unsigned int rows);
 };
 
 
@@ -161,6 +188,20 @@ struct vscale_scaler {
 	void *userdata;
 	struct vscale_config config;
 	uint64_t last_timestamp;
+
+	/* Frame rate decimation state: number of input frames rejected
+	 * since the last kept frame, timestamp of the last kept frame
+	 * (UINT64_MAX if none) and due timestamp of the next frame to keep
+	 * in microseconds, number of rejected frames, and last filtered frame
+	 * if it was rejected (NULL otherwise, see vscale_is_decimated()); only
+	 * updated by the input filter */
+	struct {
+		unsigned int skipped;
+		uint64_t last_us;
+		uint64_t next_us;
+		uint64_t count;
+		struct mbuf_raw_video_frame *dropped;
+	} decimation;
 };
 
 /**
@@ -184,6 +225,7 @@ VSCALE_API bool vscale_default_input_filter(struct mbuf_raw_video_frame *frame,
  * - frame is in a supported format
  * - frame info matches input config
  * - frame timestamp is strictly monotonic
+ * - frame is not dropped by the frame rate decimation
  * This version is intended to be used by custom filters, to avoid calls to
  * mbuf_raw_video_frame_get_frame_info() or get_supported_input_formats().
  *
@@ -209,8 +251,8 @@ VSCALE_API bool vscale_default_input_filter_internal(
  * Filter update function.
  * This function should be called at the end of a custom filter. It registers
  * that the frame was accepted. This function saves the frame timestamp for
- * monotonic checks, and sets the VSCALE_ANCILLARY_KEY_INPUT_TIME ancillary data
- * on the frame.
+ * monotonic checks and frame rate decimation, and sets the
+ * VSCALE_ANCILLARY_KEY_TIMESTAMPS ancillary data (input time) on the frame.
  *
  * @param scaler: The base video scaler.
  * @param frame: The accepted frame.
@@ -221,6 +263,622 @@ VSCALE_API void vscale_default_input_filter_internal_confirm_frame(
 	struct mbuf_raw_video_frame *frame,
 	struct vdef_raw_frame *frame_info);
 
+/**
+ * Ancillary data iterator sharing the ancillary data with another frame.
+ * This function is intended to be used with
+ * mbuf_raw_video_frame_foreach_ancillary_data() to propagate the ancillary
+ * data of an input frame to an output frame by reference (without copying
+ * the data). The scaler timestamps and timings are not propagated, as the
+ * output frame has its own, nor the regions of interest and warp of the
+ * input frame.
+ *
+ * @param data: The ancillary data to share.
+ * @param userdata: The destination mbuf_raw_video_frame.
+ *
+ * @return true to continue iterating
+ */
+VSCALE_API bool vscale_ancillary_data_sharer(struct mbuf_ancillary_data *data,
+					     void *userdata);
+
+
+/* Per-frame stage timer of a scaling thread: the time elapsed since the
+ * last lap is accounted to a stage at each lap */
+struct vscale_frame_timer {
+	bool enabled;
+	struct vscale_timings timings;
+	uint64_t wall_time;
+	uint64_t cpu_time;
+};
+
+
+/**
+ * Start a per-frame stage timer, with null timings.
+ * A disabled timer does not read the clocks.
+ *
+ * @param timer: timer to start
+ * @param enabled: true to enable the timer (config.timings)
+ */
+VSCALE_API void vscale_frame_timer_start(struct vscale_frame_timer *timer,
+					 bool enabled);
+
+
+/**
+ * Account the time elapsed since the last lap (or the start) of a
+ * per-frame stage timer to a stage.
+ * Must be called on the thread that started the timer.
+ *
+ * @param timer: timer
+ * @param stage: stage of the elapsed time
+ */
+VSCALE_API void vscale_frame_timer_lap(struct vscale_frame_timer *timer,
+				       enum vscale_stage stage);
+
+
+/**
+ * Set the timings of a per-frame stage timer to an output frame.
+ * The timings are set in the VSCALE_ANCILLARY_KEY_TIMINGS ancillary data;
+ * nothing is done if the timer is disabled.
+ *
+ * @param timer: timer
+ * @param frame: output frame, not finalized yet
+ *
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_frame_timer_set(const struct vscale_frame_timer *timer,
+				      struct mbuf_raw_video_frame *frame);
+
+
+/**
+ * Get the number of NUMA nodes of the system.
+ *
+ * @return the number of online NUMA nodes, 1 if unknown
+ */
+VSCALE_API unsigned int vscale_numa_node_count(void);
+
+
+/**
+ * Check whether a NUMA node is online.
+ *
+ * Node ids can be sparse (e.g. online nodes "0,2"), a node id is not
+ * bounded by the node count.
+ *
+ * @param node: NUMA node
+ *
+ * @return true if the node is online
+ */
+VSCALE_API bool vscale_numa_node_is_online(unsigned int node);
+
+
+/**
+ * Get the NUMA node of a memory address.
+ *
+ * The page must have been touched (i.e. be backed by physical memory).
+ *
+ * @param addr: The memory address.
+ *
+ * @return the NUMA node on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_numa_get_mem_node(const void *addr);
+
+
+/**
+ * Bind the calling thread to the CPUs of a NUMA node.
+ *
+ * @param node: The NUMA node.
+ *
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_numa_bind_thread(unsigned int node);
+
+
+/**
+ * Bind a memory range to a NUMA node.
+ *
+ * Pages already touched are migrated; the range should be page aligned.
+ *
+ * @param addr: The memory range start address.
+ * @param len: The memory range length in bytes.
+ * @param node: The NUMA node.
+ *
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_numa_bind_mem(void *addr, size_t len, unsigned int node);
+
+/**
+ * Check whether an orientation swaps the width and height of the scaled
+ * image (90 and 270 degrees rotations).
+ *
+ * @param orientation: The output orientation.
+ *
+ * @return true if the width and height are swapped
+ */
+VSCALE_API bool
+vscale_orientation_is_transposed(enum vscale_orientation orientation);
+
+
+/**
+ * Check whether an orientation maps each scaled row to the output row with
+ * the same index (no rotation and horizontal mirror), which allows scaling
+ * in slices.
+ *
+ * @param orientation: The output orientation.
+ *
+ * @return true if the scaled rows are kept
+ */
+VSCALE_API bool
+vscale_orientation_keeps_rows(enum vscale_orientation orientation);
+
+
+/**
+ * Get the location in an output plane of a block of scaled rows.
+ *
+ * The scaled rows [y, y + rows) of a plane of the given scaled height are
+ * written with vscale_orient_plane() at the returned address.
+ *
+ * @param plane: The output plane.
+ * @param stride: The output plane stride in bytes.
+ * @param height: The scaled plane height in rows.
+ * @param y: The first scaled row of the block.
+ * @param rows: The number of scaled rows of the block.
+ * @param pixel_size: The pixel size in bytes.
+ * @param orientation: The output orientation.
+ *
+ * @return the output address of the block
+ */
+VSCALE_API uint8_t *vscale_orient_rows_dst(uint8_t *plane,
+					   size_t stride,
+					   unsigned int height,
+					   unsigned int y,
+					   unsigned int rows,
+					   unsigned int pixel_size,
+					   enum vscale_orientation orientation);
+
+
+/**
+ * Copy a plane with an orientation applied.
+ *
+ * The destination is height x width for transposing orientations and
+ * width x height otherwise. Rotations are processed in tiles.
+ *
+ * @param src: The source plane.
+ * @param src_stride: The source plane stride in bytes.
+ * @param dst: The destination plane.
+ * @param dst_stride: The destination plane stride in bytes.
+ * @param width: The source plane width in pixels.
+ * @param height: The source plane height in rows.
+ * @param pixel_size: The pixel size in bytes (e.g. 2 for interleaved
+ *                    chroma planes).
+ * @param orientation: The orientation to apply.
+ */
+VSCALE_API void vscale_orient_plane(const uint8_t *src,
+				    size_t src_stride,
+				    uint8_t *dst,
+				    size_t dst_stride,
+				    unsigned int width,
+				    unsigned int height,
+				    unsigned int pixel_size,
+				    enum vscale_orientation orientation);
+
+
+/* Plane fit geometry */
+struct vscale_fit_plane {
+	/* Scaled plane dimensions */
+	unsigned int width;
+	unsigned int height;
+
+	/* Scaled content rectangle in the scaled plane, the rest of the
+	 * plane is padded */
+	struct vdef_rect content;
+
+	/* Source rectangle scaled to the content rectangle */
+	struct vdef_rect crop;
+};
+
+
+/**
+ * Compute the fit geometry of 4:2:0 planes.
+ *
+ * Rectangles offsets are even on the luma plane, so that they map to whole
+ * chroma samples.
+ *
+ * @param mode: The fit mode.
+ * @param src: The source luma plane dimensions.
+ * @param dst: The scaled luma plane dimensions (before orientation).
+ * @param luma: The luma plane geometry (output).
+ * @param chroma: The chroma planes geometry (output, optional, can be
+ *                NULL).
+ *
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_fit_compute(enum vscale_fit_mode mode,
+				  const struct vdef_dim *src,
+				  const struct vdef_dim *dst,
+				  struct vscale_fit_plane *luma,
+				  struct vscale_fit_plane *chroma);
+
+
+/**
+ * Get the regions of interest of an input frame.
+ *
+ * The regions are clipped to the frame, and aligned on even offsets and
+ * dimensions; regions smaller than 2x2 after clipping are dropped, and
+ * only the first max regions are kept.
+ *
+ * @param frame: The input frame.
+ * @param resolution: The input frame resolution.
+ * @param rois: The regions of interest (output).
+ * @param max: The maximum number of regions of interest.
+ *
+ * @return the number of regions of interest on success (0 if the frame
+ *         has none), negative errno value in case of error
+ */
+VSCALE_API int vscale_frame_get_input_rois(struct mbuf_raw_video_frame *frame,
+					   const struct vdef_dim *resolution,
+					   struct vdef_rect *rois,
+					   unsigned int max);
+
+
+/**
+ * Compute the fit geometry of a region of interest of 4:2:0 planes.
+ *
+ * The geometry is the one of vscale_fit_compute() with the region as
+ * source, and the crop rectangles moved to the region.
+ *
+ * @param mode: The fit mode.
+ * @param roi: The aligned region of interest.
+ * @param dst: The scaled luma plane dimensions (before orientation).
+ * @param luma: The luma plane geometry (output).
+ * @param chroma: The chroma planes geometry (output).
+ *
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_roi_fit_compute(enum vscale_fit_mode mode,
+				      const struct vdef_rect *roi,
+				      const struct vdef_dim *dst,
+				      struct vscale_fit_plane *luma,
+				      struct vscale_fit_plane *chroma);
+
+
+/**
+ * Check the validity of a warp.
+ *
+ * @param warp: The warp.
+ *
+ * @return 0 if the warp is valid, negative errno value otherwise
+ */
+VSCALE_API int vscale_warp_check(const struct vscale_warp *warp);
+
+
+/**
+ * Get the size in bytes of the mesh of a warp.
+ *
+ * @param warp: The warp.
+ *
+ * @return the mesh size, 0 if the warp is not a mesh
+ */
+VSCALE_API size_t vscale_warp_mesh_size(const struct vscale_warp *warp);
+
+
+/**
+ * Compare two warps, including their mesh.
+ *
+ * @param a: The first warp.
+ * @param b: The second warp.
+ *
+ * @return true if the warps are equal
+ */
+VSCALE_API bool vscale_warp_equal(const struct vscale_warp *a,
+				  const struct vscale_warp *b);
+
+
+/**
+ * Get the warp of an input frame.
+ *
+ * The warp is read from the VSCALE_ANCILLARY_KEY_WARP ancillary data; its
+ * mesh points into the ancillary data, which must be released with
+ * mbuf_ancillary_data_unref() once the warp is no longer used.
+ *
+ * @param frame: The input frame.
+ * @param warp: The warp (output).
+ * @param data: The ancillary data (output).
+ *
+ * @return 0 on success, -ENOENT if the frame has no warp, negative errno
+ *         value in case of error
+ */
+VSCALE_API int vscale_frame_get_warp(struct mbuf_raw_video_frame *frame,
+				     struct vscale_warp *warp,
+				     struct mbuf_ancillary_data **data);
+
+
+/**
+ * Get the source positions of evenly spaced positions on a row of the
+ * warped input frame.
+ *
+ * @param warp: The warp.
+ * @param dim: The input frame dimensions.
+ * @param x: The first horizontal position, in luma pixels.
+ * @param x_step: The horizontal distance between the positions.
+ * @param y: The vertical position of the row, in luma pixels.
+ * @param count: The number of positions.
+ * @param sx: The horizontal source positions (output, count values, not
+ *            clamped).
+ * @param sy: The vertical source positions (output, count values, not
+ *            clamped).
+ */
+VSCALE_API void vscale_warp_apply_row(const struct vscale_warp *warp,
+				      const struct vdef_dim *dim,
+				      float x,
+				      float x_step,
+				      float y,
+				      unsigned int count,
+				      float *sx,
+				      float *sy);
+
+
+/**
+ * Pad the rows [y, y + rows) of a scaled plane around the content
+ * rectangle, and get the rows of the band that hold content.
+ *
+ * @param fit: The plane geometry.
+ * @param dst: The destination of the row y.
+ * @param stride: The destination stride in bytes (negative for bottom-up
+ *                destinations).
+ * @param y: The first row of the band.
+ * @param rows: The number of rows of the band.
+ * @param pad: The pad pixel.
+ * @param pixel_size: The pixel size in bytes.
+ * @param content_start: The first content row of the band (output).
+ * @param content_end: The row after the last content row of the band
+ *                     (output, equal to content_start if the band holds
+ *                     no content).
+ */
+VSCALE_API void vscale_fit_pad_rows(const struct vscale_fit_plane *fit,
+				    uint8_t *dst,
+				    ptrdiff_t stride,
+				    unsigned int y,
+				    unsigned int rows,
+				    const uint8_t *pad,
+				    unsigned int pixel_size,
+				    unsigned int *content_start,
+				    unsigned int *content_end);
+
+
+/**
+ * Fill rows with a pixel value.
+ *
+ * @param dst: The first row.
+ * @param stride: The stride in bytes (can be negative).
+ * @param width: The width in pixels.
+ * @param rows: The number of rows.
+ * @param pixel: The pixel value.
+ * @param pixel_size: The pixel size in bytes.
+ */
+VSCALE_API void vscale_fill_rows(uint8_t *dst,
+				 ptrdiff_t stride,
+				 unsigned int width,
+				 unsigned int rows,
+				 const uint8_t *pixel,
+				 unsigned int pixel_size);
+
+
+/**
+ * Compute the layout of the output frames (not tensors) of a scaler.
+ *
+ * The output frames have the output resolution; the planes are contiguous,
+ * with the strides and sizes aligned as configured in
+ * config->output.plane_stride_align and plane_scanline_align.
+ *
+ * @param config: The scaler configuration.
+ * @param format: The output frames format (4:2:0 or gray formats only).
+ * @param plane_stride: The planes strides in bytes (output).
+ * @param plane_size: The planes sizes in bytes (output, 0 for unused
+ *                    planes).
+ * @param size: The frame size in bytes (output).
+ *
+ * @return the number of planes on success, negative errno value in case
+ *         of error
+ */
+VSCALE_API int
+vscale_output_layout_compute(const struct vscale_config *config,
+			     const struct vdef_raw_format *format,
+			     size_t plane_stride[VDEF_RAW_MAX_PLANE_COUNT],
+			     size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT],
+			     size_t *size);
+
+
+/**
+ * Get the luma coefficients of the red and blue components of a color
+ * matrix (BT.601 if unknown).
+ *
+ * @param matrix: The color matrix.
+ * @param kr: The red coefficient (output).
+ * @param kb: The blue coefficient (output).
+ */
+VSCALE_API void vscale_color_matrix_coefs(enum vdef_matrix_coefs matrix,
+					  double *kr,
+					  double *kb);
+
+
+/**
+ * Get the 8-bit samples range: luma offset and scale, and chroma scale.
+ *
+ * @param full_range: True for full range.
+ * @param y_off: The luma offset (output).
+ * @param y_scale: The luma scale (output).
+ * @param c_scale: The chroma scale (output).
+ */
+VSCALE_API void vscale_color_range_coefs(bool full_range,
+					 double *y_off,
+					 double *y_scale,
+					 double *c_scale);
+
+
+/**
+ * Convert an RGB color to 8-bit YUV.
+ *
+ * The color matrix (BT.601 if unknown) and range of the format information
+ * are used.
+ *
+ * @param rgb: The color as 0xRRGGBB.
+ * @param info: The YUV format information.
+ * @param yuv: The Y, U and V values (output).
+ */
+VSCALE_API void vscale_rgb_to_yuv(uint32_t rgb,
+				  const struct vdef_format_info *info,
+				  uint8_t yuv[3]);
+
+
+/* Fixed point precision of the color conversion coefficients */
+#define VSCALE_COLOR_CONV_BITS 14
+
+
+/* Fixed point color coefficient from a real value, rounded */
+static inline int32_t vscale_color_to_fixed(double v)
+{
+	v *= 1 << VSCALE_COLOR_CONV_BITS;
+	return (int32_t)(v < 0. ? v - 0.5 : v + 0.5);
+}
+
+
+/* 8-bit sample from a fixed point value, clamped */
+static inline uint8_t vscale_color_from_fixed(int32_t v)
+{
+	v >>= VSCALE_COLOR_CONV_BITS;
+	return (v < 0) ? 0 : (v > 255) ? 255 : v;
+}
+
+
+/* 8-bit YUV color matrix and range conversion */
+struct vscale_color_conv {
+	/* False if the input and output color properties are the same */
+	bool enabled;
+	/* True if only the range differs: the planes are converted
+	 * independently through the lookup tables */
+	bool range_only;
+	uint8_t lut_y[256];
+	uint8_t lut_c[256];
+	/* Matrix conversion: luma from the luma (offsets and rounding
+	 * included) and the chroma centered on 0, chroma from the chroma
+	 * centered on 0 */
+	int32_t y_base[256];
+	int32_t y_u, y_v;
+	int32_t u_u, u_v;
+	int32_t v_u, v_v;
+};
+
+
+/**
+ * Initialize a color conversion between two sets of 8-bit YUV color
+ * properties (matrix and range).
+ *
+ * @param conv: The conversion to initialize.
+ * @param in: The input format information.
+ * @param out: The output format information.
+ * @return 0 on success, negative errno value in case of error
+ *         (-ENOSYS if a color matrix is not supported)
+ */
+VSCALE_API int vscale_color_conv_init(struct vscale_color_conv *conv,
+				      const struct vdef_format_info *in,
+				      const struct vdef_format_info *out);
+
+
+/**
+ * Convert rows of an I420, NV12, NV21 or gray frame in place.
+ *
+ * The luma rows [y, y + rows) and their chroma rows are converted; y must
+ * be even. Each chroma sample is used for its 2x2 luma samples; gray
+ * frames are converted with neutral chroma.
+ *
+ * @param conv: The color conversion.
+ * @param format: The frame format.
+ * @param planes: The frame planes.
+ * @param strides: The frame planes strides.
+ * @param width: The frame width.
+ * @param height: The frame height.
+ * @param y: The first luma row.
+ * @param rows: The number of luma rows.
+ */
+VSCALE_API void vscale_color_conv_rows(const struct vscale_color_conv *conv,
+				       const struct vdef_raw_format *format,
+				       uint8_t *const *planes,
+				       const size_t *strides,
+				       unsigned int width,
+				       unsigned int height,
+				       unsigned int y,
+				       unsigned int rows);
+
+
+/* Tensor output: layout and conversion from the scaled YUV frame */
+struct vscale_tensor {
+	enum vscale_tensor_format format;
+	struct vdef_raw_format raw_format;
+	unsigned int width;
+	unsigned int plane_count;
+	size_t plane_stride[VDEF_RAW_MAX_PLANE_COUNT];
+	size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT];
+	size_t size;
+
+	/* YUV to RGB conversion: luma (offsets and rounding included)
+	 * and chroma centered on 0 contributions */
+	int32_t y_base[256];
+	int32_t r_v, g_u, g_v, b_u;
+
+	/* Normalization of the R, G and B channels for the float formats,
+	 * applied to the fixed point values, before any rounding to 8 bits:
+	 * value * norm_mul + norm_add is (value - mean) * scale */
+	float norm_mul[3];
+	float norm_add[3];
+};
+
+
+/**
+ * Initialize a tensor output.
+ *
+ * @param tensor: The tensor output to initialize.
+ * @param config: The scaler configuration (the output resolution, tensor
+ *                configuration and input color properties are used).
+ * @return 0 on success, negative errno value in case of error
+ *         (-ENOSYS if the input color matrix is not supported)
+ */
+VSCALE_API int vscale_tensor_init(struct vscale_tensor *tensor,
+				  const struct vscale_config *config);
+
+
+/**
+ * Clear a tensor output.
+ *
+ * @param tensor: The tensor output to clear.
+ */
+VSCALE_API void vscale_tensor_clear(struct vscale_tensor *tensor);
+
+
+/**
+ * Convert rows of an I420, NV12 or NV21 frame to the tensor.
+ *
+ * The luma rows [y, y + rows) and their chroma rows are converted; y must
+ * be even. Each chroma sample is used for its 2x2 luma samples. The tensor
+ * output is only read, so that several threads can convert rows of
+ * different frames concurrently.
+ *
+ * @param tensor: The tensor output.
+ * @param format: The YUV frame format.
+ * @param planes: The YUV frame planes.
+ * @param strides: The YUV frame planes strides.
+ * @param height: The frame height.
+ * @param dst: The tensor planes.
+ * @param y: The first luma row.
+ * @param rows: The number of luma rows.
+ */
+VSCALE_API void vscale_tensor_convert_rows(const struct vscale_tensor *tensor,
+					   const struct vdef_raw_format *format,
+					   const uint8_t *const *planes,
+					   const size_t *strides,
+					   unsigned int height,
+					   uint8_t *const *dst,
+					   unsigned int y,
+					   unsigned int rows);
+
+
 VSCALE_API struct vscale_config_impl *
 vscale_config_get_specific(struct vscale_config *config,
 			   enum vscale_scaler_implem implem);
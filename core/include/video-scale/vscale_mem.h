@@ -0,0 +1,163 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _VSCALE_MEM_H
+#define _VSCALE_MEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <media-buffers/mbuf_mem.h>
+#include <video-defs/vdefs.h>
+#include <video-scale/vscale_core.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* To be used for all public API */
+#ifdef VSCALE_API_EXPORTS
+#	ifdef _WIN32
+#		define VSCALE_API __declspec(dllexport)
+#	else /* !_WIN32 */
+#		define VSCALE_API __attribute__((visibility("default")))
+#	endif /* !_WIN32 */
+#else /* !VSCALE_API_EXPORTS */
+#	define VSCALE_API
+#endif /* !VSCALE_API_EXPORTS */
+
+
+/**
+ * mbuf ancillary data key for the memfd description of a frame.
+ *
+ * Content is a struct vscale_memfd; it is set on output frames when the
+ * output memory type is VSCALE_MEM_TYPE_MEMFD
+ */
+#define VSCALE_ANCILLARY_KEY_MEMFD "vscale.memfd"
+
+
+/* Forward declarations */
+struct vscale_mem_pool;
+
+
+/* memfd description of a frame: other processes can map the frame planes
+ * with mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) once they have
+ * received the file descriptor (e.g. through SCM_RIGHTS) */
+struct vscale_memfd {
+	/* memfd file descriptor (owned by the scaler) */
+	int fd;
+
+	/* memfd size in bytes */
+	size_t size;
+
+	/* Offset of each plane in the memfd in bytes */
+	size_t plane_offset[VDEF_RAW_MAX_PLANE_COUNT];
+};
+
+
+/* Memory pool configuration */
+struct vscale_mem_pool_config {
+	/* Pool name (optional, can be NULL, copied internally) */
+	const char *name;
+
+	/* Memory type */
+	enum vscale_mem_type type;
+
+	/* Size of each buffer in bytes (mandatory) */
+	size_t size;
+
+	/* Number of buffers allocated at creation (optional) */
+	unsigned int initial_count;
+
+	/* Maximum number of buffers (optional, 0 means no limit) */
+	unsigned int max_count;
+
+	/* Bind the buffers memory to numa_node (optional) */
+	bool numa_bind;
+
+	/* NUMA node of the buffers, if numa_bind is true */
+	unsigned int numa_node;
+
+	/* Touch the pages of the buffers when they are allocated, rather
+	 * than on first use (optional) */
+	bool prefault;
+};
+
+
+/**
+ * Create a memory pool.
+ * Buffers are allocated on demand (or at creation for the first
+ * initial_count buffers) and return to the pool when the last reference
+ * on their mbuf_mem is dropped, to be reused.
+ * @param config: pool configuration
+ * @param ret_obj: pool handle (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_mem_pool_new(const struct vscale_mem_pool_config *config,
+				   struct vscale_mem_pool **ret_obj);
+
+
+/**
+ * Destroy a memory pool.
+ * Buffers still referenced remain valid; they are freed when released.
+ * @param pool: pool handle
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_mem_pool_destroy(struct vscale_mem_pool *pool);
+
+
+/**
+ * Bind the buffers of a memory pool to a NUMA node.
+ * Buffers allocated afterwards are bound to the node; available buffers
+ * bound to another node are freed, buffers in use are freed when released.
+ * @param pool: pool handle
+ * @param node: NUMA node
+ * @return 0 on success, negative errno value in case of error
+ */
+VSCALE_API int vscale_mem_pool_set_numa_node(struct vscale_mem_pool *pool,
+					     unsigned int node);
+
+
+/**
+ * Get a buffer from a memory pool.
+ * @param pool: pool handle
+ * @param mem: buffer memory (output, to be unreferenced by the caller)
+ * @param fd: memfd file descriptor of the buffer (output, optional, can be
+ *            NULL; -1 if the memory type is not VSCALE_MEM_TYPE_MEMFD)
+ * @return 0 on success, -EAGAIN if the pool is exhausted, negative errno
+ *         value in case of error
+ */
+VSCALE_API int vscale_mem_pool_get(struct vscale_mem_pool *pool,
+				   struct mbuf_mem **mem,
+				   int *fd);
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !_VSCALE_MEM_H */
@@ -0,0 +1,300 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/param.h>
+
+#define ULOG_TAG vcsale_core
+#include <ulog.h>
+
+#include <video-scale/vscale_internal.h>
+
+
+void vscale_color_matrix_coefs(enum vdef_matrix_coefs matrix,
+			       double *kr,
+			       double *kb)
+{
+	switch (matrix) {
+	case VDEF_MATRIX_COEFS_BT709:
+		*kr = 0.2126;
+		*kb = 0.0722;
+		break;
+	case VDEF_MATRIX_COEFS_BT2020_NON_CST:
+	case VDEF_MATRIX_COEFS_BT2020_CST:
+		*kr = 0.2627;
+		*kb = 0.0593;
+		break;
+	default:
+		/* BT.601, also used when unknown */
+		*kr = 0.299;
+		*kb = 0.114;
+		break;
+	}
+}
+
+
+static uint8_t clamp_u8(double v)
+{
+	return (v <= 0.) ? 0 : (v >= 255.) ? 255 : (uint8_t)(v + 0.5);
+}
+
+
+void vscale_rgb_to_yuv(uint32_t rgb,
+		       const struct vdef_format_info *info,
+		       uint8_t yuv[3])
+{
+	double r = ((rgb >> 16) & 0xff) / 255.;
+	double g = ((rgb >> 8) & 0xff) / 255.;
+	double b = (rgb & 0xff) / 255.;
+	double y, u, v, kr, kb;
+
+	if (info->matrix_coefs == VDEF_MATRIX_COEFS_IDENTITY) {
+		/* GBR */
+		y = g;
+		u = b - 0.5;
+		v = r - 0.5;
+	} else {
+		vscale_color_matrix_coefs(info->matrix_coefs, &kr, &kb);
+		y = kr * r + (1. - kr - kb) * g + kb * b;
+		u = (b - y) / (2. * (1. - kb));
+		v = (r - y) / (2. * (1. - kr));
+	}
+
+	if (info->full_range) {
+		yuv[0] = clamp_u8(255. * y);
+		yuv[1] = clamp_u8(128. + 255. * u);
+		yuv[2] = clamp_u8(128. + 255. * v);
+	} else {
+		yuv[0] = clamp_u8(16. + 219. * y);
+		yuv[1] = clamp_u8(128. + 224. * u);
+		yuv[2] = clamp_u8(128. + 224. * v);
+	}
+}
+
+
+void vscale_color_range_coefs(bool full_range,
+			      double *y_off,
+			      double *y_scale,
+			      double *c_scale)
+{
+	*y_off = full_range ? 0. : 16.;
+	*y_scale = full_range ? 255. : 219.;
+	*c_scale = full_range ? 255. : 224.;
+}
+
+
+/* Normalized YUV (Y in [0, 1], U and V in [-0.5, 0.5]) to RGB */
+static void yuv_to_rgb(double kr, double kb, const double yuv[3], double rgb[3])
+{
+	double kg = 1. - kr - kb;
+
+	rgb[0] = yuv[0] + 2. * (1. - kr) * yuv[2];
+	rgb[2] = yuv[0] + 2. * (1. - kb) * yuv[1];
+	rgb[1] = (yuv[0] - kr * rgb[0] - kb * rgb[2]) / kg;
+}
+
+
+/* RGB to normalized YUV */
+static void rgb_to_yuv(double kr, double kb, const double rgb[3], double yuv[3])
+{
+	yuv[0] = kr * rgb[0] + (1. - kr - kb) * rgb[1] + kb * rgb[2];
+	yuv[1] = (rgb[2] - yuv[0]) / (2. * (1. - kb));
+	yuv[2] = (rgb[0] - yuv[0]) / (2. * (1. - kr));
+}
+
+
+int vscale_color_conv_init(struct vscale_color_conv *conv,
+			   const struct vdef_format_info *in,
+			   const struct vdef_format_info *out)
+{
+	double kr_in, kb_in, kr_out, kb_out;
+	double yo_in, ys_in, cs_in, yo_out, ys_out, cs_out;
+	double t[3][3];
+
+	ULOG_ERRNO_RETURN_ERR_IF(conv == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(in == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(out == NULL, EINVAL);
+
+	memset(conv, 0, sizeof(*conv));
+
+	if (in->matrix_coefs == VDEF_MATRIX_COEFS_IDENTITY ||
+	    out->matrix_coefs == VDEF_MATRIX_COEFS_IDENTITY) {
+		ULOGE("unsupported color conversion: %s to %s",
+		      vdef_matrix_coefs_to_str(in->matrix_coefs),
+		      vdef_matrix_coefs_to_str(out->matrix_coefs));
+		return -ENOSYS;
+	}
+
+	vscale_color_matrix_coefs(in->matrix_coefs, &kr_in, &kb_in);
+	vscale_color_matrix_coefs(out->matrix_coefs, &kr_out, &kb_out);
+	vscale_color_range_coefs(in->full_range, &yo_in, &ys_in, &cs_in);
+	vscale_color_range_coefs(out->full_range, &yo_out, &ys_out, &cs_out);
+
+	if (kr_in == kr_out && kb_in == kb_out &&
+	    in->full_range == out->full_range)
+		return 0;
+	conv->enabled = true;
+
+	/* Normalized YUV transform: columns are the output of the input
+	 * unit vectors */
+	for (unsigned int j = 0; j < 3; j++) {
+		double yuv[3] = {0}, rgb[3], res[3];
+		yuv[j] = 1.;
+		yuv_to_rgb(kr_in, kb_in, yuv, rgb);
+		rgb_to_yuv(kr_out, kb_out, rgb, res);
+		for (unsigned int i = 0; i < 3; i++)
+			t[i][j] = res[i];
+	}
+
+	/* The output luma does not depend on the input chroma, nor the
+	 * output chroma on the input luma (up to rounding errors) */
+	conv->range_only = kr_in == kr_out && kb_in == kb_out;
+
+	/* 8-bit samples transform on (Y, U - 128, V - 128), the offsets
+	 * and rounding are folded in the luma table */
+	for (unsigned int v = 0; v < 256; v++) {
+		double y = (v - yo_in) / ys_in * t[0][0] * ys_out + yo_out;
+		double c = 128. + (v - 128.) / cs_in * t[1][1] * cs_out;
+		conv->lut_y[v] = clamp_u8(y);
+		conv->lut_c[v] = clamp_u8(c);
+		conv->y_base[v] = vscale_color_to_fixed(y) +
+				  (1 << (VSCALE_COLOR_CONV_BITS - 1));
+	}
+	conv->y_u = vscale_color_to_fixed(t[0][1] / cs_in * ys_out);
+	conv->y_v = vscale_color_to_fixed(t[0][2] / cs_in * ys_out);
+	conv->u_u = vscale_color_to_fixed(t[1][1] * cs_out / cs_in);
+	conv->u_v = vscale_color_to_fixed(t[1][2] * cs_out / cs_in);
+	conv->v_u = vscale_color_to_fixed(t[2][1] * cs_out / cs_in);
+	conv->v_v = vscale_color_to_fixed(t[2][2] * cs_out / cs_in);
+
+	return 0;
+}
+
+
+static void lut_row(uint8_t *row, unsigned int count, const uint8_t *lut)
+{
+	for (unsigned int x = 0; x < count; x++)
+		row[x] = lut[row[x]];
+}
+
+
+void vscale_color_conv_rows(const struct vscale_color_conv *conv,
+			    const struct vdef_raw_format *format,
+			    uint8_t *const *planes,
+			    const size_t *strides,
+			    unsigned int width,
+			    unsigned int height,
+			    unsigned int y,
+			    unsigned int rows)
+{
+	unsigned int cw = (width + 1) / 2;
+	unsigned int y_end = MIN(y + rows, height);
+	unsigned int cy_end = (y_end + 1) / 2;
+	uint8_t *u_plane, *v_plane;
+	size_t c_stride = strides[1];
+	unsigned int step;
+
+	if (!conv->enabled || y >= y_end)
+		return;
+
+	if (vdef_raw_format_cmp(format, &vdef_gray)) {
+		/* Neutral chroma: the luma only depends on itself */
+		for (unsigned int r = y; r < y_end; r++)
+			lut_row(planes[0] + r * strides[0], width, conv->lut_y);
+		return;
+	}
+
+	if (vdef_raw_format_cmp(format, &vdef_i420)) {
+		u_plane = planes[1];
+		v_plane = planes[2];
+		step = 1;
+	} else if (vdef_raw_format_cmp(format, &vdef_nv21)) {
+		v_plane = planes[1];
+		u_plane = planes[1] + 1;
+		step = 2;
+	} else {
+		u_plane = planes[1];
+		v_plane = planes[1] + 1;
+		step = 2;
+	}
+
+	if (conv->range_only) {
+		for (unsigned int r = y; r < y_end; r++)
+			lut_row(planes[0] + r * strides[0], width, conv->lut_y);
+		for (unsigned int r = y / 2; r < cy_end; r++) {
+			lut_row(planes[1] + r * c_stride,
+				cw * step,
+				conv->lut_c);
+			if (step == 1) {
+				lut_row(planes[2] + r * strides[2],
+					cw,
+					conv->lut_c);
+			}
+		}
+		return;
+	}
+
+	if (step == 1 && strides[2] != c_stride) {
+		/* The code below assumes a common chroma stride */
+		ULOGE("unsupported chroma strides");
+		return;
+	}
+
+	/* Each chroma sample is converted with its 2x2 luma samples */
+	for (unsigned int cy = y / 2; cy < cy_end; cy++) {
+		uint8_t *u_row = u_plane + cy * c_stride;
+		uint8_t *v_row = v_plane + cy * c_stride;
+		uint8_t *y_rows[2] = {
+			planes[0] + 2 * cy * strides[0],
+			planes[0] + (2 * cy + 1) * strides[0],
+		};
+		unsigned int luma_rows = MIN(2, y_end - 2 * cy);
+
+		for (unsigned int cx = 0; cx < cw; cx++) {
+			int32_t u = u_row[cx * step] - 128;
+			int32_t v = v_row[cx * step] - 128;
+			int32_t dy = conv->y_u * u + conv->y_v * v;
+			int32_t half = 1 << (VSCALE_COLOR_CONV_BITS - 1);
+			unsigned int x = 2 * cx;
+			unsigned int luma_cols = MIN(2, width - x);
+
+			for (unsigned int j = 0; j < luma_rows; j++) {
+				uint8_t *p = y_rows[j] + x;
+				for (unsigned int i = 0; i < luma_cols; i++) {
+					p[i] = vscale_color_from_fixed(
+						conv->y_base[p[i]] + dy);
+				}
+			}
+			u_row[cx * step] = vscale_color_from_fixed(
+				conv->u_u * u + conv->u_v * v + half +
+				(128 << VSCALE_COLOR_CONV_BITS));
+			v_row[cx * step] = vscale_color_from_fixed(
+				conv->v_u * u + conv->v_v * v + half +
+				(128 << VSCALE_COLOR_CONV_BITS));
+		}
+	}
+}
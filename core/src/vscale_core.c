@@ -27,6 +27,9 @@
 #define ULOG_TAG vcsale_core
 #include <ulog.h>
 
+#include <string.h>
+#include <time.h>
+
 #include <futils/timetools.h>
 #include <video-scale/vscale_core.h>
 #include <video-scale/vscale_internal.h>
@@ -60,6 +63,55 @@ bool vscale_default_input_filter(struct mbuf_raw_video_frame *frame,
 }
 
 
+static uint64_t timestamp_to_us(const struct vdef_raw_frame *frame_info)
+{
+	uint64_t ts = frame_info->info.timestamp;
+	uint32_t timescale = frame_info->info.timescale;
+
+	if (timescale == 0 || timescale == 1000000)
+		return ts;
+	return ts / timescale * 1000000 + ts % timescale * 1000000 / timescale;
+}
+
+
+/* Target frame rate period in microseconds (0 if no target) */
+static uint64_t decimation_period_us(const struct vscale_scaler *scaler)
+{
+	const struct vdef_frac *fr = &scaler->config.input.decimation.framerate;
+
+	if (fr->num == 0 || fr->den == 0)
+		return 0;
+	return (uint64_t)fr->den * 1000000 / fr->num;
+}
+
+
+/* Frame rate decimation: true if the frame is to be dropped */
+static bool decimate(struct vscale_scaler *scaler,
+		     const struct vdef_raw_frame *frame_info)
+{
+	unsigned int keep_one_in = scaler->config.input.decimation.keep_one_in;
+	uint64_t min_interval = scaler->config.input.decimation.min_interval_us;
+	uint64_t period = decimation_period_us(scaler);
+	uint64_t ts_us;
+
+	/* The first frame is always kept */
+	if (scaler->decimation.last_us == UINT64_MAX)
+		return false;
+
+	if (keep_one_in > 1 && scaler->decimation.skipped + 1 < keep_one_in)
+		return true;
+
+	ts_us = timestamp_to_us(frame_info);
+	if (min_interval > 0 &&
+	    ts_us - scaler->decimation.last_us < min_interval)
+		return true;
+	if (period > 0 && ts_us + period / 8 < scaler->decimation.next_us)
+		return true;
+
+	return false;
+}
+
+
 bool vscale_default_input_filter_internal(
 	struct vscale_scaler *scaler,
 	struct mbuf_raw_video_frame *frame,
@@ -67,6 +119,8 @@ bool vscale_default_input_filter_internal(
 	const struct vdef_raw_format *supported_formats,
 	unsigned int nb_supported_formats)
 {
+	scaler->decimation.dropped = NULL;
+
 	if (!vdef_raw_format_intersect(&frame_info->format,
 				       supported_formats,
 				       nb_supported_formats)) {
@@ -97,6 +151,13 @@ bool vscale_default_input_filter_internal(
 		return false;
 	}
 
+	if (decimate(scaler, frame_info)) {
+		scaler->decimation.skipped++;
+		scaler->decimation.count++;
+		scaler->decimation.dropped = frame;
+		return false;
+	}
+
 	return true;
 }
 
@@ -106,17 +167,225 @@ void vscale_default_input_filter_internal_confirm_frame(
 	struct vdef_raw_frame *frame_info)
 {
 	int err;
-	uint64_t ts_us;
+	struct vscale_timestamps ts = {0};
 	struct timespec cur_ts = {0, 0};
 
 	/* Save frame timestamp to last_timestamp */
 	scaler->last_timestamp = frame_info->info.timestamp;
 
+	/* The next frame to keep is due one period after the previous due
+	 * timestamp, or after this frame if it is late by a whole period */
+	uint64_t ts_us = timestamp_to_us(frame_info);
+	uint64_t period = decimation_period_us(scaler);
+	scaler->decimation.skipped = 0;
+	if (scaler->decimation.last_us == UINT64_MAX ||
+	    scaler->decimation.next_us + period <= ts_us)
+		scaler->decimation.next_us = ts_us + period;
+	else
+		scaler->decimation.next_us += period;
+	scaler->decimation.last_us = ts_us;
+
 	/* Set the input time ancillary data to the frame */
 	time_get_monotonic(&cur_ts);
-	time_timespec_to_us(&cur_ts, &ts_us);
+	time_timespec_to_us(&cur_ts, &ts.input_time);
 	err = mbuf_raw_video_frame_add_ancillary_buffer(
-		frame, VSCALE_ANCILLARY_KEY_INPUT_TIME, &ts_us, sizeof(ts_us));
+		frame, VSCALE_ANCILLARY_KEY_TIMESTAMPS, &ts, sizeof(ts));
 	if (err < 0)
 		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -err);
 }
+
+
+bool vscale_ancillary_data_sharer(struct mbuf_ancillary_data *data,
+				  void *userdata)
+{
+	int err;
+	struct mbuf_raw_video_frame *frame = userdata;
+	const char *name = mbuf_ancillary_data_get_name(data);
+
+	if (name != NULL &&
+	    (strcmp(name, VSCALE_ANCILLARY_KEY_TIMESTAMPS) == 0 ||
+	     strcmp(name, VSCALE_ANCILLARY_KEY_TIMINGS) == 0 ||
+	     strcmp(name, VSCALE_ANCILLARY_KEY_ROIS) == 0 ||
+	     strcmp(name, VSCALE_ANCILLARY_KEY_WARP) == 0))
+		return true;
+
+	err = mbuf_raw_video_frame_add_ancillary_data(frame, data);
+	if (err < 0)
+		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_data", -err);
+
+	return true;
+}
+
+
+int vscale_frame_get_timestamps(struct mbuf_raw_video_frame *frame,
+				struct vscale_timestamps *ts)
+{
+	int err;
+	struct mbuf_ancillary_data *data;
+	const void *buf;
+	size_t len;
+
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ts == NULL, EINVAL);
+
+	err = mbuf_raw_video_frame_get_ancillary_data(
+		frame, VSCALE_ANCILLARY_KEY_TIMESTAMPS, &data);
+	if (err < 0)
+		return err;
+
+	buf = mbuf_ancillary_data_get_buffer(data, &len);
+	if (buf == NULL || len != sizeof(*ts)) {
+		err = -EPROTO;
+		goto out;
+	}
+	memcpy(ts, buf, sizeof(*ts));
+
+out:
+	mbuf_ancillary_data_unref(data);
+	return err;
+}
+
+
+int vscale_frame_get_timings(struct mbuf_raw_video_frame *frame,
+			     struct vscale_timings *timings)
+{
+	int err;
+	struct mbuf_ancillary_data *data;
+	const void *buf;
+	size_t len;
+
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(timings == NULL, EINVAL);
+
+	err = mbuf_raw_video_frame_get_ancillary_data(
+		frame, VSCALE_ANCILLARY_KEY_TIMINGS, &data);
+	if (err < 0)
+		return err;
+
+	buf = mbuf_ancillary_data_get_buffer(data, &len);
+	if (buf == NULL || len != sizeof(*timings)) {
+		err = -EPROTO;
+		goto out;
+	}
+	memcpy(timings, buf, sizeof(*timings));
+
+out:
+	mbuf_ancillary_data_unref(data);
+	return err;
+}
+
+
+static void timer_read(uint64_t *wall_time, uint64_t *cpu_time)
+{
+	struct timespec ts = {0, 0};
+
+	time_get_monotonic(&ts);
+	time_timespec_to_us(&ts, wall_time);
+	ts = (struct timespec){0, 0};
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	time_timespec_to_us(&ts, cpu_time);
+}
+
+
+void vscale_frame_timer_start(struct vscale_frame_timer *timer, bool enabled)
+{
+	memset(timer, 0, sizeof(*timer));
+	timer->enabled = enabled;
+	if (enabled)
+		timer_read(&timer->wall_time, &timer->cpu_time);
+}
+
+
+void vscale_frame_timer_lap(struct vscale_frame_timer *timer,
+			    enum vscale_stage stage)
+{
+	uint64_t wall_time, cpu_time;
+
+	if (!timer->enabled || stage >= VSCALE_STAGE_COUNT)
+		return;
+
+	timer_read(&wall_time, &cpu_time);
+	timer->timings.stage[stage].wall_time += wall_time - timer->wall_time;
+	timer->timings.stage[stage].cpu_time += cpu_time - timer->cpu_time;
+	timer->wall_time = wall_time;
+	timer->cpu_time = cpu_time;
+}
+
+
+int vscale_frame_timer_set(const struct vscale_frame_timer *timer,
+			   struct mbuf_raw_video_frame *frame)
+{
+	int err;
+
+	if (!timer->enabled)
+		return 0;
+
+	err = mbuf_raw_video_frame_add_ancillary_buffer(
+		frame,
+		VSCALE_ANCILLARY_KEY_TIMINGS,
+		&timer->timings,
+		sizeof(timer->timings));
+	if (err < 0)
+		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -err);
+
+	return err;
+}
+
+
+static size_t align_up(size_t value, unsigned int align)
+{
+	return (align > 1) ? (value + align - 1) / align * align : value;
+}
+
+
+int vscale_output_layout_compute(const struct vscale_config *config,
+				 const struct vdef_raw_format *format,
+				 size_t plane_stride[VDEF_RAW_MAX_PLANE_COUNT],
+				 size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT],
+				 size_t *size)
+{
+	unsigned int plane_count, comps;
+	unsigned int w, h;
+	const unsigned int *stride_align, *scanline_align;
+
+	ULOG_ERRNO_RETURN_ERR_IF(config == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(format == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(plane_stride == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(plane_size == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(size == NULL, EINVAL);
+
+	if (vdef_raw_format_cmp(format, &vdef_i420)) {
+		plane_count = 3;
+		comps = 1;
+	} else if (vdef_raw_format_cmp(format, &vdef_nv12) ||
+		   vdef_raw_format_cmp(format, &vdef_nv21)) {
+		plane_count = 2;
+		comps = 2;
+	} else if (vdef_raw_format_cmp(format, &vdef_gray)) {
+		plane_count = 1;
+		comps = 0;
+	} else {
+		return -ENOSYS;
+	}
+
+	w = config->output.info.resolution.width;
+	h = config->output.info.resolution.height;
+	stride_align = config->output.plane_stride_align;
+	scanline_align = config->output.plane_scanline_align;
+	*size = 0;
+	for (unsigned int i = 0; i < VDEF_RAW_MAX_PLANE_COUNT; i++) {
+		size_t width = i ? (size_t)((w + 1) / 2) * comps : w;
+		size_t rows = i ? (h + 1) / 2 : h;
+		if (i >= plane_count) {
+			plane_stride[i] = 0;
+			plane_size[i] = 0;
+			continue;
+		}
+		plane_stride[i] = align_up(width, stride_align[i]);
+		plane_size[i] =
+			plane_stride[i] * align_up(rows, scanline_align[i]);
+		*size += plane_size[i];
+	}
+
+	return plane_count;
+}
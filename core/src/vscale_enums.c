@@ -42,6 +42,8 @@ enum vscale_scaler_implem vscale_scaler_implem_from_str(const char *str)
 		return VSCALE_SCALER_IMPLEM_HISI;
 	} else if (strcasecmp(str, "QCOM") == 0) {
 		return VSCALE_SCALER_IMPLEM_QCOM;
+	} else if (strcasecmp(str, "GENERIC") == 0) {
+		return VSCALE_SCALER_IMPLEM_GENERIC;
 	} else {
 		ULOGW("%s: unknown implementation '%s'", __func__, str);
 		return VSCALE_SCALER_IMPLEM_AUTO;
@@ -60,6 +62,178 @@ const char *vscale_scaler_implem_to_str(enum vscale_scaler_implem implem)
 		return "HISI";
 	case VSCALE_SCALER_IMPLEM_QCOM:
 		return "QCOM";
+	case VSCALE_SCALER_IMPLEM_GENERIC:
+		return "GENERIC";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+
+enum vscale_mem_type vscale_mem_type_from_str(const char *str)
+{
+	if (strcasecmp(str, "GENERIC") == 0) {
+		return VSCALE_MEM_TYPE_GENERIC;
+	} else if (strcasecmp(str, "MEMFD") == 0) {
+		return VSCALE_MEM_TYPE_MEMFD;
+	} else if (strcasecmp(str, "HUGE_PAGES") == 0) {
+		return VSCALE_MEM_TYPE_HUGE_PAGES;
+	} else {
+		ULOGW("%s: unknown memory type '%s'", __func__, str);
+		return VSCALE_MEM_TYPE_GENERIC;
+	}
+}
+
+
+const char *vscale_mem_type_to_str(enum vscale_mem_type type)
+{
+	switch (type) {
+	case VSCALE_MEM_TYPE_GENERIC:
+		return "GENERIC";
+	case VSCALE_MEM_TYPE_MEMFD:
+		return "MEMFD";
+	case VSCALE_MEM_TYPE_HUGE_PAGES:
+		return "HUGE_PAGES";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+
+enum vscale_numa_policy vscale_numa_policy_from_str(const char *str)
+{
+	if (strcasecmp(str, "NONE") == 0) {
+		return VSCALE_NUMA_POLICY_NONE;
+	} else if (strcasecmp(str, "AUTO") == 0) {
+		return VSCALE_NUMA_POLICY_AUTO;
+	} else if (strcasecmp(str, "NODE") == 0) {
+		return VSCALE_NUMA_POLICY_NODE;
+	} else {
+		ULOGW("%s: unknown NUMA policy '%s'", __func__, str);
+		return VSCALE_NUMA_POLICY_NONE;
+	}
+}
+
+
+const char *vscale_numa_policy_to_str(enum vscale_numa_policy policy)
+{
+	switch (policy) {
+	case VSCALE_NUMA_POLICY_NONE:
+		return "NONE";
+	case VSCALE_NUMA_POLICY_AUTO:
+		return "AUTO";
+	case VSCALE_NUMA_POLICY_NODE:
+		return "NODE";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+
+enum vscale_orientation vscale_orientation_from_str(const char *str)
+{
+	if (strcasecmp(str, "NORMAL") == 0) {
+		return VSCALE_ORIENTATION_NORMAL;
+	} else if (strcasecmp(str, "ROTATE_90") == 0) {
+		return VSCALE_ORIENTATION_ROTATE_90;
+	} else if (strcasecmp(str, "ROTATE_180") == 0) {
+		return VSCALE_ORIENTATION_ROTATE_180;
+	} else if (strcasecmp(str, "ROTATE_270") == 0) {
+		return VSCALE_ORIENTATION_ROTATE_270;
+	} else if (strcasecmp(str, "MIRROR_H") == 0) {
+		return VSCALE_ORIENTATION_MIRROR_H;
+	} else if (strcasecmp(str, "MIRROR_V") == 0) {
+		return VSCALE_ORIENTATION_MIRROR_V;
+	} else {
+		ULOGW("%s: unknown orientation '%s'", __func__, str);
+		return VSCALE_ORIENTATION_NORMAL;
+	}
+}
+
+
+const char *vscale_orientation_to_str(enum vscale_orientation orientation)
+{
+	switch (orientation) {
+	case VSCALE_ORIENTATION_NORMAL:
+		return "NORMAL";
+	case VSCALE_ORIENTATION_ROTATE_90:
+		return "ROTATE_90";
+	case VSCALE_ORIENTATION_ROTATE_180:
+		return "ROTATE_180";
+	case VSCALE_ORIENTATION_ROTATE_270:
+		return "ROTATE_270";
+	case VSCALE_ORIENTATION_MIRROR_H:
+		return "MIRROR_H";
+	case VSCALE_ORIENTATION_MIRROR_V:
+		return "MIRROR_V";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+
+enum vscale_fit_mode vscale_fit_mode_from_str(const char *str)
+{
+	if (strcasecmp(str, "STRETCH") == 0) {
+		return VSCALE_FIT_MODE_STRETCH;
+	} else if (strcasecmp(str, "FIT") == 0) {
+		return VSCALE_FIT_MODE_FIT;
+	} else if (strcasecmp(str, "FILL") == 0) {
+		return VSCALE_FIT_MODE_FILL;
+	} else {
+		ULOGW("%s: unknown fit mode '%s'", __func__, str);
+		return VSCALE_FIT_MODE_STRETCH;
+	}
+}
+
+
+const char *vscale_fit_mode_to_str(enum vscale_fit_mode mode)
+{
+	switch (mode) {
+	case VSCALE_FIT_MODE_STRETCH:
+		return "STRETCH";
+	case VSCALE_FIT_MODE_FIT:
+		return "FIT";
+	case VSCALE_FIT_MODE_FILL:
+		return "FILL";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+
+enum vscale_tensor_format vscale_tensor_format_from_str(const char *str)
+{
+	if (strcasecmp(str, "NONE") == 0) {
+		return VSCALE_TENSOR_FORMAT_NONE;
+	} else if (strcasecmp(str, "RGB8") == 0) {
+		return VSCALE_TENSOR_FORMAT_RGB8;
+	} else if (strcasecmp(str, "RGB8_PLANAR") == 0) {
+		return VSCALE_TENSOR_FORMAT_RGB8_PLANAR;
+	} else if (strcasecmp(str, "RGB_F16_PLANAR") == 0) {
+		return VSCALE_TENSOR_FORMAT_RGB_F16_PLANAR;
+	} else if (strcasecmp(str, "RGB_F32_PLANAR") == 0) {
+		return VSCALE_TENSOR_FORMAT_RGB_F32_PLANAR;
+	} else {
+		ULOGW("%s: unknown tensor format '%s'", __func__, str);
+		return VSCALE_TENSOR_FORMAT_NONE;
+	}
+}
+
+
+const char *vscale_tensor_format_to_str(enum vscale_tensor_format format)
+{
+	switch (format) {
+	case VSCALE_TENSOR_FORMAT_NONE:
+		return "NONE";
+	case VSCALE_TENSOR_FORMAT_RGB8:
+		return "RGB8";
+	case VSCALE_TENSOR_FORMAT_RGB8_PLANAR:
+		return "RGB8_PLANAR";
+	case VSCALE_TENSOR_FORMAT_RGB_F16_PLANAR:
+		return "RGB_F16_PLANAR";
+	case VSCALE_TENSOR_FORMAT_RGB_F32_PLANAR:
+		return "RGB_F32_PLANAR";
 	default:
 		return "UNKNOWN";
 	}
@@ -104,6 +278,25 @@ const char *vscale_filter_mode_to_str(enum vscale_filter_mode mode)
 }
 
 
+const char *vscale_stage_to_str(enum vscale_stage stage)
+{
+	switch (stage) {
+	case VSCALE_STAGE_ALLOC:
+		return "ALLOC";
+	case VSCALE_STAGE_MAP:
+		return "MAP";
+	case VSCALE_STAGE_SCALE:
+		return "SCALE";
+	case VSCALE_STAGE_COPY:
+		return "COPY";
+	case VSCALE_STAGE_OUTPUT:
+		return "OUTPUT";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+
 struct vscale_config_impl *
 vscale_config_get_specific(struct vscale_config *config,
 			   enum vscale_scaler_implem implem)
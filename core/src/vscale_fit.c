@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/param.h>
+
+#define ULOG_TAG vcsale_core
+#include <ulog.h>
+
+#include <video-scale/vscale_internal.h>
+
+
+/* Length of full * num / den rounded to the nearest even value, within
+ * [2, full] (or full if it is not more than 2) */
+static unsigned int fit_length(unsigned int full, uint64_t num, uint64_t den)
+{
+	uint64_t len = (full * num + den / 2) / den;
+
+	if (len >= full || full <= 2)
+		return full;
+	return MAX(len & ~1u, 2);
+}
+
+
+/* Chroma plane rectangle of a luma plane rectangle (4:2:0) */
+static void chroma_rect(const struct vdef_rect *luma, struct vdef_rect *chroma)
+{
+	unsigned int right = luma->left + luma->width;
+	unsigned int bottom = luma->top + luma->height;
+
+	chroma->left = luma->left / 2;
+	chroma->top = luma->top / 2;
+	chroma->width = (right + 1) / 2 - chroma->left;
+	chroma->height = (bottom + 1) / 2 - chroma->top;
+}
+
+
+int vscale_fit_compute(enum vscale_fit_mode mode,
+		       const struct vdef_dim *src,
+		       const struct vdef_dim *dst,
+		       struct vscale_fit_plane *luma,
+		       struct vscale_fit_plane *chroma)
+{
+	/* Whether the source is wider than the destination */
+	bool wider;
+	unsigned int len;
+
+	ULOG_ERRNO_RETURN_ERR_IF(src == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(dst == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(luma == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(src->width == 0 || src->height == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(dst->width == 0 || dst->height == 0, EINVAL);
+
+	luma->width = dst->width;
+	luma->height = dst->height;
+	luma->content = (struct vdef_rect){
+		.width = dst->width,
+		.height = dst->height,
+	};
+	luma->crop = (struct vdef_rect){
+		.width = src->width,
+		.height = src->height,
+	};
+	wider = (uint64_t)src->width * dst->height >
+		(uint64_t)src->height * dst->width;
+
+	switch (mode) {
+	case VSCALE_FIT_MODE_STRETCH:
+		break;
+	case VSCALE_FIT_MODE_FIT:
+		/* Pad above and below (letterbox) or on the sides
+		 * (pillarbox) */
+		if (wider) {
+			len = fit_length(dst->height,
+					 (uint64_t)dst->width * src->height,
+					 (uint64_t)dst->height * src->width);
+			luma->content.height = len;
+			luma->content.top = ((dst->height - len) / 2) & ~1u;
+		} else {
+			len = fit_length(dst->width,
+					 (uint64_t)dst->height * src->width,
+					 (uint64_t)dst->width * src->height);
+			luma->content.width = len;
+			luma->content.left = ((dst->width - len) / 2) & ~1u;
+		}
+		break;
+	case VSCALE_FIT_MODE_FILL:
+		/* Crop the source sides or top and bottom */
+		if (wider) {
+			len = fit_length(src->width,
+					 (uint64_t)src->height * dst->width,
+					 (uint64_t)src->width * dst->height);
+			luma->crop.width = len;
+			luma->crop.left = ((src->width - len) / 2) & ~1u;
+		} else {
+			len = fit_length(src->height,
+					 (uint64_t)src->width * dst->height,
+					 (uint64_t)src->height * dst->width);
+			luma->crop.height = len;
+			luma->crop.top = ((src->height - len) / 2) & ~1u;
+		}
+		break;
+	default:
+		ULOGE("unsupported fit mode: %d", mode);
+		return -EINVAL;
+	}
+
+	if (chroma != NULL) {
+		chroma->width = (luma->width + 1) / 2;
+		chroma->height = (luma->height + 1) / 2;
+		chroma_rect(&luma->content, &chroma->content);
+		chroma_rect(&luma->crop, &chroma->crop);
+	}
+
+	return 0;
+}
+
+
+void vscale_fill_rows(uint8_t *dst,
+		      ptrdiff_t stride,
+		      unsigned int width,
+		      unsigned int rows,
+		      const uint8_t *pixel,
+		      unsigned int pixel_size)
+{
+	size_t size = (size_t)width * pixel_size;
+	uint8_t *first = dst;
+
+	if (width == 0 || rows == 0)
+		return;
+
+	if (pixel_size == 1) {
+		for (unsigned int y = 0; y < rows; y++)
+			memset(dst + y * stride, pixel[0], size);
+		return;
+	}
+
+	/* Fill the first row, then copy it */
+	for (unsigned int x = 0; x < width; x++)
+		memcpy(first + x * pixel_size, pixel, pixel_size);
+	for (unsigned int y = 1; y < rows; y++)
+		memcpy(dst + y * stride, first, size);
+}
+
+
+void vscale_fit_pad_rows(const struct vscale_fit_plane *fit,
+			 uint8_t *dst,
+			 ptrdiff_t stride,
+			 unsigned int y,
+			 unsigned int rows,
+			 const uint8_t *pad,
+			 unsigned int pixel_size,
+			 unsigned int *content_start,
+			 unsigned int *content_end)
+{
+	unsigned int end = y + rows;
+	unsigned int c0 = MIN(MAX((unsigned int)fit->content.top, y), end);
+	unsigned int c1 = MIN(
+		MAX(fit->content.top + fit->content.height, c0), end);
+	unsigned int right = fit->content.left + fit->content.width;
+
+	/* Rows above and below the content */
+	vscale_fill_rows(dst, stride, fit->width, c0 - y, pad, pixel_size);
+	vscale_fill_rows(dst + (ptrdiff_t)(c1 - y) * stride,
+			 stride,
+			 fit->width,
+			 end - c1,
+			 pad,
+			 pixel_size);
+
+	/* Columns on the left and on the right of the content */
+	vscale_fill_rows(dst + (ptrdiff_t)(c0 - y) * stride,
+			 stride,
+			 fit->content.left,
+			 c1 - c0,
+			 pad,
+			 pixel_size);
+	vscale_fill_rows(dst + (ptrdiff_t)(c0 - y) * stride +
+				 (size_t)right * pixel_size,
+			 stride,
+			 fit->width - right,
+			 c1 - c0,
+			 pad,
+			 pixel_size);
+
+	*content_start = c0;
+	*content_end = c1;
+}
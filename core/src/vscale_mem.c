@@ -0,0 +1,494 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ULOG_TAG vcsale_core
+#include <ulog.h>
+
+#include <media-buffers/mbuf_mem_generic.h>
+#include <video-scale/vscale_internal.h>
+#include <video-scale/vscale_mem.h>
+
+
+/* Buffer alignment for the generic memory type */
+#define GENERIC_ALIGN 64
+
+/* Huge page size */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+
+struct vscale_mem_buf {
+	struct vscale_mem_pool *pool;
+	struct vscale_mem_buf *next;
+	void *data;
+	size_t size;
+	int fd;
+
+	/* Mapping size (huge pages memory type) */
+	size_t map_size;
+
+	/* NUMA node the buffer is bound to (-1 if not bound) */
+	int numa_node;
+};
+
+
+struct vscale_mem_pool {
+	pthread_mutex_t mutex;
+	char *name;
+	enum vscale_mem_type type;
+	size_t size;
+	unsigned int max_count;
+	bool prefault;
+
+	/* NUMA node of new buffers (-1 for no binding) */
+	int numa_node;
+
+	/* Number of allocated buffers */
+	unsigned int count;
+
+	/* Available buffers */
+	struct vscale_mem_buf *free_list;
+
+	/* One reference for the owner and one for each buffer in use */
+	unsigned int refcount;
+};
+
+
+static int buf_alloc_generic(struct vscale_mem_buf *buf)
+{
+	int res;
+	size_t align = GENERIC_ALIGN;
+
+	/* NUMA binding is done on whole pages: do not share them with other
+	 * allocations */
+	if (buf->pool->numa_node >= 0) {
+		align = sysconf(_SC_PAGESIZE);
+		buf->map_size = (buf->size + align - 1) & ~(align - 1);
+	} else {
+		buf->map_size = buf->size;
+	}
+
+	res = posix_memalign(&buf->data, align, buf->map_size);
+	if (res != 0) {
+		buf->data = NULL;
+		ULOG_ERRNO("posix_memalign", res);
+		return -res;
+	}
+
+	return 0;
+}
+
+
+static int buf_alloc_memfd(struct vscale_mem_buf *buf, const char *name)
+{
+	int res;
+	void *data;
+
+	buf->fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (buf->fd < 0) {
+		res = -errno;
+		ULOG_ERRNO("memfd_create", -res);
+		return res;
+	}
+
+	if (ftruncate(buf->fd, buf->size) < 0) {
+		res = -errno;
+		ULOG_ERRNO("ftruncate", -res);
+		return res;
+	}
+
+	/* The size can no longer change: consumers can safely map it */
+	if (fcntl(buf->fd,
+		  F_ADD_SEALS,
+		  F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		res = -errno;
+		ULOG_ERRNO("fcntl:F_ADD_SEALS", -res);
+		return res;
+	}
+
+	data = mmap(NULL,
+		    buf->size,
+		    PROT_READ | PROT_WRITE,
+		    MAP_SHARED,
+		    buf->fd,
+		    0);
+	if (data == MAP_FAILED) {
+		res = -errno;
+		ULOG_ERRNO("mmap", -res);
+		return res;
+	}
+	buf->data = data;
+
+	return 0;
+}
+
+
+static int buf_alloc_huge_pages(struct vscale_mem_buf *buf)
+{
+	int res;
+	uint8_t *data;
+	size_t head;
+	size_t tail;
+
+	buf->map_size =
+		(buf->size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+	/* Explicit huge pages, if some are reserved */
+	data = mmap(NULL,
+		    buf->map_size,
+		    PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+		    -1,
+		    0);
+	if (data != MAP_FAILED) {
+		buf->data = data;
+		return 0;
+	}
+	ULOGD("MAP_HUGETLB failed (%d), falling back to THP", errno);
+
+	/* Transparent huge pages: the mapping needs to be aligned on the huge
+	 * page size, map one more page and trim the head and tail */
+	data = mmap(NULL,
+		    buf->map_size + HUGE_PAGE_SIZE,
+		    PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS,
+		    -1,
+		    0);
+	if (data == MAP_FAILED) {
+		res = -errno;
+		ULOG_ERRNO("mmap", -res);
+		return res;
+	}
+	head = (HUGE_PAGE_SIZE - ((uintptr_t)data & (HUGE_PAGE_SIZE - 1))) &
+	       (HUGE_PAGE_SIZE - 1);
+	tail = HUGE_PAGE_SIZE - head;
+	if (head > 0)
+		munmap(data, head);
+	if (tail > 0)
+		munmap(data + head + buf->map_size, tail);
+	buf->data = data + head;
+
+	/* Not fatal: regular pages are used if THP is disabled */
+	if (madvise(buf->data, buf->map_size, MADV_HUGEPAGE) < 0)
+		ULOGD("madvise:MADV_HUGEPAGE failed (%d)", errno);
+
+	return 0;
+}
+
+
+static void buf_free(struct vscale_mem_buf *buf)
+{
+	if (buf == NULL)
+		return;
+
+	switch (buf->pool->type) {
+	case VSCALE_MEM_TYPE_MEMFD:
+		if (buf->data != NULL)
+			munmap(buf->data, buf->size);
+		if (buf->fd >= 0)
+			close(buf->fd);
+		break;
+	case VSCALE_MEM_TYPE_HUGE_PAGES:
+		if (buf->data != NULL)
+			munmap(buf->data, buf->map_size);
+		break;
+	default:
+		free(buf->data);
+		break;
+	}
+
+	free(buf);
+}
+
+
+static int buf_new(struct vscale_mem_pool *pool, struct vscale_mem_buf **ret)
+{
+	int res;
+	struct vscale_mem_buf *buf;
+	int node;
+
+	buf = calloc(1, sizeof(*buf));
+	if (buf == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("calloc", -res);
+		return res;
+	}
+	buf->pool = pool;
+	buf->size = pool->size;
+	buf->fd = -1;
+	buf->numa_node = -1;
+
+	switch (pool->type) {
+	case VSCALE_MEM_TYPE_MEMFD:
+		res = buf_alloc_memfd(buf, pool->name);
+		break;
+	case VSCALE_MEM_TYPE_HUGE_PAGES:
+		res = buf_alloc_huge_pages(buf);
+		break;
+	default:
+		res = buf_alloc_generic(buf);
+		break;
+	}
+	if (res < 0) {
+		buf_free(buf);
+		return res;
+	}
+
+	/* Bind before the pages are first touched; not fatal, the buffer
+	 * is then allocated on the local node; binding is not available
+	 * everywhere (e.g. mbind denied in containers), the pool stops
+	 * binding its buffers after the first failure so that they are
+	 * still recycled */
+	pthread_mutex_lock(&pool->mutex);
+	node = pool->numa_node;
+	pthread_mutex_unlock(&pool->mutex);
+	if (node >= 0) {
+		res = vscale_numa_bind_mem(buf->data,
+					   buf->map_size != 0 ? buf->map_size
+							      : buf->size,
+					   node);
+		if (res == 0) {
+			buf->numa_node = node;
+		} else {
+			pthread_mutex_lock(&pool->mutex);
+			if (pool->numa_node == node)
+				pool->numa_node = -1;
+			pthread_mutex_unlock(&pool->mutex);
+			ULOGW("%s: NUMA binding failed, buffers are not bound",
+			      pool->name);
+		}
+	}
+
+	if (pool->prefault)
+		memset(buf->data, 0, buf->size);
+
+	*ret = buf;
+	return 0;
+}
+
+
+static void pool_free(struct vscale_mem_pool *pool)
+{
+	while (pool->free_list != NULL) {
+		struct vscale_mem_buf *buf = pool->free_list;
+		pool->free_list = buf->next;
+		buf_free(buf);
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->name);
+	free(pool);
+}
+
+
+/* Called when the last reference on a buffer mbuf_mem is dropped, from
+ * any thread */
+static void buf_release(void *data, size_t len, void *userdata)
+{
+	struct vscale_mem_buf *buf = userdata;
+	struct vscale_mem_pool *pool = buf->pool;
+	bool last;
+	bool stale;
+
+	pthread_mutex_lock(&pool->mutex);
+	/* Buffers bound to a previous NUMA node are not recycled */
+	stale = (pool->numa_node >= 0 && buf->numa_node != pool->numa_node);
+	if (stale) {
+		pool->count--;
+	} else {
+		buf->next = pool->free_list;
+		pool->free_list = buf;
+	}
+	last = (--pool->refcount == 0);
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (stale)
+		buf_free(buf);
+	if (last)
+		pool_free(pool);
+}
+
+
+int vscale_mem_pool_new(const struct vscale_mem_pool_config *config,
+			struct vscale_mem_pool **ret_obj)
+{
+	int res;
+	struct vscale_mem_pool *pool;
+
+	ULOG_ERRNO_RETURN_ERR_IF(config == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(config->size == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(ret_obj == NULL, EINVAL);
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("calloc", -res);
+		return res;
+	}
+	pthread_mutex_init(&pool->mutex, NULL);
+	pool->type = config->type;
+	pool->size = config->size;
+	pool->max_count = config->max_count;
+	pool->prefault = config->prefault;
+	pool->numa_node = config->numa_bind ? (int)config->numa_node : -1;
+	pool->refcount = 1;
+	pool->name = strdup(config->name != NULL ? config->name : "vscale");
+	if (pool->name == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("strdup", -res);
+		goto error;
+	}
+
+	for (unsigned int i = 0; i < config->initial_count; i++) {
+		struct vscale_mem_buf *buf;
+		res = buf_new(pool, &buf);
+		if (res < 0)
+			goto error;
+		buf->next = pool->free_list;
+		pool->free_list = buf;
+		pool->count++;
+	}
+
+	*ret_obj = pool;
+	return 0;
+
+error:
+	pool_free(pool);
+	return res;
+}
+
+
+int vscale_mem_pool_destroy(struct vscale_mem_pool *pool)
+{
+	bool last;
+
+	if (pool == NULL)
+		return 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	last = (--pool->refcount == 0);
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (last)
+		pool_free(pool);
+
+	return 0;
+}
+
+
+int vscale_mem_pool_set_numa_node(struct vscale_mem_pool *pool,
+				  unsigned int node)
+{
+	struct vscale_mem_buf *stale;
+
+	ULOG_ERRNO_RETURN_ERR_IF(pool == NULL, EINVAL);
+
+	/* Free the available buffers bound elsewhere, buffers in use are
+	 * freed when released */
+	pthread_mutex_lock(&pool->mutex);
+	pool->numa_node = node;
+	stale = pool->free_list;
+	pool->free_list = NULL;
+	while (stale != NULL) {
+		struct vscale_mem_buf *buf = stale;
+		stale = buf->next;
+		if (buf->numa_node == pool->numa_node) {
+			buf->next = pool->free_list;
+			pool->free_list = buf;
+		} else {
+			pool->count--;
+			buf->next = NULL;
+			buf_free(buf);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return 0;
+}
+
+
+int vscale_mem_pool_get(struct vscale_mem_pool *pool,
+			struct mbuf_mem **mem,
+			int *fd)
+{
+	int res;
+	struct vscale_mem_buf *buf = NULL;
+
+	ULOG_ERRNO_RETURN_ERR_IF(pool == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(mem == NULL, EINVAL);
+
+	pthread_mutex_lock(&pool->mutex);
+	if (pool->free_list != NULL) {
+		buf = pool->free_list;
+		pool->free_list = buf->next;
+	} else if (pool->max_count != 0 && pool->count >= pool->max_count) {
+		pthread_mutex_unlock(&pool->mutex);
+		return -EAGAIN;
+	} else {
+		/* Reserve the slot, allocate outside of the lock */
+		pool->count++;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (buf == NULL) {
+		res = buf_new(pool, &buf);
+		if (res < 0) {
+			pthread_mutex_lock(&pool->mutex);
+			pool->count--;
+			pthread_mutex_unlock(&pool->mutex);
+			return res;
+		}
+	}
+	buf->next = NULL;
+
+	res = mbuf_mem_generic_wrap(
+		buf->data, buf->size, buf_release, buf, mem);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_mem_generic_wrap", -res);
+		pthread_mutex_lock(&pool->mutex);
+		buf->next = pool->free_list;
+		pool->free_list = buf;
+		pthread_mutex_unlock(&pool->mutex);
+		return res;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->refcount++;
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (fd != NULL)
+		*fd = buf->fd;
+
+	return 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define ULOG_TAG vcsale_core
+#include <ulog.h>
+
+#include <video-scale/vscale_internal.h>
+
+
+/* Memory policy definitions (see linux/mempolicy.h), libnuma is not
+ * required */
+#define NUMA_MPOL_BIND 2
+#define NUMA_MPOL_MF_MOVE (1 << 1)
+#define NUMA_MPOL_F_NODE (1 << 0)
+#define NUMA_MPOL_F_ADDR (1 << 1)
+
+#define NUMA_MAX_NODES 64
+
+/* Node masks are arrays of unsigned long; the kernel reads maxnode - 1
+ * bits of the mask passed with maxnode */
+#define NUMA_MASK_LONGS ((NUMA_MAX_NODES + LONG_BIT) / LONG_BIT)
+
+#define SYSFS_NODE_PATH "/sys/devices/system/node"
+
+
+/* Parse a sysfs list (e.g. "0-3,8-11") and call cb for each value;
+ * returns the number of values or a negative errno */
+static int parse_list_file(const char *path,
+			   void (*cb)(unsigned int val, void *userdata),
+			   void *userdata)
+{
+	int res = 0;
+	FILE *f;
+	unsigned int start;
+	unsigned int end;
+	int c;
+
+	f = fopen(path, "r");
+	if (f == NULL)
+		return -errno;
+
+	while (fscanf(f, "%u", &start) == 1) {
+		end = start;
+		c = fgetc(f);
+		if (c == '-') {
+			if (fscanf(f, "%u", &end) != 1)
+				break;
+			c = fgetc(f);
+		}
+		for (unsigned int i = start; i <= end; i++) {
+			if (cb != NULL)
+				cb(i, userdata);
+			res++;
+		}
+		if (c != ',')
+			break;
+	}
+
+	fclose(f);
+	return res;
+}
+
+
+static void add_cpu(unsigned int cpu, void *userdata)
+{
+	cpu_set_t *set = userdata;
+
+	if (cpu < CPU_SETSIZE)
+		CPU_SET(cpu, set);
+}
+
+
+unsigned int vscale_numa_node_count(void)
+{
+	int res = parse_list_file(SYSFS_NODE_PATH "/online", NULL, NULL);
+
+	return (res > 0) ? (unsigned int)res : 1;
+}
+
+
+struct node_lookup {
+	unsigned int node;
+	bool found;
+};
+
+
+static void find_node(unsigned int node, void *userdata)
+{
+	struct node_lookup *lookup = userdata;
+
+	if (node == lookup->node)
+		lookup->found = true;
+}
+
+
+bool vscale_numa_node_is_online(unsigned int node)
+{
+	struct node_lookup lookup = {.node = node};
+	int res;
+
+	res = parse_list_file(SYSFS_NODE_PATH "/online", find_node, &lookup);
+
+	/* Without the sysfs list, only the node 0 is known */
+	if (res <= 0)
+		return node == 0;
+
+	return lookup.found;
+}
+
+
+int vscale_numa_get_mem_node(const void *addr)
+{
+	int node = -1;
+	long res;
+
+	ULOG_ERRNO_RETURN_ERR_IF(addr == NULL, EINVAL);
+
+	res = syscall(SYS_get_mempolicy,
+		      &node,
+		      NULL,
+		      0,
+		      addr,
+		      NUMA_MPOL_F_NODE | NUMA_MPOL_F_ADDR);
+	if (res < 0) {
+		res = -errno;
+		ULOG_ERRNO("get_mempolicy", (int)-res);
+		return (int)res;
+	}
+
+	return node;
+}
+
+
+int vscale_numa_bind_thread(unsigned int node)
+{
+	int res;
+	char path[64];
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	snprintf(path, sizeof(path), SYSFS_NODE_PATH "/node%u/cpulist", node);
+	res = parse_list_file(path, add_cpu, &set);
+	if (res < 0) {
+		ULOG_ERRNO("parse_list_file:'%s'", -res, path);
+		return res;
+	} else if (res == 0) {
+		/* Memory-only node */
+		return -ENODEV;
+	}
+
+	res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (res != 0) {
+		ULOG_ERRNO("pthread_setaffinity_np", res);
+		return -res;
+	}
+
+	return 0;
+}
+
+
+int vscale_numa_bind_mem(void *addr, size_t len, unsigned int node)
+{
+	long res;
+	unsigned long nodemask[NUMA_MASK_LONGS] = {0};
+
+	ULOG_ERRNO_RETURN_ERR_IF(addr == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(node >= NUMA_MAX_NODES, EINVAL);
+
+	nodemask[node / LONG_BIT] = 1UL << (node % LONG_BIT);
+	res = syscall(SYS_mbind,
+		      addr,
+		      len,
+		      NUMA_MPOL_BIND,
+		      nodemask,
+		      NUMA_MAX_NODES + 1,
+		      NUMA_MPOL_MF_MOVE);
+	if (res < 0) {
+		res = -errno;
+		ULOG_ERRNO("mbind", (int)-res);
+		return (int)res;
+	}
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/param.h>
+
+#define ULOG_TAG vcsale_core
+#include <ulog.h>
+
+#include <video-scale/vscale_internal.h>
+
+
+/* Destination tile size in pixels for rotations, so that both the source
+ * columns and the destination rows of a tile stay in cache */
+#define TILE_SIZE 32
+
+
+bool vscale_orientation_is_transposed(enum vscale_orientation orientation)
+{
+	return orientation == VSCALE_ORIENTATION_ROTATE_90 ||
+	       orientation == VSCALE_ORIENTATION_ROTATE_270;
+}
+
+
+bool vscale_orientation_keeps_rows(enum vscale_orientation orientation)
+{
+	return orientation == VSCALE_ORIENTATION_NORMAL ||
+	       orientation == VSCALE_ORIENTATION_MIRROR_H;
+}
+
+
+uint8_t *vscale_orient_rows_dst(uint8_t *plane,
+				size_t stride,
+				unsigned int height,
+				unsigned int y,
+				unsigned int rows,
+				unsigned int pixel_size,
+				enum vscale_orientation orientation)
+{
+	switch (orientation) {
+	case VSCALE_ORIENTATION_ROTATE_90:
+		/* Scaled row y is output column height - 1 - y */
+		return plane + (size_t)(height - y - rows) * pixel_size;
+	case VSCALE_ORIENTATION_ROTATE_270:
+		/* Scaled row y is output column y */
+		return plane + (size_t)y * pixel_size;
+	case VSCALE_ORIENTATION_ROTATE_180:
+	case VSCALE_ORIENTATION_MIRROR_V:
+		/* Scaled row y is output row height - 1 - y */
+		return plane + (size_t)(height - y - rows) * stride;
+	default:
+		return plane + (size_t)y * stride;
+	}
+}
+
+
+static inline __attribute__((always_inline)) void
+copy_pixels(uint8_t *dst,
+	    const uint8_t *src,
+	    ptrdiff_t step,
+	    unsigned int count,
+	    unsigned int pixel_size)
+{
+	switch (pixel_size) {
+	case 1:
+		for (unsigned int i = 0; i < count; i++, src += step)
+			dst[i] = *src;
+		break;
+	case 2:
+		for (unsigned int i = 0; i < count; i++, src += step)
+			memcpy(dst + 2 * i, src, 2);
+		break;
+	default:
+		for (unsigned int i = 0; i < count; i++, src += step)
+			memcpy(dst + pixel_size * i, src, pixel_size);
+		break;
+	}
+}
+
+
+/* Every destination pixel (x, y) is read from origin + x * step_x +
+ * y * step_y in the source plane */
+static inline __attribute__((always_inline)) void
+orient_pixels(const uint8_t *origin,
+	      ptrdiff_t step_x,
+	      ptrdiff_t step_y,
+	      uint8_t *dst,
+	      size_t dst_stride,
+	      unsigned int dst_width,
+	      unsigned int dst_height,
+	      unsigned int pixel_size)
+{
+	unsigned int tile_w = TILE_SIZE;
+
+	/* Rows are read in order: no need for tiles */
+	if (step_x == (ptrdiff_t)pixel_size || step_x == -(ptrdiff_t)pixel_size)
+		tile_w = dst_width;
+
+	for (unsigned int tx = 0; tx < dst_width; tx += tile_w) {
+		unsigned int w = MIN(tile_w, dst_width - tx);
+		for (unsigned int y = 0; y < dst_height; y++) {
+			copy_pixels(dst + y * dst_stride + tx * pixel_size,
+				    origin + (ptrdiff_t)tx * step_x +
+					    (ptrdiff_t)y * step_y,
+				    step_x,
+				    w,
+				    pixel_size);
+		}
+	}
+}
+
+
+void vscale_orient_plane(const uint8_t *src,
+			 size_t src_stride,
+			 uint8_t *dst,
+			 size_t dst_stride,
+			 unsigned int width,
+			 unsigned int height,
+			 unsigned int pixel_size,
+			 enum vscale_orientation orientation)
+{
+	const uint8_t *origin = src;
+	ptrdiff_t ps = pixel_size;
+	ptrdiff_t stride = src_stride;
+	ptrdiff_t step_x = ps;
+	ptrdiff_t step_y = stride;
+	unsigned int dst_width = width;
+	unsigned int dst_height = height;
+
+	if (width == 0 || height == 0)
+		return;
+
+	switch (orientation) {
+	case VSCALE_ORIENTATION_ROTATE_90:
+		/* Destination (x, y) is source (y, height - 1 - x) */
+		origin = src + (height - 1) * stride;
+		step_x = -stride;
+		step_y = ps;
+		break;
+	case VSCALE_ORIENTATION_ROTATE_180:
+		origin = src + (height - 1) * stride + (width - 1) * ps;
+		step_x = -ps;
+		step_y = -stride;
+		break;
+	case VSCALE_ORIENTATION_ROTATE_270:
+		/* Destination (x, y) is source (width - 1 - y, x) */
+		origin = src + (width - 1) * ps;
+		step_x = stride;
+		step_y = -ps;
+		break;
+	case VSCALE_ORIENTATION_MIRROR_H:
+		origin = src + (width - 1) * ps;
+		step_x = -ps;
+		break;
+	case VSCALE_ORIENTATION_MIRROR_V:
+		origin = src + (height - 1) * stride;
+		step_y = -stride;
+		break;
+	default:
+		break;
+	}
+
+	if (vscale_orientation_is_transposed(orientation)) {
+		dst_width = height;
+		dst_height = width;
+	}
+
+	if (step_x == ps) {
+		/* Whole rows */
+		for (unsigned int y = 0; y < dst_height; y++) {
+			memcpy(dst + y * dst_stride,
+			       origin + (ptrdiff_t)y * step_y,
+			       (size_t)dst_width * pixel_size);
+		}
+		return;
+	}
+
+	/* Specialize the common pixel sizes */
+	switch (pixel_size) {
+	case 1:
+		orient_pixels(origin,
+			      step_x,
+			      step_y,
+			      dst,
+			      dst_stride,
+			      dst_width,
+			      dst_height,
+			      1);
+		break;
+	case 2:
+		orient_pixels(origin,
+			      step_x,
+			      step_y,
+			      dst,
+			      dst_stride,
+			      dst_width,
+			      dst_height,
+			      2);
+		break;
+	default:
+		orient_pixels(origin,
+			      step_x,
+			      step_y,
+			      dst,
+			      dst_stride,
+			      dst_width,
+			      dst_height,
+			      pixel_size);
+		break;
+	}
+}
@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/param.h>
+
+#define ULOG_TAG vcsale_core
+#include <ulog.h>
+
+#include <video-scale/vscale_internal.h>
+
+
+int vscale_frame_set_rois(struct mbuf_raw_video_frame *frame,
+			  const struct vdef_rect *rois,
+			  unsigned int count)
+{
+	int err;
+
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(rois == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(count == 0, EINVAL);
+
+	err = mbuf_raw_video_frame_add_ancillary_buffer(
+		frame, VSCALE_ANCILLARY_KEY_ROIS, rois, count * sizeof(*rois));
+	if (err < 0)
+		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -err);
+
+	return err;
+}
+
+
+int vscale_frame_get_roi(struct mbuf_raw_video_frame *frame,
+			 struct vscale_roi *roi)
+{
+	int err;
+	struct mbuf_ancillary_data *data;
+	const void *buf;
+	size_t len;
+
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(roi == NULL, EINVAL);
+
+	err = mbuf_raw_video_frame_get_ancillary_data(
+		frame, VSCALE_ANCILLARY_KEY_ROI, &data);
+	if (err < 0)
+		return err;
+
+	buf = mbuf_ancillary_data_get_buffer(data, &len);
+	if (buf == NULL || len != sizeof(*roi)) {
+		err = -EPROTO;
+		goto out;
+	}
+	memcpy(roi, buf, sizeof(*roi));
+
+out:
+	mbuf_ancillary_data_unref(data);
+	return err;
+}
+
+
+/* Clip [start, start + len) to [0, max) and align it on even values;
+ * returns the aligned length */
+static unsigned int align_range(int start,
+				unsigned int len,
+				unsigned int max,
+				int *aligned)
+{
+	int64_t s = MAX(start, 0);
+	int64_t e = MIN((int64_t)start + len, (int64_t)max);
+
+	if (e <= s)
+		return 0;
+	s &= ~(int64_t)1;
+	e = MIN((e + 1) & ~(int64_t)1, (int64_t)max);
+	*aligned = s;
+	return e - s;
+}
+
+
+int vscale_frame_get_input_rois(struct mbuf_raw_video_frame *frame,
+				const struct vdef_dim *resolution,
+				struct vdef_rect *rois,
+				unsigned int max)
+{
+	int err;
+	struct mbuf_ancillary_data *data;
+	const struct vdef_rect *buf;
+	size_t len;
+	unsigned int count = 0, total;
+
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(resolution == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(rois == NULL && max > 0, EINVAL);
+
+	err = mbuf_raw_video_frame_get_ancillary_data(
+		frame, VSCALE_ANCILLARY_KEY_ROIS, &data);
+	if (err == -ENOENT)
+		return 0;
+	else if (err < 0)
+		return err;
+
+	buf = mbuf_ancillary_data_get_buffer(data, &len);
+	if (buf == NULL || len % sizeof(*buf) != 0) {
+		err = -EPROTO;
+		ULOG_ERRNO("invalid regions of interest size: %zu", -err, len);
+		goto out;
+	}
+	total = len / sizeof(*buf);
+
+	for (unsigned int i = 0; i < total && count < max; i++) {
+		struct vdef_rect *roi = &rois[count];
+		roi->width = align_range(buf[i].left,
+					 buf[i].width,
+					 resolution->width,
+					 &roi->left);
+		roi->height = align_range(buf[i].top,
+					  buf[i].height,
+					  resolution->height,
+					  &roi->top);
+		if (roi->width < 2 || roi->height < 2)
+			continue;
+		count++;
+	}
+	if (total > max) {
+		ULOGW("too many regions of interest: %u, only the first %u "
+		      "are kept",
+		      total,
+		      max);
+	}
+	err = count;
+
+out:
+	mbuf_ancillary_data_unref(data);
+	return err;
+}
+
+
+int vscale_roi_fit_compute(enum vscale_fit_mode mode,
+			   const struct vdef_rect *roi,
+			   const struct vdef_dim *dst,
+			   struct vscale_fit_plane *luma,
+			   struct vscale_fit_plane *chroma)
+{
+	int err;
+	struct vdef_dim src;
+
+	ULOG_ERRNO_RETURN_ERR_IF(roi == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(chroma == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF((roi->left | roi->top) & 1, EINVAL);
+
+	src.width = roi->width;
+	src.height = roi->height;
+	err = vscale_fit_compute(mode, &src, dst, luma, chroma);
+	if (err < 0)
+		return err;
+
+	luma->crop.left += roi->left;
+	luma->crop.top += roi->top;
+	chroma->crop.left += roi->left / 2;
+	chroma->crop.top += roi->top / 2;
+
+	return 0;
+}
@@ -0,0 +1,333 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#define ULOG_TAG vcsale_core
+#include <ulog.h>
+
+#include <video-scale/vscale_internal.h>
+
+
+const struct vdef_raw_format vscale_rgb_planar = {
+	.pix_format = VDEF_RAW_PIX_FORMAT_RGB24,
+	.pix_order = VDEF_RAW_PIX_ORDER_RGB,
+	.pix_layout = VDEF_RAW_PIX_LAYOUT_PLANAR,
+	.pix_size = 8,
+	.data_layout = VDEF_RAW_DATA_LAYOUT_PACKED,
+	.data_pad_low = false,
+	.data_little_endian = false,
+	.data_size = 8,
+};
+
+
+const struct vdef_raw_format vscale_rgb_planar_f16 = {
+	.pix_format = VDEF_RAW_PIX_FORMAT_RGB24,
+	.pix_order = VDEF_RAW_PIX_ORDER_RGB,
+	.pix_layout = VDEF_RAW_PIX_LAYOUT_PLANAR,
+	.pix_size = 16,
+	.data_layout = VDEF_RAW_DATA_LAYOUT_PACKED,
+	.data_pad_low = false,
+	.data_little_endian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+	.data_size = 16,
+};
+
+
+const struct vdef_raw_format vscale_rgb_planar_f32 = {
+	.pix_format = VDEF_RAW_PIX_FORMAT_RGB24,
+	.pix_order = VDEF_RAW_PIX_ORDER_RGB,
+	.pix_layout = VDEF_RAW_PIX_LAYOUT_PLANAR,
+	.pix_size = 32,
+	.data_layout = VDEF_RAW_DATA_LAYOUT_PACKED,
+	.data_pad_low = false,
+	.data_little_endian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+	.data_size = 32,
+};
+
+
+/* IEEE half precision float from single precision, rounded to the nearest
+ * even value */
+static uint16_t float_to_half(float f)
+{
+	union {
+		float f;
+		uint32_t u;
+	} v = {.f = f};
+	uint32_t sign = (v.u >> 16) & 0x8000;
+	uint32_t fexp = (v.u >> 23) & 0xff;
+	uint32_t mant = v.u & 0x7fffff;
+	int32_t exp = (int32_t)fexp - 127 + 15;
+	uint32_t h, rem, half;
+	unsigned int shift;
+
+	if (fexp == 0xff)
+		return sign | 0x7c00 | (mant ? 0x200 : 0);
+	if (exp >= 31)
+		return sign | 0x7c00;
+	if (exp <= 0) {
+		/* Subnormal or zero */
+		if (exp < -10)
+			return sign;
+		mant |= 0x800000;
+		shift = 14 - exp;
+		h = mant >> shift;
+		rem = mant & ((1u << shift) - 1);
+		half = 1u << (shift - 1);
+	} else {
+		h = ((uint32_t)exp << 10) | (mant >> 13);
+		rem = mant & 0x1fff;
+		half = 0x1000;
+	}
+	/* A carry into the exponent gives the right value */
+	if (rem > half || (rem == half && (h & 1)))
+		h++;
+	return sign | h;
+}
+
+
+int vscale_tensor_init(struct vscale_tensor *tensor,
+		       const struct vscale_config *config)
+{
+	const struct vdef_format_info *info;
+	unsigned int w, h, sample_size = 1;
+	double kr, kb, kg, yo, ys, cs;
+
+	ULOG_ERRNO_RETURN_ERR_IF(tensor == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(config == NULL, EINVAL);
+
+	memset(tensor, 0, sizeof(*tensor));
+	tensor->format = config->output.tensor.format;
+	w = config->output.info.resolution.width;
+	h = config->output.info.resolution.height;
+	tensor->width = w;
+
+	switch (tensor->format) {
+	case VSCALE_TENSOR_FORMAT_RGB8:
+		tensor->raw_format = vdef_rgb;
+		tensor->plane_count = 1;
+		tensor->plane_stride[0] = (size_t)3 * w;
+		break;
+	case VSCALE_TENSOR_FORMAT_RGB8_PLANAR:
+		tensor->raw_format = vscale_rgb_planar;
+		sample_size = 1;
+		break;
+	case VSCALE_TENSOR_FORMAT_RGB_F16_PLANAR:
+		tensor->raw_format = vscale_rgb_planar_f16;
+		sample_size = 2;
+		break;
+	case VSCALE_TENSOR_FORMAT_RGB_F32_PLANAR:
+		tensor->raw_format = vscale_rgb_planar_f32;
+		sample_size = 4;
+		break;
+	default:
+		ULOGE("unsupported tensor format: %s",
+		      vscale_tensor_format_to_str(tensor->format));
+		return -EINVAL;
+	}
+	if (tensor->format != VSCALE_TENSOR_FORMAT_RGB8) {
+		tensor->plane_count = 3;
+		for (unsigned int i = 0; i < 3; i++)
+			tensor->plane_stride[i] = (size_t)sample_size * w;
+	}
+	for (unsigned int i = 0; i < tensor->plane_count; i++) {
+		tensor->plane_size[i] = tensor->plane_stride[i] * h;
+		tensor->size += tensor->plane_size[i];
+	}
+
+	info = &config->input.info;
+	if (info->matrix_coefs == VDEF_MATRIX_COEFS_IDENTITY) {
+		ULOGE("unsupported tensor color matrix: %s",
+		      vdef_matrix_coefs_to_str(info->matrix_coefs));
+		vscale_tensor_clear(tensor);
+		return -ENOSYS;
+	}
+	vscale_color_matrix_coefs(info->matrix_coefs, &kr, &kb);
+	vscale_color_range_coefs(info->full_range, &yo, &ys, &cs);
+	kg = 1. - kr - kb;
+
+	/* Full range RGB in [0, 255] */
+	for (unsigned int v = 0; v < 256; v++) {
+		tensor->y_base[v] =
+			vscale_color_to_fixed(255. * (v - yo) / ys) +
+			(1 << (VSCALE_COLOR_CONV_BITS - 1));
+	}
+	tensor->r_v = vscale_color_to_fixed(255. * 2. * (1. - kr) / cs);
+	tensor->b_u = vscale_color_to_fixed(255. * 2. * (1. - kb) / cs);
+	tensor->g_u =
+		vscale_color_to_fixed(-255. * 2. * kb * (1. - kb) / (kg * cs));
+	tensor->g_v =
+		vscale_color_to_fixed(-255. * 2. * kr * (1. - kr) / (kg * cs));
+
+	for (unsigned int c = 0; c < 3; c++) {
+		float mean = config->output.tensor.mean[c];
+		float scale = config->output.tensor.scale[c];
+		if (scale == 0.f)
+			scale = 1.f;
+		tensor->norm_mul[c] = scale / (1 << VSCALE_COLOR_CONV_BITS);
+		tensor->norm_add[c] = -mean * scale;
+	}
+
+	return 0;
+}
+
+
+void vscale_tensor_clear(struct vscale_tensor *tensor)
+{
+	if (tensor == NULL)
+		return;
+
+	memset(tensor, 0, sizeof(*tensor));
+}
+
+
+/* Fixed point R, G and B values of a pixel, with the rounding offset */
+static inline void pixel_rgb(const struct vscale_tensor *tensor,
+			     const uint8_t *y_row,
+			     const uint8_t *u_row,
+			     const uint8_t *v_row,
+			     unsigned int step,
+			     unsigned int x,
+			     int32_t *rgb)
+{
+	int32_t u = u_row[(x / 2) * step] - 128;
+	int32_t v = v_row[(x / 2) * step] - 128;
+	int32_t y = tensor->y_base[y_row[x]];
+
+	rgb[0] = y + tensor->r_v * v;
+	rgb[1] = y + tensor->g_u * u + tensor->g_v * v;
+	rgb[2] = y + tensor->b_u * u;
+}
+
+
+/* Normalized value of channel c from its fixed point value, clamped to
+ * [0, 255] but not rounded to an 8-bit value */
+static inline float channel_norm(const struct vscale_tensor *tensor,
+				 unsigned int c,
+				 int32_t v)
+{
+	const int32_t max = 255 << VSCALE_COLOR_CONV_BITS;
+
+	v -= 1 << (VSCALE_COLOR_CONV_BITS - 1);
+	v = (v < 0) ? 0 : (v > max) ? max : v;
+	return (float)v * tensor->norm_mul[c] + tensor->norm_add[c];
+}
+
+
+/* Tensor row y from a luma row and its chroma row */
+static void convert_row(const struct vscale_tensor *tensor,
+			const uint8_t *y_row,
+			const uint8_t *u_row,
+			const uint8_t *v_row,
+			unsigned int step,
+			uint8_t *const *dst,
+			unsigned int y)
+{
+	int32_t rgb[3];
+	uint8_t *row[3];
+
+	for (unsigned int c = 0; c < tensor->plane_count; c++)
+		row[c] = dst[c] + y * tensor->plane_stride[c];
+
+	switch (tensor->format) {
+	case VSCALE_TENSOR_FORMAT_RGB8:
+		for (unsigned int x = 0; x < tensor->width; x++) {
+			pixel_rgb(tensor, y_row, u_row, v_row, step, x, rgb);
+			for (unsigned int c = 0; c < 3; c++) {
+				row[0][3 * x + c] =
+					vscale_color_from_fixed(rgb[c]);
+			}
+		}
+		break;
+	case VSCALE_TENSOR_FORMAT_RGB8_PLANAR:
+		for (unsigned int x = 0; x < tensor->width; x++) {
+			pixel_rgb(tensor, y_row, u_row, v_row, step, x, rgb);
+			for (unsigned int c = 0; c < 3; c++)
+				row[c][x] = vscale_color_from_fixed(rgb[c]);
+		}
+		break;
+	case VSCALE_TENSOR_FORMAT_RGB_F16_PLANAR:
+		for (unsigned int x = 0; x < tensor->width; x++) {
+			pixel_rgb(tensor, y_row, u_row, v_row, step, x, rgb);
+			for (unsigned int c = 0; c < 3; c++) {
+				((uint16_t *)row[c])[x] = float_to_half(
+					channel_norm(tensor, c, rgb[c]));
+			}
+		}
+		break;
+	case VSCALE_TENSOR_FORMAT_RGB_F32_PLANAR:
+		for (unsigned int x = 0; x < tensor->width; x++) {
+			pixel_rgb(tensor, y_row, u_row, v_row, step, x, rgb);
+			for (unsigned int c = 0; c < 3; c++) {
+				((float *)row[c])[x] =
+					channel_norm(tensor, c, rgb[c]);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+
+void vscale_tensor_convert_rows(const struct vscale_tensor *tensor,
+				const struct vdef_raw_format *format,
+				const uint8_t *const *planes,
+				const size_t *strides,
+				unsigned int height,
+				uint8_t *const *dst,
+				unsigned int y,
+				unsigned int rows)
+{
+	unsigned int y_end = MIN(y + rows, height);
+	const uint8_t *u_plane, *v_plane;
+	unsigned int step;
+
+	if (vdef_raw_format_cmp(format, &vdef_i420)) {
+		u_plane = planes[1];
+		v_plane = planes[2];
+		step = 1;
+	} else if (vdef_raw_format_cmp(format, &vdef_nv21)) {
+		v_plane = planes[1];
+		u_plane = planes[1] + 1;
+		step = 2;
+	} else {
+		u_plane = planes[1];
+		v_plane = planes[1] + 1;
+		step = 2;
+	}
+
+	for (unsigned int r = y; r < y_end; r++) {
+		const uint8_t *y_row = planes[0] + r * strides[0];
+		const uint8_t *u_row = u_plane + (r / 2) * strides[1];
+		const uint8_t *v_row =
+			v_plane + (r / 2) * strides[(step == 1) ? 2 : 1];
+
+		convert_row(tensor, y_row, u_row, v_row, step, dst, r);
+	}
+}
@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#define ULOG_TAG vcsale_core
+#include <ulog.h>
+
+#include <video-scale/vscale_internal.h>
+
+
+/* Maximum mesh nodes per dimension */
+#define MESH_MAX_NODES 4096
+
+
+int vscale_warp_check(const struct vscale_warp *warp)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(warp == NULL, EINVAL);
+
+	switch (warp->type) {
+	case VSCALE_WARP_TYPE_NONE:
+	case VSCALE_WARP_TYPE_AFFINE:
+		return 0;
+	case VSCALE_WARP_TYPE_MESH:
+		if (warp->mesh == NULL || warp->mesh_cols < 2 ||
+		    warp->mesh_rows < 2 || warp->mesh_cols > MESH_MAX_NODES ||
+		    warp->mesh_rows > MESH_MAX_NODES) {
+			ULOGE("invalid warp mesh: %ux%u%s",
+			      warp->mesh_cols,
+			      warp->mesh_rows,
+			      warp->mesh == NULL ? " (no nodes)" : "");
+			return -EINVAL;
+		}
+		return 0;
+	default:
+		ULOGE("invalid warp type: %d", warp->type);
+		return -EINVAL;
+	}
+}
+
+
+size_t vscale_warp_mesh_size(const struct vscale_warp *warp)
+{
+	if (warp == NULL || warp->type != VSCALE_WARP_TYPE_MESH)
+		return 0;
+
+	return (size_t)warp->mesh_cols * warp->mesh_rows * 2 *
+	       sizeof(*warp->mesh);
+}
+
+
+bool vscale_warp_equal(const struct vscale_warp *a,
+		       const struct vscale_warp *b)
+{
+	if (a == NULL || b == NULL || a->type != b->type)
+		return false;
+
+	switch (a->type) {
+	case VSCALE_WARP_TYPE_AFFINE:
+		return memcmp(a->matrix, b->matrix, sizeof(a->matrix)) == 0;
+	case VSCALE_WARP_TYPE_MESH:
+		return a->mesh_cols == b->mesh_cols &&
+		       a->mesh_rows == b->mesh_rows &&
+		       memcmp(a->mesh, b->mesh, vscale_warp_mesh_size(a)) == 0;
+	default:
+		return true;
+	}
+}
+
+
+int vscale_frame_set_warp(struct mbuf_raw_video_frame *frame,
+			  const struct vscale_warp *warp)
+{
+	int err;
+	struct vscale_warp *buf;
+	size_t mesh_size, size;
+
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(warp == NULL, EINVAL);
+
+	err = vscale_warp_check(warp);
+	if (err < 0)
+		return err;
+
+	/* The mesh follows the warp structure, whose size keeps it
+	 * aligned */
+	mesh_size = vscale_warp_mesh_size(warp);
+	size = sizeof(*buf) + mesh_size;
+	buf = malloc(size);
+	if (buf == NULL) {
+		err = -ENOMEM;
+		ULOG_ERRNO("malloc", -err);
+		return err;
+	}
+	*buf = *warp;
+	buf->mesh = NULL;
+	if (mesh_size > 0)
+		memcpy(buf + 1, warp->mesh, mesh_size);
+
+	err = mbuf_raw_video_frame_add_ancillary_buffer(
+		frame, VSCALE_ANCILLARY_KEY_WARP, buf, size);
+	if (err < 0)
+		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -err);
+
+	free(buf);
+	return err;
+}
+
+
+int vscale_frame_get_warp(struct mbuf_raw_video_frame *frame,
+			  struct vscale_warp *warp,
+			  struct mbuf_ancillary_data **data)
+{
+	int err;
+	struct mbuf_ancillary_data *anc;
+	const struct vscale_warp *buf;
+	struct vscale_warp w;
+	size_t len;
+
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(warp == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(data == NULL, EINVAL);
+
+	err = mbuf_raw_video_frame_get_ancillary_data(
+		frame, VSCALE_ANCILLARY_KEY_WARP, &anc);
+	if (err < 0)
+		return err;
+
+	buf = mbuf_ancillary_data_get_buffer(anc, &len);
+	if (buf == NULL || len < sizeof(*buf)) {
+		err = -EPROTO;
+		ULOG_ERRNO("invalid warp size: %zu", -err, len);
+		goto error;
+	}
+	w = *buf;
+	w.mesh = (w.type == VSCALE_WARP_TYPE_MESH) ? (const float *)(buf + 1)
+						   : NULL;
+	if (len != sizeof(*buf) + vscale_warp_mesh_size(&w)) {
+		err = -EPROTO;
+		ULOG_ERRNO("invalid warp size: %zu", -err, len);
+		goto error;
+	}
+	err = vscale_warp_check(&w);
+	if (err < 0)
+		goto error;
+
+	*warp = w;
+	*data = anc;
+	return 0;
+
+error:
+	mbuf_ancillary_data_unref(anc);
+	return err;
+}
+
+
+static inline float lerp(float a, float b, float t)
+{
+	return a + (b - a) * t;
+}
+
+
+/* Mesh cell of a position on one dimension from its position in nodes
+ * units, and position in the cell; positions outside of the frame extend
+ * the border cells */
+static inline unsigned int mesh_cell(float g, unsigned int nodes, float *frac)
+{
+	unsigned int i;
+
+	if (!(g > 0.f))
+		i = 0;
+	else if (g >= nodes - 1)
+		i = nodes - 2;
+	else
+		i = g;
+	*frac = g - i;
+	return i;
+}
+
+
+/* Nodes per pixel of a mesh dimension */
+static float mesh_scale(unsigned int len, unsigned int nodes)
+{
+	return (len > 1) ? (float)(nodes - 1) / (len - 1) : 0.f;
+}
+
+
+void vscale_warp_apply_row(const struct vscale_warp *warp,
+			   const struct vdef_dim *dim,
+			   float x,
+			   float x_step,
+			   float y,
+			   unsigned int count,
+			   float *sx,
+			   float *sy)
+{
+	const float *m = warp->matrix;
+	const float *p, *q;
+	unsigned int i, j;
+	float fx, fy, scale;
+
+	switch (warp->type) {
+	case VSCALE_WARP_TYPE_AFFINE: {
+		float bx = m[1] * y + m[2];
+		float by = m[4] * y + m[5];
+		for (unsigned int k = 0; k < count; k++) {
+			float xk = x + k * x_step;
+			sx[k] = m[0] * xk + bx;
+			sy[k] = m[3] * xk + by;
+		}
+		break;
+	}
+	case VSCALE_WARP_TYPE_MESH:
+		/* Nodes above (p) and below (q) the row */
+		scale = mesh_scale(dim->height, warp->mesh_rows);
+		j = mesh_cell(y * scale, warp->mesh_rows, &fy);
+		p = warp->mesh + 2 * (size_t)j * warp->mesh_cols;
+		q = p + 2 * warp->mesh_cols;
+		scale = mesh_scale(dim->width, warp->mesh_cols);
+		for (unsigned int k = 0; k < count; k++) {
+			const float *a, *b;
+			i = mesh_cell((x + k * x_step) * scale,
+				      warp->mesh_cols,
+				      &fx);
+			a = p + 2 * i;
+			b = q + 2 * i;
+			sx[k] = lerp(lerp(a[0], a[2], fx),
+				     lerp(b[0], b[2], fx),
+				     fy);
+			sy[k] = lerp(lerp(a[1], a[3], fx),
+				     lerp(b[1], b[3], fx),
+				     fy);
+		}
+		break;
+	default:
+		for (unsigned int k = 0; k < count; k++) {
+			sx[k] = x + k * x_step;
+			sy[k] = y;
+		}
+		break;
+	}
+}
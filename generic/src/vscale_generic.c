@@ -0,0 +1,2294 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define ULOG_TAG vscale_generic
+#include <ulog.h>
+ULOG_DECLARE_TAG(ULOG_TAG);
+
+#include <limits.h>
+
+#include <pthread.h>
+#include <sys/param.h>
+
+#include <futils/futils.h>
+#include <futils/timetools.h>
+#include <libpomp.h>
+#include <media-buffers/mbuf_mem_generic.h>
+#include <media-buffers/mbuf_raw_video_frame.h>
+#include <video-scale/vscale_internal.h>
+#include <video-scale/vscale_mem.h>
+
+#include "vscale_generic_kernels.h"
+
+enum state {
+	RUNNING,
+	WAITING_FOR_STOP,
+	WAITING_FOR_FLUSH,
+	WAITING_FOR_EOS,
+};
+
+
+/* Number of region of interest sizes with cached plane contexts */
+#define ROI_PLANES_COUNT 4
+
+
+/* Chroma planes scaling job for an output band */
+struct band_job {
+	struct vscale_generic_plane *chroma;
+	const struct vscale_generic_remap *remap;
+	const struct vscale_fit_plane *fit;
+	const struct vdef_raw_frame *in_info;
+	const uint8_t **src;
+	uint8_t **dst;
+	uint8_t *scratch;
+	unsigned int cy, cy_end;
+	unsigned int chroma_planes;
+};
+
+
+/* Output frames scaling job of an input frame: the output frames
+ * [start, end) (one per region of interest, if any) in the output
+ * memory */
+struct frame_job {
+	const struct vdef_raw_frame *in_info;
+	const uint8_t **src;
+	const struct vscale_generic_remap *remap;
+	const struct vdef_raw_frame *out_info;
+	uint8_t *mem_data;
+	const size_t *out_plane_size;
+	unsigned int out_plane_count;
+	size_t out_size;
+	unsigned int roi_count;
+	unsigned int start;
+	unsigned int end;
+};
+
+
+/* Plane scaling contexts of a region of interest size, shared by the
+ * regions of this size */
+struct roi_planes {
+	struct vdef_dim size;
+	struct vscale_generic_plane luma;
+	struct vscale_generic_plane chroma;
+	uint64_t last_use;
+};
+
+
+/* Scaling resources of a thread: orientation scratch rows
+ * (ORIENT_BLOCK_ROWS rows of the luma and chroma contexts, NULL if the
+ * orientation does not need them), tensor conversion (shared by the
+ * threads, it is only read) and scratch frame (the frame is scaled into
+ * it, then converted to the tensor band by band), and plane contexts of the last used region sizes (least recently
+ * used first replaced) */
+struct scale_ctx {
+	uint8_t *luma_scratch;
+	uint8_t *chroma_scratch;
+	struct vscale_tensor *tensor;
+	uint8_t *tensor_yuv;
+	struct roi_planes roi_planes[ROI_PLANES_COUNT];
+	unsigned int roi_planes_count;
+	uint64_t roi_use_count;
+};
+
+
+struct vscale_generic {
+	struct vscale_scaler *base;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	bool stop_flag;
+	bool flush_flag;
+	bool eos_flag;
+
+	/* Failed input frames not reported yet and status of the last
+	 * failure, protected by the mutex (the error event coalesces the
+	 * signals, each failure is reported on its own) */
+	struct pomp_evt *error_event;
+	int status;
+	unsigned int error_count;
+
+	pthread_t thread;
+	bool thread_launched;
+
+	/* Pre-warm done by the scaling thread, protected by the mutex */
+	bool prewarmed;
+
+	enum state state;
+
+	struct mbuf_raw_video_frame_queue *input_queue;
+	struct mbuf_raw_video_frame_queue *output_queue;
+	struct pomp_evt *output_event;
+
+	/* Output buffer pool (NULL for heap memory) */
+	struct vscale_mem_pool *out_pool;
+
+	/* Plane scaling contexts; I420 U and V planes share the chroma
+	 * context; the luma context is only used by the scaling thread, the
+	 * chroma context by the chroma thread when it is launched */
+	const struct vscale_generic_kernels *kernels;
+	unsigned int comps;
+	struct vscale_generic_plane luma;
+	struct vscale_generic_plane chroma;
+
+	/* Regions of interest of the current input frame (max_rois
+	 * entries) */
+	struct vdef_rect *rois;
+
+	/* Scaling resources of the scaling thread, except the chroma
+	 * scratch rows used by the worker thread for the chroma bands */
+	struct scale_ctx ctx;
+
+	/* Output orientation; the plane contexts scale to the scaled
+	 * (not oriented) dimensions, rows are then written oriented through
+	 * the scratch rows of the scaling resources */
+	enum vscale_orientation orientation;
+
+	/* Luma and chroma planes fit geometry, in the scaled planes (the
+	 * plane contexts scale the crop rectangles to the content
+	 * rectangles), and pad pixel of each plane (interleaved chroma
+	 * planes use the chroma values in the plane components order) */
+	struct vscale_fit_plane fit[2];
+	uint8_t pad[3];
+
+	/* Output color matrix and range conversion, applied to each band
+	 * once all its planes are scaled */
+	struct vscale_color_conv color_conv;
+
+	/* Tensor output (the scratch frames of the scaling resources have
+	 * the output frame layout below) */
+	struct vscale_tensor tensor;
+
+	/* Luma-only output (gray output format): the chroma contexts are
+	 * not initialized, and the chroma planes neither scaled nor
+	 * allocated */
+	bool gray;
+
+	/* Input warp: luma and chroma remapping contexts, built for the
+	 * warp (with its mesh copied to mesh) and input strides of the last
+	 * warped frame; only used by the scaling thread, except the chroma
+	 * context by the chroma thread */
+	struct {
+		bool built;
+		struct vscale_warp last;
+		float *mesh;
+		size_t stride[2];
+		struct vscale_generic_remap remap[2];
+	} warp;
+
+	/* Output frame layout */
+	size_t out_plane_stride[VDEF_RAW_MAX_PLANE_COUNT];
+	size_t out_plane_size[VDEF_RAW_MAX_PLANE_COUNT];
+	size_t out_size;
+
+	/* Output band height in lines (output height if slices are not
+	 * enabled) */
+	unsigned int slice_height;
+
+	/* Progressive input: rows available in the frame with the given
+	 * timestamp, protected by the mutex */
+	struct {
+		uint64_t timestamp;
+		unsigned int rows;
+	} input_progress;
+
+	/* Statistics, protected by the mutex */
+	struct vscale_stats stats;
+
+	/* NUMA placement; node is -1 until known, only used by the scaling
+	 * thread once started */
+	struct {
+		enum vscale_numa_policy policy;
+		int node;
+	} numa;
+
+	/* Worker thread (preferred_thread_count >= 2): scales the chroma
+	 * planes of a band concurrently with the luma plane, or the last
+	 * regions of interest of a frame concurrently with the first ones
+	 * (if rois is true, with its own scaling resources); the job is
+	 * protected by the worker mutex */
+	struct {
+		pthread_t thread;
+		bool launched;
+		bool rois;
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		bool stop;
+		bool pending;
+		bool rois_job;
+		struct band_job band;
+		struct frame_job frame;
+		int numa_node;
+		int status;
+		struct scale_ctx ctx;
+	} worker;
+};
+
+
+#define NB_SUPPORTED_FORMATS 3
+static struct vdef_raw_format supported_formats[NB_SUPPORTED_FORMATS];
+static pthread_once_t supported_formats_is_init = PTHREAD_ONCE_INIT;
+static void initialize_supported_formats(void)
+{
+	supported_formats[0] = vdef_i420;
+	supported_formats[1] = vdef_nv12;
+	supported_formats[2] = vdef_nv21;
+}
+
+
+/* Number of scaled rows written oriented at once */
+#define ORIENT_BLOCK_ROWS 16
+
+
+/* Default output buffer pool initial count */
+#define DEFAULT_OUT_BUF_COUNT 3
+
+/* Weight (1/2^n) of the last value in smoothed times */
+#define SMOOTHING_SHIFT 3
+
+
+static int time_monotonic_us(uint64_t *usec)
+{
+	struct timespec ts;
+	int ret;
+
+	ret = time_get_monotonic(&ts);
+	if (ret < 0) {
+		ULOG_ERRNO("time_get_monotonic", -ret);
+		return ret;
+	}
+	ret = time_timespec_to_us(&ts, usec);
+	if (ret < 0) {
+		ULOG_ERRNO("time_timespec_to_us", -ret);
+		return ret;
+	}
+	return 0;
+}
+
+
+static void error_evt_cb(struct pomp_evt *evt, void *userdata)
+{
+	struct vscale_generic *self = userdata;
+	pthread_mutex_lock(&self->mutex);
+	int status = self->status;
+	unsigned int error_count = self->error_count;
+	self->status = 0;
+	self->error_count = 0;
+	pthread_mutex_unlock(&self->mutex);
+
+	for (unsigned int i = 0; i < error_count; i++) {
+		self->base->cbs.frame_output(
+			self->base, status, NULL, self->base->userdata);
+	}
+}
+
+
+static void output_evt_cb(struct pomp_evt *evt, void *userdata)
+{
+	struct vscale_generic *self = userdata;
+
+	switch (self->state) {
+	case WAITING_FOR_EOS:
+	case RUNNING:
+		while (true) {
+			struct mbuf_raw_video_frame *frame;
+			int res = mbuf_raw_video_frame_queue_pop(
+				self->output_queue, &frame);
+
+			if (res < 0) {
+				if (res != -EAGAIN)
+					ULOG_ERRNO(
+						"mbuf_raw_video_frame_queue_pop",
+						-res);
+				break;
+			}
+
+			self->base->cbs.frame_output(
+				self->base, 0, frame, self->base->userdata);
+			mbuf_raw_video_frame_unref(frame);
+		}
+
+		if (self->state == WAITING_FOR_EOS) {
+			pthread_mutex_lock(&self->mutex);
+			bool eos_flag = self->eos_flag;
+			pthread_mutex_unlock(&self->mutex);
+
+			if (!eos_flag) {
+				self->state = RUNNING;
+				if (self->base->cbs.flush != NULL)
+					self->base->cbs.flush(
+						self->base,
+						self->base->userdata);
+			}
+		}
+		break;
+	case WAITING_FOR_STOP: {
+		pthread_mutex_lock(&self->mutex);
+		bool stop_flag = self->stop_flag;
+		pthread_mutex_unlock(&self->mutex);
+		if (!stop_flag) {
+			self->state = RUNNING;
+			if (self->base->cbs.stop != NULL)
+				self->base->cbs.stop(self->base,
+						     self->base->userdata);
+		}
+		break;
+	}
+	case WAITING_FOR_FLUSH: {
+		pthread_mutex_lock(&self->mutex);
+		bool flush_flag = self->flush_flag;
+		pthread_mutex_unlock(&self->mutex);
+		if (!flush_flag) {
+			self->state = RUNNING;
+			mbuf_raw_video_frame_queue_flush(self->input_queue);
+			mbuf_raw_video_frame_queue_flush(self->output_queue);
+			if (self->base->cbs.flush != NULL)
+				self->base->cbs.flush(self->base,
+						      self->base->userdata);
+		}
+		break;
+	}
+	}
+}
+
+
+static int get_supported_input_formats(const struct vdef_raw_format **formats)
+{
+	(void)pthread_once(&supported_formats_is_init,
+			   initialize_supported_formats);
+	*formats = supported_formats;
+	return NB_SUPPORTED_FORMATS;
+}
+
+
+static int flush(struct vscale_scaler *base, bool discard)
+{
+	struct vscale_generic *self = base->derived;
+
+	if (discard) {
+		pthread_mutex_lock(&self->mutex);
+		self->flush_flag = true;
+		pthread_cond_signal(&self->cond);
+		pthread_mutex_unlock(&self->mutex);
+
+		self->state = WAITING_FOR_FLUSH;
+	} else {
+		pthread_mutex_lock(&self->mutex);
+		self->eos_flag = true;
+		pthread_cond_signal(&self->cond);
+		pthread_mutex_unlock(&self->mutex);
+
+		self->state = WAITING_FOR_EOS;
+	}
+
+	return 0;
+}
+
+
+static int stop(struct vscale_scaler *base)
+{
+	struct vscale_generic *self = base->derived;
+
+	pthread_mutex_lock(&self->mutex);
+	self->stop_flag = true;
+	pthread_cond_signal(&self->cond);
+	pthread_mutex_unlock(&self->mutex);
+
+	self->state = WAITING_FOR_STOP;
+
+	return 0;
+}
+
+
+static void scale_ctx_clear(struct scale_ctx *ctx)
+{
+	free(ctx->luma_scratch);
+	free(ctx->chroma_scratch);
+	free(ctx->tensor_yuv);
+	for (unsigned int i = 0; i < ctx->roi_planes_count; i++) {
+		vscale_generic_plane_clear(&ctx->roi_planes[i].luma);
+		vscale_generic_plane_clear(&ctx->roi_planes[i].chroma);
+	}
+}
+
+
+/* Allocate the orientation scratch rows (sdw is the scaled width) and
+ * the tensor scratch frame of scaling resources */
+static int scale_ctx_init(struct vscale_generic *self,
+			  struct scale_ctx *ctx,
+			  unsigned int sdw)
+{
+	int res;
+
+	if (self->orientation != VSCALE_ORIENTATION_NORMAL &&
+	    self->orientation != VSCALE_ORIENTATION_MIRROR_V) {
+		ctx->luma_scratch = malloc((size_t)ORIENT_BLOCK_ROWS * sdw);
+		if (!self->gray) {
+			ctx->chroma_scratch =
+				malloc((size_t)ORIENT_BLOCK_ROWS *
+				       ((sdw + 1) / 2) * self->comps);
+		}
+		if (ctx->luma_scratch == NULL ||
+		    (!self->gray && ctx->chroma_scratch == NULL)) {
+			res = -ENOMEM;
+			ULOG_ERRNO("malloc", -res);
+			return res;
+		}
+	}
+
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		ctx->tensor_yuv = malloc(self->out_size);
+		if (ctx->tensor_yuv == NULL) {
+			res = -ENOMEM;
+			ULOG_ERRNO("malloc", -res);
+			return res;
+		}
+	}
+
+	return 0;
+}
+
+
+static int destroy(struct vscale_scaler *base)
+{
+	struct vscale_generic *self = base->derived;
+	int ret = 0;
+
+	if (self->thread_launched) {
+		stop(base);
+		ret = pthread_join(self->thread, NULL);
+		if (ret != 0)
+			ULOG_ERRNO("pthread_join", -ret);
+	}
+
+	if (self->worker.launched) {
+		pthread_mutex_lock(&self->worker.mutex);
+		self->worker.stop = true;
+		pthread_cond_broadcast(&self->worker.cond);
+		pthread_mutex_unlock(&self->worker.mutex);
+		ret = pthread_join(self->worker.thread, NULL);
+		if (ret != 0)
+			ULOG_ERRNO("pthread_join", -ret);
+	}
+
+	pthread_mutex_destroy(&self->mutex);
+	pthread_cond_destroy(&self->cond);
+	pthread_mutex_destroy(&self->worker.mutex);
+	pthread_cond_destroy(&self->worker.cond);
+	if (self->output_event != NULL) {
+		if (pomp_evt_is_attached(self->output_event, base->loop)) {
+			ret = pomp_evt_detach_from_loop(self->output_event,
+							base->loop);
+			if (ret < 0)
+				ULOG_ERRNO("pomp_evt_detach_from_loop", -ret);
+		}
+
+		pomp_evt_destroy(self->output_event);
+	}
+	if (self->error_event != NULL) {
+		if (pomp_evt_is_attached(self->error_event, base->loop)) {
+			ret = pomp_evt_detach_from_loop(self->error_event,
+							base->loop);
+			if (ret < 0)
+				ULOG_ERRNO("pomp_evt_detach_from_loop", -ret);
+		}
+
+		pomp_evt_destroy(self->error_event);
+	}
+
+	if (self->input_queue != 0) {
+		ret = mbuf_raw_video_frame_queue_flush(self->input_queue);
+		if (ret < 0)
+			ULOG_ERRNO("mbuf_raw_video_frame_queue_flush", -ret);
+		ret = mbuf_raw_video_frame_queue_destroy(self->input_queue);
+		if (ret < 0)
+			ULOG_ERRNO("mbuf_raw_video_frame_queue_destroy", -ret);
+	}
+	if (self->output_queue != 0) {
+		ret = mbuf_raw_video_frame_queue_flush(self->output_queue);
+		if (ret < 0)
+			ULOG_ERRNO("mbuf_raw_video_frame_queue_flush", -ret);
+		ret = mbuf_raw_video_frame_queue_destroy(self->output_queue);
+		if (ret < 0)
+			ULOG_ERRNO("mbuf_raw_video_frame_queue_destroy", -ret);
+	}
+
+	vscale_mem_pool_destroy(self->out_pool);
+	scale_ctx_clear(&self->ctx);
+	scale_ctx_clear(&self->worker.ctx);
+	vscale_tensor_clear(&self->tensor);
+
+	vscale_generic_plane_clear(&self->luma);
+	vscale_generic_plane_clear(&self->chroma);
+	free(self->rois);
+	vscale_generic_remap_clear(&self->warp.remap[0]);
+	vscale_generic_remap_clear(&self->warp.remap[1]);
+	free(self->warp.mesh);
+
+	free(self);
+	return 0;
+}
+
+
+static bool input_filter(struct mbuf_raw_video_frame *frame, void *userdata)
+{
+	bool accept;
+	struct vscale_generic *self = userdata;
+
+	if (self->state != RUNNING)
+		return false;
+
+	accept = vscale_default_input_filter(frame, self->base);
+
+	if (accept) {
+		pthread_mutex_lock(&self->mutex);
+		pthread_cond_signal(&self->cond);
+		pthread_mutex_unlock(&self->mutex);
+	}
+
+	return accept;
+}
+
+
+static unsigned int input_rows_locked(struct vscale_generic *self,
+				      uint64_t timestamp)
+{
+	if (self->input_progress.timestamp == UINT64_MAX ||
+	    self->input_progress.timestamp < timestamp)
+		return 0;
+	else if (self->input_progress.timestamp > timestamp)
+		return UINT_MAX; /* a later frame is already in progress */
+	else
+		return self->input_progress.rows;
+}
+
+
+static int wait_input_rows(struct vscale_generic *self,
+			   uint64_t timestamp,
+			   unsigned int rows)
+{
+	int res = 0;
+
+	pthread_mutex_lock(&self->mutex);
+	while (input_rows_locked(self, timestamp) < rows) {
+		if (self->stop_flag || self->flush_flag) {
+			res = -ECANCELED;
+			break;
+		}
+		pthread_cond_wait(&self->cond, &self->mutex);
+	}
+	pthread_mutex_unlock(&self->mutex);
+
+	return res;
+}
+
+
+static void update_stats(struct vscale_generic *self, uint64_t scale_time)
+{
+	pthread_mutex_lock(&self->mutex);
+	self->stats.frame_count++;
+	if (self->stats.scale_time_us == 0) {
+		self->stats.scale_time_us = scale_time;
+	} else {
+		self->stats.scale_time_us =
+			self->stats.scale_time_us -
+			(self->stats.scale_time_us >> SMOOTHING_SHIFT) +
+			(scale_time >> SMOOTHING_SHIFT);
+	}
+	pthread_mutex_unlock(&self->mutex);
+}
+
+
+/* Source rows needed for the scaled rows [0, dst_end) of a plane,
+ * whatever the filtering mode, or the warp if the plane is remapped */
+static unsigned int src_rows_needed(const struct vscale_generic_plane *plane,
+				    const struct vscale_generic_remap *remap,
+				    const struct vscale_fit_plane *fit,
+				    unsigned int dst_end)
+{
+	uint64_t rows;
+
+	if (dst_end <= (unsigned int)fit->content.top)
+		return 0;
+	if (remap != NULL) {
+		dst_end = MIN(dst_end - fit->content.top, remap->height);
+		return remap->src_rows[dst_end - 1];
+	}
+	dst_end = MIN(dst_end - fit->content.top, plane->dst_height);
+	rows = (uint64_t)dst_end * plane->src_height + plane->dst_height - 1;
+	rows /= plane->dst_height;
+
+	/* Interpolation reads the next row */
+	return fit->crop.top + MIN(rows + 1, plane->src_height);
+}
+
+
+/* Write the scaled rows [y, y + rows) of a plane at dst: the source crop
+ * rectangle is scaled (or remapped, if remap is not NULL) to the content
+ * rectangle, the rest of the rows is padded */
+static void write_rows(struct vscale_generic_plane *plane,
+		       const struct vscale_generic_remap *remap,
+		       const struct vscale_fit_plane *fit,
+		       const uint8_t *pad,
+		       const uint8_t *src,
+		       size_t src_stride,
+		       uint8_t *dst,
+		       ptrdiff_t dst_stride,
+		       unsigned int y,
+		       unsigned int rows)
+{
+	unsigned int top = fit->content.top;
+	unsigned int c0, c1;
+	uint8_t *content;
+
+	/* Only the borders are padded */
+	vscale_fit_pad_rows(
+		fit, dst, dst_stride, y, rows, pad, plane->comps, &c0, &c1);
+	if (c1 <= c0)
+		return;
+	content = dst + (ptrdiff_t)(c0 - y) * dst_stride +
+		  fit->content.left * plane->comps;
+
+	/* The remapping offsets are relative to the source plane */
+	if (remap != NULL) {
+		vscale_generic_remap_rows(
+			remap, src, content, dst_stride, c0 - top, c1 - top);
+		return;
+	}
+
+	vscale_generic_scale_rows(plane,
+				  src + fit->crop.top * src_stride +
+					  fit->crop.left * plane->comps,
+				  src_stride,
+				  content,
+				  dst_stride,
+				  c0 - top,
+				  c1 - top);
+}
+
+
+/* Scale the rows [y_start, y_end) of a scaled plane into an output plane
+ * with the output orientation applied */
+static void scale_plane_rows(struct vscale_generic *self,
+			     struct vscale_generic_plane *plane,
+			     const struct vscale_generic_remap *remap,
+			     const struct vscale_fit_plane *fit,
+			     uint8_t *scratch,
+			     const uint8_t *pad,
+			     const uint8_t *src,
+			     size_t src_stride,
+			     uint8_t *dst,
+			     size_t dst_stride,
+			     unsigned int y_start,
+			     unsigned int y_end)
+{
+	unsigned int pixel_size = plane->comps;
+	size_t scratch_stride = (size_t)fit->width * pixel_size;
+
+	if (y_start >= y_end)
+		return;
+
+	switch (self->orientation) {
+	case VSCALE_ORIENTATION_NORMAL:
+		write_rows(plane,
+			   remap,
+			   fit,
+			   pad,
+			   src,
+			   src_stride,
+			   dst + y_start * dst_stride,
+			   dst_stride,
+			   y_start,
+			   y_end - y_start);
+		return;
+	case VSCALE_ORIENTATION_MIRROR_V:
+		/* Bottom-up destination */
+		write_rows(plane,
+			   remap,
+			   fit,
+			   pad,
+			   src,
+			   src_stride,
+			   dst + (fit->height - 1 - y_start) * dst_stride,
+			   -(ptrdiff_t)dst_stride,
+			   y_start,
+			   y_end - y_start);
+		return;
+	default:
+		break;
+	}
+
+	/* Scale blocks of rows into the scratch buffer and write them
+	 * oriented while they are still in cache */
+	for (unsigned int y = y_start; y < y_end; y += ORIENT_BLOCK_ROWS) {
+		unsigned int rows = MIN(ORIENT_BLOCK_ROWS, y_end - y);
+		write_rows(plane,
+			   remap,
+			   fit,
+			   pad,
+			   src,
+			   src_stride,
+			   scratch,
+			   scratch_stride,
+			   y,
+			   rows);
+		vscale_orient_plane(scratch,
+				    scratch_stride,
+				    vscale_orient_rows_dst(dst,
+							   dst_stride,
+							   fit->height,
+							   y,
+							   rows,
+							   pixel_size,
+							   self->orientation),
+				    dst_stride,
+				    fit->width,
+				    rows,
+				    pixel_size,
+				    self->orientation);
+	}
+}
+
+
+static void scale_chroma_band(struct vscale_generic *self,
+			      const struct band_job *job)
+{
+	for (unsigned int i = 1; i <= job->chroma_planes; i++) {
+		scale_plane_rows(self,
+				 job->chroma,
+				 job->remap,
+				 &job->fit[1],
+				 job->scratch,
+				 &self->pad[i],
+				 job->src[i],
+				 job->in_info->plane_stride[i],
+				 job->dst[i],
+				 self->out_plane_stride[i],
+				 job->cy,
+				 job->cy_end);
+	}
+}
+
+
+/* Start a chroma band job (band is not NULL) or a regions of interest
+ * job on the worker thread; called on the scaling thread */
+static void worker_start(struct vscale_generic *self,
+			 const struct band_job *band,
+			 const struct frame_job *frame)
+{
+	pthread_mutex_lock(&self->worker.mutex);
+	self->worker.rois_job = (band == NULL);
+	if (band != NULL)
+		self->worker.band = *band;
+	else
+		self->worker.frame = *frame;
+	self->worker.numa_node = self->numa.node;
+	self->worker.status = 0;
+	self->worker.pending = true;
+	pthread_cond_broadcast(&self->worker.cond);
+	pthread_mutex_unlock(&self->worker.mutex);
+}
+
+
+/* Wait for the end of the worker thread job and return its status;
+ * called on the scaling thread */
+static int worker_join(struct vscale_generic *self)
+{
+	int res;
+
+	pthread_mutex_lock(&self->worker.mutex);
+	while (self->worker.pending) {
+		pthread_cond_wait(&self->worker.cond, &self->worker.mutex);
+	}
+	res = self->worker.status;
+	pthread_mutex_unlock(&self->worker.mutex);
+
+	return res;
+}
+
+
+/* Convert the output lines of a band to the output color properties or
+ * to the tensor, while they are still in cache; the band covers the whole
+ * frame unless the orientation keeps the rows */
+static void convert_band(struct vscale_generic *self,
+			 struct scale_ctx *ctx,
+			 const struct vdef_raw_format *format,
+			 uint8_t **dst,
+			 uint8_t **tensor_dst,
+			 unsigned int y,
+			 unsigned int height)
+{
+	const struct vdef_dim *dim = &self->base->config.output.info.resolution;
+
+	if (!self->color_conv.enabled &&
+	    self->tensor.format == VSCALE_TENSOR_FORMAT_NONE)
+		return;
+
+	if (!vscale_orientation_keeps_rows(self->orientation)) {
+		y = 0;
+		height = dim->height;
+	}
+
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		vscale_tensor_convert_rows(ctx->tensor,
+					   format,
+					   (const uint8_t *const *)dst,
+					   self->out_plane_stride,
+					   dim->height,
+					   tensor_dst,
+					   y,
+					   height);
+		return;
+	}
+
+	vscale_color_conv_rows(&self->color_conv,
+			       format,
+			       dst,
+			       self->out_plane_stride,
+			       dim->width,
+			       dim->height,
+			       y,
+			       height);
+}
+
+
+/* Scale the scaled lines [y, y + height) (luma lines, y is even) with the
+ * scaling resources of the calling thread; the chroma planes are scaled
+ * on the worker thread while the luma plane is scaled on the calling
+ * thread if use_worker is true (scaling thread only); remap holds the
+ * luma and chroma remapping contexts of a warped frame, NULL otherwise */
+static int scale_band(struct vscale_generic *self,
+		      struct scale_ctx *ctx,
+		      bool use_worker,
+		      struct vscale_generic_plane *luma,
+		      struct vscale_generic_plane *chroma,
+		      const struct vscale_generic_remap *remap,
+		      const struct vscale_fit_plane *fit,
+		      const struct vdef_raw_frame *in_info,
+		      const uint8_t **src,
+		      uint8_t **dst,
+		      unsigned int y,
+		      unsigned int height)
+{
+	int res;
+	unsigned int dh = fit[0].height;
+	const struct vscale_generic_remap *luma_remap =
+		(remap != NULL) ? &remap[0] : NULL;
+	struct band_job job = {
+		.chroma = chroma,
+		.remap = (remap != NULL) ? &remap[1] : NULL,
+		.fit = fit,
+		.in_info = in_info,
+		.src = src,
+		.dst = dst,
+		.scratch = ctx->chroma_scratch,
+		.cy = y / 2,
+		.cy_end = (y + height == dh) ? fit[1].height
+					     : (y + height) / 2,
+		.chroma_planes =
+			vdef_raw_format_cmp(&in_info->format, &vdef_i420) ? 2
+									  : 1,
+	};
+
+	if (self->gray)
+		job.chroma_planes = 0;
+
+	if (self->base->config.input.progressive) {
+		unsigned int rows = src_rows_needed(
+			luma, luma_remap, &fit[0], y + height);
+		if (!self->gray) {
+			unsigned int chroma_end = src_rows_needed(
+				chroma, job.remap, &fit[1], job.cy_end);
+			rows = MAX(rows,
+				   MIN(2 * chroma_end,
+				       in_info->info.resolution.height));
+		}
+		res = wait_input_rows(self, in_info->info.timestamp, rows);
+		if (res < 0)
+			return res;
+	}
+
+	use_worker = use_worker && job.chroma_planes > 0 &&
+		     job.cy_end > job.cy;
+	if (use_worker)
+		worker_start(self, &job, NULL);
+
+	scale_plane_rows(self,
+			 luma,
+			 luma_remap,
+			 &fit[0],
+			 ctx->luma_scratch,
+			 &self->pad[0],
+			 src[0],
+			 in_info->plane_stride[0],
+			 dst[0],
+			 self->out_plane_stride[0],
+			 y,
+			 y + height);
+
+	/* Join the chroma job before the output frame is finalized */
+	if (use_worker)
+		(void)worker_join(self);
+	else
+		scale_chroma_band(self, &job);
+
+	return 0;
+}
+
+
+/* Called on the scaling thread */
+static void numa_place(struct vscale_generic *self, unsigned int node)
+{
+	int res;
+
+	res = vscale_numa_bind_thread(node);
+	if (res < 0)
+		ULOG_ERRNO("vscale_numa_bind_thread:%u", -res, node);
+
+	if (self->out_pool != NULL) {
+		res = vscale_mem_pool_set_numa_node(self->out_pool, node);
+		if (res < 0)
+			ULOG_ERRNO("vscale_mem_pool_set_numa_node", -res);
+	}
+
+	self->numa.node = node;
+	ULOGI("NUMA node: %u", node);
+}
+
+
+/* Get the plane contexts of a region of interest size from the scaling
+ * resources of the calling thread, initialized on first use */
+static int roi_planes_get(struct vscale_generic *self,
+			  struct scale_ctx *ctx,
+			  const struct vdef_rect *roi,
+			  const struct vscale_fit_plane *fit,
+			  struct roi_planes **ret_obj)
+{
+	int res;
+	struct roi_planes *planes;
+
+	for (unsigned int i = 0; i < ctx->roi_planes_count; i++) {
+		planes = &ctx->roi_planes[i];
+		if (planes->size.width == roi->width &&
+		    planes->size.height == roi->height)
+			goto out;
+	}
+
+	if (ctx->roi_planes_count < ROI_PLANES_COUNT) {
+		planes = &ctx->roi_planes[ctx->roi_planes_count++];
+	} else {
+		planes = &ctx->roi_planes[0];
+		for (unsigned int i = 1; i < ROI_PLANES_COUNT; i++) {
+			if (ctx->roi_planes[i].last_use < planes->last_use)
+				planes = &ctx->roi_planes[i];
+		}
+		vscale_generic_plane_clear(&planes->luma);
+		vscale_generic_plane_clear(&planes->chroma);
+	}
+
+	/* Until initialized, the contexts match no region size */
+	planes->size.width = 0;
+	planes->size.height = 0;
+	res = vscale_generic_plane_init(&planes->luma,
+					self->kernels,
+					fit[0].crop.width,
+					fit[0].crop.height,
+					fit[0].content.width,
+					fit[0].content.height,
+					1,
+					self->base->config.filter_mode);
+	if (res < 0)
+		return res;
+	res = vscale_generic_plane_set_sharpen(
+		&planes->luma, self->base->config.output.sharpen);
+	if (res < 0)
+		return res;
+	if (!self->gray) {
+		res = vscale_generic_plane_init(&planes->chroma,
+						self->kernels,
+						fit[1].crop.width,
+						fit[1].crop.height,
+						fit[1].content.width,
+						fit[1].content.height,
+						self->comps,
+						self->base->config.filter_mode);
+		if (res < 0)
+			return res;
+	}
+	planes->size.width = roi->width;
+	planes->size.height = roi->height;
+
+out:
+	planes->last_use = ++ctx->roi_use_count;
+	*ret_obj = planes;
+	return 0;
+}
+
+
+/* Scale the output frame k of a frame job (region of interest k, if any)
+ * with the scaling resources of the calling thread; the chroma planes are
+ * scaled on the worker thread if use_worker is true (scaling thread
+ * only) */
+static int scale_output(struct vscale_generic *self,
+			struct scale_ctx *ctx,
+			bool use_worker,
+			const struct frame_job *job,
+			unsigned int k)
+{
+	int res;
+	struct vscale_generic_plane *luma = &self->luma;
+	struct vscale_generic_plane *chroma = &self->chroma;
+	const struct vscale_fit_plane *fit = self->fit;
+	struct vscale_fit_plane roi_fit[2];
+	unsigned int h = self->fit[0].height;
+	unsigned int slice_height = self->slice_height;
+	unsigned int plane_count =
+		vdef_get_raw_frame_plane_count(&job->in_info->format);
+	uint8_t *dst_planes[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	uint8_t *out_planes[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	size_t offset = k * job->out_size;
+
+	/* The regions are scaled whole, without slices, with the plane
+	 * contexts of their size */
+	if (job->roi_count > 0) {
+		struct roi_planes *planes;
+		res = vscale_roi_fit_compute(
+			self->base->config.output.fit_mode,
+			&self->rois[k],
+			&(struct vdef_dim){
+				.width = self->fit[0].width,
+				.height = self->fit[0].height,
+			},
+			&roi_fit[0],
+			&roi_fit[1]);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_roi_fit_compute", -res);
+			return res;
+		}
+		res = roi_planes_get(
+			self, ctx, &self->rois[k], roi_fit, &planes);
+		if (res < 0) {
+			ULOG_ERRNO("roi_planes_get", -res);
+			return res;
+		}
+		luma = &planes->luma;
+		chroma = &planes->chroma;
+		fit = roi_fit;
+		slice_height = h;
+	}
+
+	for (unsigned int i = 0; i < job->out_plane_count; i++) {
+		out_planes[i] = job->mem_data + offset;
+		offset += job->out_plane_size[i];
+	}
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		offset = 0;
+		for (unsigned int i = 0; i < plane_count; i++) {
+			dst_planes[i] = ctx->tensor_yuv + offset;
+			offset += self->out_plane_size[i];
+		}
+	} else {
+		memcpy(dst_planes, out_planes, sizeof(dst_planes));
+	}
+
+	for (unsigned int y = 0; y < h; y += slice_height) {
+		unsigned int height = MIN(slice_height, h - y);
+
+		res = scale_band(self,
+				 ctx,
+				 use_worker,
+				 luma,
+				 chroma,
+				 job->remap,
+				 fit,
+				 job->in_info,
+				 job->src,
+				 dst_planes,
+				 y,
+				 height);
+		if (res < 0)
+			return res;
+
+		convert_band(self,
+			     ctx,
+			     self->gray ? &vdef_gray : &job->in_info->format,
+			     dst_planes,
+			     out_planes,
+			     y,
+			     height);
+
+		if (job->roi_count == 0 &&
+		    self->base->config.output.slice_height != 0 &&
+		    vscale_orientation_keeps_rows(self->orientation) &&
+		    self->base->cbs.slice_output != NULL) {
+			self->base->cbs.slice_output(
+				self->base,
+				job->out_info,
+				(const uint8_t *const *)out_planes,
+				y,
+				height,
+				self->base->userdata);
+		}
+	}
+
+	return 0;
+}
+
+
+static void *worker_routine(void *userdata)
+{
+	struct vscale_generic *self = userdata;
+	int node = -1;
+
+	pthread_mutex_lock(&self->worker.mutex);
+	while (!self->worker.stop) {
+		if (!self->worker.pending) {
+			pthread_cond_wait(&self->worker.cond,
+					  &self->worker.mutex);
+			continue;
+		}
+
+		bool rois_job = self->worker.rois_job;
+		struct band_job band = self->worker.band;
+		struct frame_job frame = self->worker.frame;
+		int numa_node = self->worker.numa_node;
+		int res = 0;
+		pthread_mutex_unlock(&self->worker.mutex);
+
+		/* Follow the scaling thread NUMA placement */
+		if (numa_node >= 0 && numa_node != node) {
+			res = vscale_numa_bind_thread(numa_node);
+			if (res < 0) {
+				ULOG_ERRNO("vscale_numa_bind_thread:%d",
+					   -res,
+					   numa_node);
+			}
+			node = numa_node;
+			res = 0;
+		}
+
+		if (rois_job) {
+			for (unsigned int k = frame.start;
+			     k < frame.end && res == 0;
+			     k++) {
+				res = scale_output(
+					self, &self->worker.ctx, false, &frame, k);
+			}
+		} else {
+			scale_chroma_band(self, &band);
+		}
+
+		pthread_mutex_lock(&self->worker.mutex);
+		self->worker.status = res;
+		self->worker.pending = false;
+		pthread_cond_broadcast(&self->worker.cond);
+	}
+	pthread_mutex_unlock(&self->worker.mutex);
+
+	return NULL;
+}
+
+
+/* Build the remapping contexts of a warp for input planes with the given
+ * strides, unless they are built for them already; called on the scaling
+ * thread */
+static int warp_build(struct vscale_generic *self,
+		      const struct vscale_warp *warp,
+		      const size_t *strides)
+{
+	int res;
+	const struct vdef_dim *dim = &self->base->config.input.info.resolution;
+	size_t mesh_size = vscale_warp_mesh_size(warp);
+
+	if (self->warp.built && vscale_warp_equal(warp, &self->warp.last) &&
+	    strides[0] == self->warp.stride[0] &&
+	    (self->gray || strides[1] == self->warp.stride[1]))
+		return 0;
+
+	self->warp.built = false;
+	res = vscale_generic_remap_build(&self->warp.remap[0],
+					 self->kernels,
+					 warp,
+					 dim,
+					 &self->fit[0],
+					 1,
+					 1,
+					 strides[0]);
+	if (res < 0) {
+		ULOG_ERRNO("vscale_generic_remap_build", -res);
+		return res;
+	}
+	if (!self->gray) {
+		res = vscale_generic_remap_build(&self->warp.remap[1],
+						 self->kernels,
+						 warp,
+						 dim,
+						 &self->fit[1],
+						 2,
+						 self->comps,
+						 strides[1]);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_generic_remap_build", -res);
+			return res;
+		}
+	}
+
+	/* Keep a copy of the warp to detect its changes */
+	if (mesh_size > 0) {
+		float *mesh = realloc(self->warp.mesh, mesh_size);
+		if (mesh == NULL) {
+			res = -ENOMEM;
+			ULOG_ERRNO("realloc", -res);
+			return res;
+		}
+		memcpy(mesh, warp->mesh, mesh_size);
+		self->warp.mesh = mesh;
+	}
+	self->warp.last = *warp;
+	self->warp.last.mesh = self->warp.mesh;
+	self->warp.stride[0] = strides[0];
+	self->warp.stride[1] = strides[1];
+	self->warp.built = true;
+
+	return 0;
+}
+
+
+/* Get the remapping contexts of an input frame for its warp (from its
+ * ancillary data, otherwise the configured warp); *remap is NULL if the
+ * frame is not warped; called on the scaling thread */
+static int warp_get(struct vscale_generic *self,
+		    struct mbuf_raw_video_frame *frame,
+		    const struct vdef_raw_frame *info,
+		    const struct vscale_generic_remap **remap)
+{
+	int res;
+	struct vscale_warp warp;
+	struct mbuf_ancillary_data *data = NULL;
+
+	*remap = NULL;
+	res = vscale_frame_get_warp(frame, &warp, &data);
+	if (res == -ENOENT) {
+		warp = self->base->config.input.warp;
+	} else if (res < 0) {
+		ULOG_ERRNO("vscale_frame_get_warp", -res);
+		return res;
+	}
+
+	res = 0;
+	if (warp.type != VSCALE_WARP_TYPE_NONE) {
+		res = warp_build(self, &warp, info->plane_stride);
+		if (res == 0)
+			*remap = self->warp.remap;
+	}
+
+	if (data != NULL)
+		mbuf_ancillary_data_unref(data);
+	return res;
+}
+
+
+/* Finalize the output frame of the output slot at offset in the output
+ * memory, and push it to the output queue; roi is NULL unless the input
+ * frame has regions of interest; the stages are accounted to timer */
+static int output_frame(struct vscale_generic *self,
+			struct mbuf_raw_video_frame *frame,
+			struct vdef_raw_frame *out_info,
+			struct mbuf_mem *mem,
+			const struct vscale_memfd *mem_memfd,
+			size_t offset,
+			const size_t *plane_size,
+			unsigned int plane_count,
+			const struct vscale_roi *roi,
+			struct vscale_timestamps *ts,
+			struct vscale_frame_timer *timer)
+{
+	int res;
+	struct mbuf_raw_video_frame *out_frame = NULL;
+	struct vscale_memfd memfd = *mem_memfd;
+	struct vmeta_frame *metadata;
+
+	res = mbuf_raw_video_frame_new(out_info, &out_frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_new", -res);
+		return res;
+	}
+
+	for (unsigned int i = 0; i < plane_count; i++) {
+		res = mbuf_raw_video_frame_set_plane(
+			out_frame, i, mem, offset, plane_size[i]);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_set_plane", -res);
+			goto out;
+		}
+		memfd.plane_offset[i] = offset;
+		offset += plane_size[i];
+	}
+
+	if (memfd.fd >= 0) {
+		res = mbuf_raw_video_frame_add_ancillary_buffer(
+			out_frame,
+			VSCALE_ANCILLARY_KEY_MEMFD,
+			&memfd,
+			sizeof(memfd));
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer",
+				   -res);
+			goto out;
+		}
+	}
+
+	vscale_frame_timer_lap(timer, VSCALE_STAGE_OUTPUT);
+
+	/* Share the input ancillary data by reference */
+	res = mbuf_raw_video_frame_foreach_ancillary_data(
+		frame, vscale_ancillary_data_sharer, out_frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_foreach_ancillary_data", -res);
+		goto out;
+	}
+
+	res = mbuf_raw_video_frame_get_metadata(frame, &metadata);
+	if (res == 0) {
+		res = mbuf_raw_video_frame_set_metadata(out_frame, metadata);
+		vmeta_frame_unref(metadata);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_set_metadata", -res);
+			goto out;
+		}
+	} else if (res == -ENOENT) {
+		/* No metadata, nothing to do */
+		res = 0;
+	} else {
+		ULOG_ERRNO("mbuf_raw_video_frame_get_metadata", -res);
+		goto out;
+	}
+
+	vscale_frame_timer_lap(timer, VSCALE_STAGE_COPY);
+
+	if (roi != NULL) {
+		res = mbuf_raw_video_frame_add_ancillary_buffer(
+			out_frame, VSCALE_ANCILLARY_KEY_ROI, roi, sizeof(*roi));
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer",
+				   -res);
+			goto out;
+		}
+	}
+
+	time_monotonic_us(&ts->output_time);
+	res = mbuf_raw_video_frame_add_ancillary_buffer(
+		out_frame, VSCALE_ANCILLARY_KEY_TIMESTAMPS, ts, sizeof(*ts));
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -res);
+		goto out;
+	}
+
+	vscale_frame_timer_lap(timer, VSCALE_STAGE_OUTPUT);
+	res = vscale_frame_timer_set(timer, out_frame);
+	if (res < 0)
+		goto out;
+
+	res = mbuf_raw_video_frame_finalize(out_frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_finalize", -res);
+		goto out;
+	}
+
+	/* Direct output from the scaling thread, or through the loop */
+	if (self->base->cbs.frame_output_direct != NULL) {
+		self->base->cbs.frame_output_direct(
+			self->base, out_frame, self->base->userdata);
+	} else {
+		mbuf_raw_video_frame_queue_push(self->output_queue, out_frame);
+		pomp_evt_signal(self->output_event);
+	}
+
+out:
+	mbuf_raw_video_frame_unref(out_frame);
+	return res;
+}
+
+
+/* Scale an input frame to one output frame, or to one output frame per
+ * region of interest; the output frames of an input frame are packed in
+ * one output memory */
+static void scale_frame(struct vscale_generic *self,
+			struct mbuf_raw_video_frame *frame)
+{
+	struct vdef_raw_frame frame_info;
+	unsigned int plane_count;
+	const void *planes[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	unsigned int out_plane_count;
+	const size_t *out_plane_size;
+	size_t out_size, mem_size;
+	struct mbuf_mem *mem = NULL;
+	size_t len;
+	struct vscale_timestamps ts = {0};
+	uint64_t dequeue_time = 0;
+	struct vscale_frame_timer timer;
+	struct vscale_memfd memfd = {.fd = -1};
+	void *mem_data;
+	struct vdef_raw_frame out_frame_info;
+	unsigned int roi_count = 0;
+	unsigned int out_count;
+	const struct vscale_generic_remap *remap = NULL;
+	struct frame_job job;
+	bool worker_busy = false;
+	uint64_t scale_start = 0;
+	uint64_t scale_end = 0;
+	uint64_t scale_time = 0;
+
+	/* The frame is dequeued, before any work on it */
+	time_monotonic_us(&dequeue_time);
+	vscale_frame_timer_start(&timer, self->base->config.timings);
+
+	int res = mbuf_raw_video_frame_get_frame_info(frame, &frame_info);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_get_frame_info", -res);
+		goto end;
+	}
+
+	(void)vscale_frame_get_timestamps(frame, &ts);
+	ts.dequeue_time = dequeue_time;
+
+	if (self->base->config.output.max_rois > 0) {
+		res = vscale_frame_get_input_rois(
+			frame,
+			&frame_info.info.resolution,
+			self->rois,
+			self->base->config.output.max_rois);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_frame_get_input_rois", -res);
+			goto end;
+		}
+		roi_count = res;
+		res = 0;
+	}
+	out_count = MAX(roi_count, 1);
+
+	out_frame_info = frame_info;
+	out_frame_info.info.resolution =
+		self->base->config.output.info.resolution;
+	if (self->base->config.output.info.matrix_coefs !=
+	    VDEF_MATRIX_COEFS_UNKNOWN) {
+		out_frame_info.info.matrix_coefs =
+			self->base->config.output.info.matrix_coefs;
+		out_frame_info.info.full_range =
+			self->base->config.output.info.full_range;
+	}
+	plane_count = vdef_get_raw_frame_plane_count(&frame_info.format);
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		out_frame_info.format = self->tensor.raw_format;
+		out_frame_info.info.matrix_coefs = VDEF_MATRIX_COEFS_IDENTITY;
+		out_frame_info.info.full_range = true;
+		out_plane_count = self->tensor.plane_count;
+		out_plane_size = self->tensor.plane_size;
+		out_size = self->tensor.size;
+		for (unsigned int i = 0; i < out_plane_count; i++) {
+			out_frame_info.plane_stride[i] =
+				self->tensor.plane_stride[i];
+		}
+	} else {
+		if (self->gray)
+			out_frame_info.format = vdef_gray;
+		out_plane_count =
+			vdef_get_raw_frame_plane_count(&out_frame_info.format);
+		out_plane_size = self->out_plane_size;
+		out_size = self->out_size;
+		memcpy(out_frame_info.plane_stride,
+		       self->out_plane_stride,
+		       sizeof(out_frame_info.plane_stride));
+	}
+	mem_size = out_count * out_size;
+
+	for (unsigned int i = 0; i < plane_count; i++) {
+		res = mbuf_raw_video_frame_get_plane(
+			frame, i, &planes[i], &len);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_get_plane", -res);
+			goto end;
+		}
+	}
+
+	vscale_frame_timer_lap(&timer, VSCALE_STAGE_MAP);
+
+	/* Regions of interest are not warped */
+	if (roi_count == 0) {
+		res = warp_get(self, frame, &frame_info, &remap);
+		if (res < 0)
+			goto end;
+	}
+
+	vscale_frame_timer_lap(&timer, VSCALE_STAGE_SCALE);
+
+	/* Follow the first input frame memory, before getting the output
+	 * buffer so that it is allocated on the same node */
+	if (self->numa.policy == VSCALE_NUMA_POLICY_AUTO &&
+	    self->numa.node < 0) {
+		res = vscale_numa_get_mem_node(planes[0]);
+		if (res >= 0)
+			numa_place(self, res);
+		else
+			self->numa.policy = VSCALE_NUMA_POLICY_NONE;
+	}
+
+	if (self->base->cbs.get_output_mem != NULL) {
+		res = self->base->cbs.get_output_mem(self->base,
+						     &out_frame_info,
+						     mem_size,
+						     &mem,
+						     self->base->userdata);
+		if (res < 0) {
+			ULOG_ERRNO("get_output_mem", -res);
+			goto end;
+		}
+	} else if (self->out_pool != NULL) {
+		res = vscale_mem_pool_get(self->out_pool, &mem, &memfd.fd);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_mem_pool_get", -res);
+			goto end;
+		}
+	} else if (self->base->config.output.pool != NULL) {
+		res = mbuf_pool_get(self->base->config.output.pool, &mem);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_pool_get", -res);
+			goto end;
+		}
+	} else {
+		res = mbuf_mem_generic_new(mem_size, &mem);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_mem_generic_new", -res);
+			goto end;
+		}
+	}
+
+	vscale_frame_timer_lap(&timer, VSCALE_STAGE_ALLOC);
+
+	res = mbuf_mem_get_data(mem, &mem_data, &len);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_mem_get_data", -res);
+		goto end;
+	}
+	memfd.size = len;
+	if (len < mem_size) {
+		res = -ENOBUFS;
+		ULOGE("output memory too small: %zu < %zu", len, mem_size);
+		goto end;
+	}
+
+	vscale_frame_timer_lap(&timer, VSCALE_STAGE_MAP);
+
+	job.in_info = &frame_info;
+	job.src = (const uint8_t **)planes;
+	job.remap = remap;
+	job.out_info = &out_frame_info;
+	job.mem_data = mem_data;
+	job.out_plane_size = out_plane_size;
+	job.out_plane_count = out_plane_count;
+	job.out_size = out_size;
+	job.roi_count = roi_count;
+	job.start = 0;
+	job.end = out_count;
+
+	/* The last half of the regions of interest is scaled on the worker
+	 * thread while the first half is scaled and output */
+	if (self->worker.rois && roi_count >= 2) {
+		struct frame_job worker_job = job;
+		job.end = (roi_count + 1) / 2;
+		worker_job.start = job.end;
+		worker_start(self, NULL, &worker_job);
+		worker_busy = true;
+	}
+
+	for (unsigned int k = 0; k < out_count; k++) {
+		struct vscale_roi roi = {
+			.index = k,
+			.count = roi_count,
+			.offset = k * out_size,
+			.size = out_size,
+		};
+
+		time_monotonic_us(&scale_start);
+		if (k < job.end) {
+			res = scale_output(self,
+					   &self->ctx,
+					   self->worker.launched && !worker_busy,
+					   &job,
+					   k);
+		} else if (worker_busy) {
+			res = worker_join(self);
+			worker_busy = false;
+		}
+		time_monotonic_us(&scale_end);
+		scale_time += scale_end - scale_start;
+		if (res < 0)
+			break;
+		vscale_frame_timer_lap(&timer, VSCALE_STAGE_SCALE);
+
+		if (roi_count > 0)
+			roi.rect = self->rois[k];
+		res = output_frame(self,
+				   frame,
+				   &out_frame_info,
+				   mem,
+				   &memfd,
+				   roi.offset,
+				   out_plane_size,
+				   out_plane_count,
+				   (roi_count > 0) ? &roi : NULL,
+				   &ts,
+				   &timer);
+		if (res < 0)
+			break;
+	}
+
+	/* The worker thread uses the input and output frames */
+	if (worker_busy)
+		(void)worker_join(self);
+
+end:
+	if (res == 0) {
+		update_stats(self, scale_time);
+	} else if (res != -ECANCELED) {
+		pthread_mutex_lock(&self->mutex);
+		self->status = res;
+		self->error_count++;
+		pthread_mutex_unlock(&self->mutex);
+		pomp_evt_signal(self->error_event);
+	}
+
+	for (unsigned int i = 0; i < VDEF_RAW_MAX_PLANE_COUNT; i++) {
+		if (planes[i])
+			mbuf_raw_video_frame_release_plane(frame, i, planes[i]);
+	}
+	mbuf_raw_video_frame_unref(frame);
+	if (mem)
+		mbuf_mem_unref(mem);
+}
+
+
+/* Scale a dummy frame with the configured geometry into an output buffer,
+ * so that the first frames do not pay for the lazy initializations
+ * (threads stacks, page faults); called on the scaling thread before the
+ * first frame */
+static int prewarm(struct vscale_generic *self)
+{
+	int res;
+	const struct vscale_config *config = &self->base->config;
+	unsigned int sw = config->input.info.resolution.width;
+	unsigned int sh = config->input.info.resolution.height;
+	unsigned int cw = (sw + 1) / 2;
+	unsigned int ch = (sh + 1) / 2;
+	unsigned int h = self->fit[0].height;
+	unsigned int plane_count =
+		vdef_get_raw_frame_plane_count(&config->input.format);
+	struct vdef_raw_frame in_info = {0};
+	uint8_t *src;
+	const uint8_t *src_planes[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	struct mbuf_mem *mem = NULL;
+	void *mem_data;
+	size_t len;
+	size_t offset = 0;
+	uint8_t *dst_planes[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	uint8_t *out_planes[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	const struct vscale_generic_remap *remap = NULL;
+	size_t mem_size = (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE)
+				  ? self->tensor.size
+				  : self->out_size;
+
+	src = calloc((size_t)sw * sh + (size_t)2 * cw * ch, 1);
+	if (src == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("calloc", -res);
+		return res;
+	}
+
+	in_info.format = config->input.format;
+	in_info.info.resolution = config->input.info.resolution;
+	in_info.plane_stride[0] = sw;
+	src_planes[0] = src;
+	for (unsigned int i = 1; i < plane_count; i++) {
+		in_info.plane_stride[i] = (size_t)cw * self->comps;
+		src_planes[i] = src_planes[i - 1] +
+				in_info.plane_stride[i - 1] * (i > 1 ? ch : sh);
+	}
+
+	if (self->out_pool != NULL) {
+		res = vscale_mem_pool_get(self->out_pool, &mem, NULL);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_mem_pool_get", -res);
+			goto out;
+		}
+	} else {
+		res = mbuf_pool_get(config->output.pool, &mem);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_pool_get", -res);
+			goto out;
+		}
+	}
+	res = mbuf_mem_get_data(mem, &mem_data, &len);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_mem_get_data", -res);
+		goto out;
+	}
+	if (len < mem_size) {
+		res = -ENOBUFS;
+		ULOGE("output memory too small: %zu < %zu", len, mem_size);
+		goto out;
+	}
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		for (unsigned int i = 0; i < self->tensor.plane_count; i++) {
+			out_planes[i] = (uint8_t *)mem_data + offset;
+			offset += self->tensor.plane_size[i];
+		}
+		offset = 0;
+		for (unsigned int i = 0; i < plane_count; i++) {
+			dst_planes[i] = self->ctx.tensor_yuv + offset;
+			offset += self->out_plane_size[i];
+		}
+	} else {
+		for (unsigned int i = 0; i < plane_count; i++) {
+			out_planes[i] = (uint8_t *)mem_data + offset;
+			offset += self->out_plane_size[i];
+		}
+		memcpy(dst_planes, out_planes, sizeof(dst_planes));
+	}
+
+	/* The remapping contexts of the configured warp are reused by the
+	 * frames with the same strides */
+	if (config->input.warp.type != VSCALE_WARP_TYPE_NONE) {
+		res = warp_build(
+			self, &config->input.warp, in_info.plane_stride);
+		if (res < 0)
+			goto out;
+		remap = self->warp.remap;
+	}
+
+	/* Progressive input: all the rows of the dummy frame are
+	 * available */
+	pthread_mutex_lock(&self->mutex);
+	self->input_progress.timestamp = in_info.info.timestamp;
+	self->input_progress.rows = UINT_MAX;
+	pthread_mutex_unlock(&self->mutex);
+
+	for (unsigned int y = 0; y < h; y += self->slice_height) {
+		unsigned int height = MIN(self->slice_height, h - y);
+
+		res = scale_band(self,
+				 &self->ctx,
+				 self->worker.launched,
+				 &self->luma,
+				 &self->chroma,
+				 remap,
+				 self->fit,
+				 &in_info,
+				 src_planes,
+				 dst_planes,
+				 y,
+				 height);
+		if (res < 0)
+			break;
+
+		convert_band(self,
+			     &self->ctx,
+			     self->gray ? &vdef_gray : &in_info.format,
+			     dst_planes,
+			     out_planes,
+			     y,
+			     height);
+	}
+
+	pthread_mutex_lock(&self->mutex);
+	self->input_progress.timestamp = UINT64_MAX;
+	self->input_progress.rows = 0;
+	pthread_mutex_unlock(&self->mutex);
+
+out:
+	if (mem)
+		mbuf_mem_unref(mem);
+	free(src);
+	return res;
+}
+
+
+static void *work_routine(void *userdata)
+{
+	struct vscale_generic *self = userdata;
+
+	if (self->numa.policy == VSCALE_NUMA_POLICY_NODE)
+		numa_place(self, self->base->config.numa.node);
+
+	if (self->base->config.prewarm) {
+		int res = prewarm(self);
+		if (res < 0)
+			ULOG_ERRNO("prewarm", -res);
+		pthread_mutex_lock(&self->mutex);
+		self->prewarmed = true;
+		pthread_cond_broadcast(&self->cond);
+		pthread_mutex_unlock(&self->mutex);
+	}
+
+	pthread_mutex_lock(&self->mutex);
+	while (true) {
+		if (self->stop_flag) {
+			self->stop_flag = false;
+			pomp_evt_signal(self->output_event);
+			pthread_mutex_unlock(&self->mutex);
+			break;
+		}
+
+		if (self->flush_flag) {
+			self->flush_flag = false;
+			pomp_evt_signal(self->output_event);
+			pthread_cond_wait(&self->cond, &self->mutex);
+			continue;
+		}
+
+		struct mbuf_raw_video_frame *frame;
+		int res = mbuf_raw_video_frame_queue_pop(self->input_queue,
+							 &frame);
+		if (res < 0) {
+			if (res == -EAGAIN) {
+				if (self->eos_flag) {
+					self->eos_flag = false;
+					pomp_evt_signal(self->output_event);
+				}
+			} else {
+				ULOG_ERRNO("mbuf_raw_video_frame_pop", -res);
+			}
+			pthread_cond_wait(&self->cond, &self->mutex);
+		} else {
+			pthread_mutex_unlock(&self->mutex);
+			scale_frame(self, frame);
+			pthread_mutex_lock(&self->mutex);
+		}
+	}
+
+	return NULL;
+}
+
+
+static int create(struct vscale_scaler *base)
+{
+	struct vscale_generic *self;
+	const struct vscale_generic_kernels *kernels;
+	unsigned int dw = base->config.output.info.resolution.width;
+	unsigned int dh = base->config.output.info.resolution.height;
+	unsigned int sdw = dw;
+	unsigned int sdh = dh;
+	unsigned int comps;
+	int ret;
+
+	self = calloc(1, sizeof(*self));
+	if (self == NULL) {
+		ret = -ENOMEM;
+		ULOG_ERRNO("calloc", -ret);
+		return ret;
+	}
+	self->base = base;
+	base->derived = self;
+
+	pthread_mutex_init(&self->mutex, NULL);
+	pthread_cond_init(&self->cond, NULL);
+	pthread_mutex_init(&self->worker.mutex, NULL);
+	pthread_cond_init(&self->worker.cond, NULL);
+	self->state = RUNNING;
+
+	ret = mbuf_raw_video_frame_queue_new_with_args(
+		&(struct mbuf_raw_video_frame_queue_args){
+			.filter = input_filter,
+			.filter_userdata = self,
+		},
+		&self->input_queue);
+	if (ret < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_queue_new_with_args", -ret);
+		goto err;
+	}
+
+	ret = mbuf_raw_video_frame_queue_new(&self->output_queue);
+	if (ret < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_queue_new", -ret);
+		goto err;
+	}
+
+	self->output_event = pomp_evt_new();
+	if (self->output_event == NULL) {
+		ret = -ENOMEM;
+		ULOG_ERRNO("pomp_evt_new", -ret);
+		goto err;
+	}
+
+	ret = pomp_evt_attach_to_loop(
+		self->output_event, base->loop, &output_evt_cb, self);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_evt_attach_to_loop", -ret);
+		goto err;
+	}
+
+	self->error_event = pomp_evt_new();
+	if (self->error_event == NULL) {
+		ret = -ENOMEM;
+		ULOG_ERRNO("pomp_evt_new", -ret);
+		goto err;
+	}
+
+	ret = pomp_evt_attach_to_loop(
+		self->error_event, base->loop, &error_evt_cb, self);
+	if (ret < 0) {
+		ULOG_ERRNO("pomp_evt_attach_to_loop", -ret);
+		goto err;
+	}
+
+	if (vdef_raw_format_cmp(&base->config.input.format, &vdef_i420)) {
+		comps = 1;
+	} else if (vdef_raw_format_cmp(&base->config.input.format,
+				       &vdef_nv12) ||
+		   vdef_raw_format_cmp(&base->config.input.format,
+				       &vdef_nv21)) {
+		comps = 2;
+	} else {
+		ret = -ENOSYS;
+		ULOGE("unsupported input format");
+		goto err;
+	}
+
+	/* The planes are scaled to the resolution before rotation */
+	self->orientation = base->config.output.orientation;
+	if (vscale_orientation_is_transposed(self->orientation)) {
+		sdw = dh;
+		sdh = dw;
+	}
+
+	struct vdef_dim scaled = {.width = sdw, .height = sdh};
+	ret = vscale_fit_compute(base->config.output.fit_mode,
+				 &base->config.input.info.resolution,
+				 &scaled,
+				 &self->fit[0],
+				 &self->fit[1]);
+	if (ret < 0)
+		goto err;
+
+	/* The pad pixels are written with the input color properties,
+	 * before the color conversion if any */
+	vscale_rgb_to_yuv(base->config.output.pad_color,
+			  &base->config.input.info,
+			  self->pad);
+	if (vdef_raw_format_cmp(&base->config.input.format, &vdef_nv21)) {
+		uint8_t u = self->pad[1];
+		self->pad[1] = self->pad[2];
+		self->pad[2] = u;
+	}
+
+	if (base->config.output.tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		ret = vscale_tensor_init(&self->tensor, &base->config);
+		if (ret < 0) {
+			ULOG_ERRNO("vscale_tensor_init", -ret);
+			goto err;
+		}
+		ULOGI("tensor output: %s",
+		      vscale_tensor_format_to_str(self->tensor.format));
+		if (base->config.output.info.matrix_coefs !=
+		    VDEF_MATRIX_COEFS_UNKNOWN)
+			ULOGW("output color matrix ignored with tensor output");
+	} else if (base->config.output.info.matrix_coefs !=
+		   VDEF_MATRIX_COEFS_UNKNOWN) {
+		ret = vscale_color_conv_init(&self->color_conv,
+					     &base->config.input.info,
+					     &base->config.output.info);
+		if (ret < 0) {
+			ULOG_ERRNO("vscale_color_conv_init", -ret);
+			goto err;
+		}
+		ULOGI("color conversion: %s %s to %s %s%s",
+		      vdef_matrix_coefs_to_str(
+			      base->config.input.info.matrix_coefs),
+		      base->config.input.info.full_range ? "full" : "limited",
+		      vdef_matrix_coefs_to_str(
+			      base->config.output.info.matrix_coefs),
+		      base->config.output.info.full_range ? "full"
+							  : "limited",
+		      self->color_conv.enabled ? "" : " (none)");
+	}
+
+	/* Luma-only output, tensors need the chroma planes */
+	if (vdef_raw_format_cmp(&base->config.output.preferred_format,
+				&vdef_gray)) {
+		if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+			ULOGW("gray output ignored with tensor output");
+		} else {
+			self->gray = true;
+			ULOGI("luma-only (gray) output");
+		}
+	}
+
+	kernels = vscale_generic_get_kernels();
+	self->kernels = kernels;
+	self->comps = comps;
+	ret = vscale_generic_plane_init(&self->luma,
+					kernels,
+					self->fit[0].crop.width,
+					self->fit[0].crop.height,
+					self->fit[0].content.width,
+					self->fit[0].content.height,
+					1,
+					base->config.filter_mode);
+	if (ret < 0)
+		goto err;
+	ret = vscale_generic_plane_set_sharpen(&self->luma,
+					       base->config.output.sharpen);
+	if (ret < 0)
+		goto err;
+	if (!self->gray) {
+		ret = vscale_generic_plane_init(&self->chroma,
+						kernels,
+						self->fit[1].crop.width,
+						self->fit[1].crop.height,
+						self->fit[1].content.width,
+						self->fit[1].content.height,
+						comps,
+						base->config.filter_mode);
+		if (ret < 0)
+			goto err;
+	}
+
+	ULOGI("kernels: %s, filter mode: %s",
+	      kernels->name,
+	      vscale_filter_mode_to_str(self->luma.mode));
+	self->stats.filter_mode = self->luma.mode;
+	if (self->luma.sharpen != 0)
+		ULOGI("sharpening strength: %.2f", base->config.output.sharpen);
+	if (base->config.adaptive_filter_mode)
+		ULOGW("adaptive filtering mode is not supported, ignored");
+
+	/* Contiguous output planes, aligned as configured */
+	const struct vdef_raw_format *out_format =
+		self->gray ? &vdef_gray : &base->config.input.format;
+	ret = vscale_output_layout_compute(&base->config,
+					   out_format,
+					   self->out_plane_stride,
+					   self->out_plane_size,
+					   &self->out_size);
+	if (ret < 0) {
+		ULOG_ERRNO("vscale_output_layout_compute", -ret);
+		goto err;
+	}
+	self->ctx.tensor = &self->tensor;
+	ret = scale_ctx_init(self, &self->ctx, sdw);
+	if (ret < 0)
+		goto err;
+
+	self->numa.policy = base->config.numa.policy;
+	self->numa.node = -1;
+	if (self->numa.policy != VSCALE_NUMA_POLICY_NONE) {
+		unsigned int node_count = vscale_numa_node_count();
+		if (node_count <= 1) {
+			/* Nothing to place on single-node machines */
+			self->numa.policy = VSCALE_NUMA_POLICY_NONE;
+		} else if (self->numa.policy == VSCALE_NUMA_POLICY_NODE &&
+			   !vscale_numa_node_is_online(
+				   base->config.numa.node)) {
+			ret = -EINVAL;
+			ULOGE("invalid NUMA node: %u (not online)",
+			      base->config.numa.node);
+			goto err;
+		}
+	}
+
+	if (base->config.output.max_rois > 0) {
+		self->rois = calloc(base->config.output.max_rois,
+				    sizeof(*self->rois));
+		if (self->rois == NULL) {
+			ret = -ENOMEM;
+			ULOG_ERRNO("calloc", -ret);
+			goto err;
+		}
+	}
+
+	/* Output buffers hold the tensor when enabled, and the output
+	 * frames of all the regions of interest of a frame */
+	size_t mem_size = (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE)
+				  ? self->tensor.size
+				  : self->out_size;
+	mem_size *= MAX(base->config.output.max_rois, 1);
+
+	/* Output buffers are pooled for NUMA placement too, so that they
+	 * can be bound to the node, and for pre-warming, so that they can
+	 * be allocated in advance, unless the caller provides the pool */
+	if (base->config.output.pool == NULL &&
+	    (base->config.output.mem_type != VSCALE_MEM_TYPE_GENERIC ||
+	     self->numa.policy != VSCALE_NUMA_POLICY_NONE ||
+	     base->config.prewarm)) {
+		struct vscale_mem_pool_config pool_cfg = {
+			.name = base->config.name,
+			.type = base->config.output.mem_type,
+			.size = mem_size,
+			.initial_count =
+				base->config.output.preferred_min_buf_count
+					? base->config.output
+						  .preferred_min_buf_count
+					: DEFAULT_OUT_BUF_COUNT,
+			.numa_bind = (self->numa.policy ==
+				      VSCALE_NUMA_POLICY_NODE),
+			.numa_node = base->config.numa.node,
+			.prefault = base->config.prewarm,
+		};
+		/* The node is not known yet: allocate on demand */
+		if (self->numa.policy == VSCALE_NUMA_POLICY_AUTO)
+			pool_cfg.initial_count = 0;
+		ret = vscale_mem_pool_new(&pool_cfg, &self->out_pool);
+		if (ret < 0) {
+			ULOG_ERRNO("vscale_mem_pool_new", -ret);
+			goto err;
+		}
+	}
+
+	/* Each output row only depends on the source frame: slices only
+	 * need to start on a chroma row */
+	self->input_progress.timestamp = UINT64_MAX;
+	self->slice_height = sdh;
+	if (base->config.output.slice_height != 0 &&
+	    !vscale_orientation_keeps_rows(self->orientation)) {
+		ULOGW("slices are not supported with orientation %s, "
+		      "ignored",
+		      vscale_orientation_to_str(self->orientation));
+	} else if (base->config.output.slice_height != 0) {
+		self->slice_height =
+			MIN((base->config.output.slice_height + 1) & ~1u, dh);
+		ULOGI("output slice height: %u (requested: %u)",
+		      self->slice_height,
+		      base->config.output.slice_height);
+	}
+
+	/* Scale the chroma planes concurrently with the luma plane, and the
+	 * regions of interest concurrently with each other */
+	if (base->config.preferred_thread_count >= 2 &&
+	    base->config.output.max_rois >= 2) {
+		self->worker.ctx.tensor = &self->tensor;
+		ret = scale_ctx_init(self, &self->worker.ctx, sdw);
+		if (ret < 0)
+			goto err;
+		self->worker.rois = true;
+	}
+	if (base->config.preferred_thread_count >= 2 &&
+	    (!self->gray || self->worker.rois)) {
+		ret = pthread_create(&self->worker.thread,
+				     NULL,
+				     &worker_routine,
+				     self);
+		if (ret != 0) {
+			ret = -ret;
+			ULOG_ERRNO("pthread_create", ret);
+			goto err;
+		}
+		self->worker.launched = true;
+	}
+
+	ret = pthread_create(&self->thread, NULL, &work_routine, self);
+	if (ret != 0) {
+		ret = -ret;
+		ULOG_ERRNO("pthread_create", ret);
+		goto err;
+	}
+
+	self->thread_launched = true;
+
+	/* Ready once the scaling thread is warmed up */
+	pthread_mutex_lock(&self->mutex);
+	while (base->config.prewarm && !self->prewarmed)
+		pthread_cond_wait(&self->cond, &self->mutex);
+	pthread_mutex_unlock(&self->mutex);
+
+	return 0;
+err:
+	destroy(self->base);
+	base->derived = NULL;
+	return ret;
+}
+
+
+static int get_stats(struct vscale_scaler *base, struct vscale_stats *stats)
+{
+	struct vscale_generic *self = base->derived;
+
+	pthread_mutex_lock(&self->mutex);
+	*stats = self->stats;
+	pthread_mutex_unlock(&self->mutex);
+
+	return 0;
+}
+
+
+static int set_input_rows(struct vscale_scaler *base,
+			  struct mbuf_raw_video_frame *frame,
+			  unsigned int rows)
+{
+	int res;
+	struct vscale_generic *self = base->derived;
+	struct vdef_raw_frame frame_info;
+
+	res = mbuf_raw_video_frame_get_frame_info(frame, &frame_info);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_get_frame_info", -res);
+		return res;
+	}
+
+	pthread_mutex_lock(&self->mutex);
+	self->input_progress.timestamp = frame_info.info.timestamp;
+	self->input_progress.rows = rows;
+	pthread_cond_signal(&self->cond);
+	pthread_mutex_unlock(&self->mutex);
+
+	return 0;
+}
+
+
+static struct mbuf_pool *get_input_buffer_pool(const struct vscale_scaler *base)
+{
+	return NULL;
+}
+
+
+static struct mbuf_raw_video_frame_queue *
+get_input_buffer_queue(const struct vscale_scaler *base)
+{
+	struct vscale_generic *scaler = base->derived;
+
+	return scaler->input_queue;
+}
+
+
+VSCALE_API const struct vscale_ops vscale_generic_ops = {
+	.get_supported_input_formats = get_supported_input_formats,
+	.create = create,
+	.flush = flush,
+	.stop = stop,
+	.destroy = destroy,
+	.get_input_buffer_pool = get_input_buffer_pool,
+	.get_input_buffer_queue = get_input_buffer_queue,
+	.get_stats = get_stats,
+	.set_input_rows = set_input_rows,
+};
@@ -0,0 +1,829 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/param.h>
+
+#if defined(__arm__) && defined(__ARM_NEON)
+#	include <sys/auxv.h>
+#	include <asm/hwcap.h>
+#endif /* __arm__ && __ARM_NEON */
+
+#define ULOG_TAG vscale_generic
+#include <ulog.h>
+
+#include "vscale_generic_kernels.h"
+
+
+#define WEIGHT_BITS VSCALE_GENERIC_WEIGHT_BITS
+#define WEIGHT_ONE VSCALE_GENERIC_WEIGHT_ONE
+
+/* Scratch rows padding in bytes, for SIMD over-reads and over-writes */
+#define ROW_PADDING 64
+
+/* The 16-bit box accumulator holds at most this many rows */
+#define BOX_MAX_ROWS (UINT16_MAX / UINT8_MAX)
+
+/* Remapped tiles dimensions in pixels */
+#define REMAP_TILE_COLS 64
+#define REMAP_TILE_ROWS 16
+
+
+void vscale_generic_blend_row_c(uint8_t *dst,
+				const uint8_t *a,
+				const uint8_t *b,
+				unsigned int w,
+				size_t n)
+{
+	unsigned int wa = WEIGHT_ONE - w;
+
+	for (size_t i = 0; i < n; i++)
+		dst[i] = (a[i] * wa + b[i] * w + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+}
+
+
+void vscale_generic_accumulate_row_c(uint16_t *acc,
+				     const uint8_t *src,
+				     size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc[i] += src[i];
+}
+
+
+void vscale_generic_hfilter_row_c(uint8_t *dst,
+				  const uint8_t *src,
+				  const uint32_t *offset,
+				  const uint16_t *weight,
+				  unsigned int comps,
+				  size_t count,
+				  size_t simd_count)
+{
+	if (comps == 1) {
+		for (size_t i = 0; i < count; i++) {
+			const uint8_t *s = src + offset[i];
+			unsigned int w = weight[i];
+			dst[i] = (s[0] * (WEIGHT_ONE - w) + s[1] * w +
+				  WEIGHT_ONE / 2) >>
+				 WEIGHT_BITS;
+		}
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			const uint8_t *s = src + offset[i];
+			unsigned int w = weight[i];
+			dst[2 * i] = (s[0] * (WEIGHT_ONE - w) + s[2] * w +
+				      WEIGHT_ONE / 2) >>
+				     WEIGHT_BITS;
+			dst[2 * i + 1] = (s[1] * (WEIGHT_ONE - w) + s[3] * w +
+					  WEIGHT_ONE / 2) >>
+					 WEIGHT_BITS;
+		}
+	}
+}
+
+
+void vscale_generic_remap_row_c(uint8_t *dst,
+				const uint8_t *src,
+				size_t src_stride,
+				const uint32_t *offset,
+				const uint32_t *weight,
+				unsigned int comps,
+				size_t count,
+				int32_t simd_limit)
+{
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t *s = src + offset[i];
+		const uint8_t *t = s + src_stride;
+		unsigned int wx = weight[i] & 0xffff;
+		unsigned int wy = weight[i] >> 16;
+		for (unsigned int c = 0; c < comps; c++) {
+			unsigned int top = s[c] * (WEIGHT_ONE - wx) +
+					   s[comps + c] * wx;
+			unsigned int bottom = t[c] * (WEIGHT_ONE - wx) +
+					      t[comps + c] * wx;
+			dst[i * comps + c] =
+				(top * (WEIGHT_ONE - wy) + bottom * wy +
+				 WEIGHT_ONE * WEIGHT_ONE / 2) >>
+				(2 * WEIGHT_BITS);
+		}
+	}
+}
+
+
+void vscale_generic_sharpen_row_c(uint8_t *dst,
+				  const uint8_t *up,
+				  const uint8_t *cur,
+				  const uint8_t *down,
+				  unsigned int amount,
+				  unsigned int comps,
+				  size_t n)
+{
+	const uint8_t *left = cur - comps;
+	const uint8_t *right = cur + comps;
+
+	for (size_t i = 0; i < n; i++) {
+		int c = cur[i];
+		int d = 4 * c - up[i] - down[i] - left[i] - right[i];
+		int v = c + ((d * (int)amount + 2 * WEIGHT_ONE) >>
+			     (WEIGHT_BITS + 2));
+		dst[i] = MIN(MAX(v, 0), UINT8_MAX);
+	}
+}
+
+
+const struct vscale_generic_kernels vscale_generic_kernels_c = {
+	.name = "c",
+	.blend_row = vscale_generic_blend_row_c,
+	.accumulate_row = vscale_generic_accumulate_row_c,
+	.hfilter_row = vscale_generic_hfilter_row_c,
+	.remap_row = vscale_generic_remap_row_c,
+	.sharpen_row = vscale_generic_sharpen_row_c,
+};
+
+
+static bool kernels_supported(const struct vscale_generic_kernels *kernels)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (kernels == &vscale_generic_kernels_avx2)
+		return __builtin_cpu_supports("avx2");
+	if (kernels == &vscale_generic_kernels_sse4)
+		return __builtin_cpu_supports("sse4.1");
+#endif /* __x86_64__ || __i386__ */
+
+#if defined(__aarch64__)
+	if (kernels == &vscale_generic_kernels_neon)
+		return true;
+#elif defined(__ARM_NEON)
+	if (kernels == &vscale_generic_kernels_neon)
+		return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif /* __ARM_NEON */
+
+	return kernels == &vscale_generic_kernels_c;
+}
+
+
+/* Kernels sets, from the best to the most portable */
+static const struct vscale_generic_kernels *const kernels_list[] = {
+#if defined(__x86_64__) || defined(__i386__)
+	&vscale_generic_kernels_avx2,
+	&vscale_generic_kernels_sse4,
+#endif /* __x86_64__ || __i386__ */
+#if defined(__ARM_NEON) || defined(__aarch64__)
+	&vscale_generic_kernels_neon,
+#endif /* __ARM_NEON || __aarch64__ */
+	&vscale_generic_kernels_c,
+};
+
+
+const struct vscale_generic_kernels *vscale_generic_get_kernels(void)
+{
+	const char *env = getenv("VSCALE_GENERIC_KERNELS");
+	size_t count = sizeof(kernels_list) / sizeof(kernels_list[0]);
+
+	if (env != NULL) {
+		for (size_t i = 0; i < count; i++) {
+			if (strcasecmp(env, kernels_list[i]->name) == 0 &&
+			    kernels_supported(kernels_list[i]))
+				return kernels_list[i];
+		}
+		ULOGW("kernels '%s' not supported, using the default", env);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (kernels_supported(kernels_list[i]))
+			return kernels_list[i];
+	}
+
+	return &vscale_generic_kernels_c;
+}
+
+
+/* Source position of the center of the destination pixel d, for
+ * interpolation: index of the first source pixel and weight of the
+ * second one; the second pixel is always within the source */
+static void interp_pos(unsigned int d,
+		       unsigned int src_len,
+		       unsigned int dst_len,
+		       unsigned int *index,
+		       unsigned int *weight)
+{
+	int64_t pos = (((2 * (int64_t)d + 1) * src_len) << 15) / dst_len -
+		      (1 << 15);
+
+	if (pos < 0)
+		pos = 0;
+	*index = pos >> 16;
+	*weight = (pos & 0xffff) >> (16 - WEIGHT_BITS);
+	if (*index >= src_len - 1) {
+		*index = src_len - 2;
+		*weight = WEIGHT_ONE;
+	}
+}
+
+
+/* Source pixel nearest to the center of the destination pixel d */
+static unsigned int nearest_pos(unsigned int d,
+				unsigned int src_len,
+				unsigned int dst_len)
+{
+	unsigned int index =
+		((2 * (uint64_t)d + 1) * src_len) / (2 * (uint64_t)dst_len);
+
+	return MIN(index, src_len - 1);
+}
+
+
+/* Source pixels [*start, *end) averaged for the destination pixel d */
+static void box_range(unsigned int d,
+		      unsigned int src_len,
+		      unsigned int dst_len,
+		      unsigned int *start,
+		      unsigned int *end)
+{
+	*start = (uint64_t)d * src_len / dst_len;
+	*end = (uint64_t)(d + 1) * src_len / dst_len;
+	*end = MIN(MAX(*end, *start + 1), src_len);
+}
+
+
+int vscale_generic_plane_init(struct vscale_generic_plane *plane,
+			      const struct vscale_generic_kernels *kernels,
+			      unsigned int src_width,
+			      unsigned int src_height,
+			      unsigned int dst_width,
+			      unsigned int dst_height,
+			      unsigned int comps,
+			      enum vscale_filter_mode mode)
+{
+	int res;
+	size_t row_size = (size_t)src_width * comps;
+
+	ULOG_ERRNO_RETURN_ERR_IF(plane == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(kernels == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(src_width == 0 || src_height == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(dst_width == 0 || dst_height == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(comps != 1 && comps != 2, EINVAL);
+
+	memset(plane, 0, sizeof(*plane));
+	plane->kernels = kernels;
+	plane->src_width = src_width;
+	plane->src_height = src_height;
+	plane->dst_width = dst_width;
+	plane->dst_height = dst_height;
+	plane->comps = comps;
+
+	/* Fall back to the modes that apply */
+	if (mode == VSCALE_FILTER_MODE_AUTO)
+		mode = VSCALE_FILTER_MODE_BILINEAR;
+	if (mode == VSCALE_FILTER_MODE_BOX &&
+	    (dst_width > src_width || dst_height > src_height ||
+	     src_height > (uint64_t)BOX_MAX_ROWS * dst_height))
+		mode = VSCALE_FILTER_MODE_BILINEAR;
+	if (mode == VSCALE_FILTER_MODE_BILINEAR && src_height < 2)
+		mode = VSCALE_FILTER_MODE_LINEAR;
+	if ((mode == VSCALE_FILTER_MODE_LINEAR ||
+	     mode == VSCALE_FILTER_MODE_BILINEAR) &&
+	    src_width < 2)
+		mode = VSCALE_FILTER_MODE_NONE;
+	plane->mode = mode;
+
+	plane->x_offset = calloc(dst_width, sizeof(*plane->x_offset));
+	plane->x_weight = calloc(dst_width, sizeof(*plane->x_weight));
+	plane->x_recip = calloc(dst_width, sizeof(*plane->x_recip));
+	plane->row = calloc(row_size + ROW_PADDING, sizeof(*plane->row));
+	plane->acc = calloc(row_size + ROW_PADDING, sizeof(*plane->acc));
+	plane->prefix = calloc(row_size + comps, sizeof(*plane->prefix));
+	if (plane->x_offset == NULL || plane->x_weight == NULL ||
+	    plane->x_recip == NULL || plane->row == NULL ||
+	    plane->acc == NULL || plane->prefix == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("calloc", -res);
+		vscale_generic_plane_clear(plane);
+		return res;
+	}
+
+	for (unsigned int x = 0; x < dst_width; x++) {
+		unsigned int index = 0;
+		unsigned int weight = 0;
+		unsigned int end;
+
+		switch (mode) {
+		case VSCALE_FILTER_MODE_NONE:
+			index = nearest_pos(x, src_width, dst_width);
+			break;
+		case VSCALE_FILTER_MODE_BOX:
+			box_range(x, src_width, dst_width, &index, &end);
+			weight = end - index;
+			plane->x_recip[x] = ((1 << 16) + weight / 2) / weight;
+			break;
+		default:
+			interp_pos(x, src_width, dst_width, &index, &weight);
+			break;
+		}
+		plane->x_offset[x] = index * comps;
+		plane->x_weight[x] = weight;
+	}
+
+	/* Offsets are increasing: SIMD kernels can read 4 bytes for the
+	 * first simd_count pixels */
+	plane->simd_count = dst_width;
+	while (plane->simd_count > 0 &&
+	       plane->x_offset[plane->simd_count - 1] + 4 > row_size)
+		plane->simd_count--;
+
+	return 0;
+}
+
+
+int vscale_generic_plane_set_sharpen(struct vscale_generic_plane *plane,
+				     float strength)
+{
+	int res;
+	unsigned int amount;
+
+	ULOG_ERRNO_RETURN_ERR_IF(plane == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!(strength >= 0.f), EINVAL);
+
+	amount = VSCALE_GENERIC_SHARPEN_MAX;
+	if (strength * WEIGHT_ONE < VSCALE_GENERIC_SHARPEN_MAX)
+		amount = strength * WEIGHT_ONE + 0.5f;
+
+	free(plane->sharpen_rows);
+	plane->sharpen_rows = NULL;
+	plane->sharpen = 0;
+	if (amount == 0)
+		return 0;
+
+	plane->sharpen_stride =
+		(size_t)plane->dst_width * plane->comps + 2 * plane->comps;
+	plane->sharpen_rows = malloc(3 * plane->sharpen_stride);
+	if (plane->sharpen_rows == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("malloc", -res);
+		return res;
+	}
+	plane->sharpen = amount;
+
+	return 0;
+}
+
+
+void vscale_generic_plane_clear(struct vscale_generic_plane *plane)
+{
+	if (plane == NULL)
+		return;
+
+	free(plane->x_offset);
+	free(plane->x_weight);
+	free(plane->x_recip);
+	free(plane->row);
+	free(plane->acc);
+	free(plane->prefix);
+	free(plane->sharpen_rows);
+	memset(plane, 0, sizeof(*plane));
+}
+
+
+static void nearest_row(struct vscale_generic_plane *plane,
+			uint8_t *dst,
+			const uint8_t *src)
+{
+	unsigned int width = plane->dst_width;
+	const uint32_t *x_offset = plane->x_offset;
+
+	if (plane->comps == 1) {
+		for (unsigned int i = 0; i < width; i++)
+			dst[i] = src[x_offset[i]];
+	} else {
+		for (unsigned int i = 0; i < width; i++) {
+			dst[2 * i] = src[x_offset[i]];
+			dst[2 * i + 1] = src[x_offset[i] + 1];
+		}
+	}
+}
+
+
+/* Inlined with a constant comps, so that the components loop unrolls */
+static inline __attribute__((always_inline)) void
+box_row_comps(struct vscale_generic_plane *plane,
+	      uint8_t *dst,
+	      uint32_t y_recip,
+	      unsigned int comps)
+{
+	unsigned int width = plane->dst_width;
+	size_t row_size = (size_t)plane->src_width * comps;
+	const uint16_t *acc = plane->acc;
+	const uint32_t *x_offset = plane->x_offset;
+	const uint16_t *x_weight = plane->x_weight;
+	const uint32_t *x_recip = plane->x_recip;
+	uint32_t *prefix = plane->prefix;
+
+	/* Prefix sums of the accumulated rows, so that each box sum is a
+	 * difference whatever the box width */
+	uint32_t sum[2] = {0, 0};
+	for (unsigned int c = 0; c < comps; c++)
+		prefix[c] = 0;
+	for (size_t j = 0; j < row_size; j += comps) {
+		for (unsigned int c = 0; c < comps; c++) {
+			sum[c] += acc[j + c];
+			prefix[j + comps + c] = sum[c];
+		}
+	}
+
+	/* sum * recip is at most UINT8_MAX << 32 */
+	for (unsigned int i = 0; i < width; i++) {
+		const uint32_t *p = prefix + x_offset[i];
+		const uint32_t *q = p + x_weight[i] * comps;
+		uint64_t recip = (uint64_t)x_recip[i] * y_recip;
+		for (unsigned int c = 0; c < comps; c++) {
+			uint64_t v = (q[c] - p[c]) * recip;
+			v = (v + (1ULL << 31)) >> 32;
+			dst[i * comps + c] = MIN(v, UINT8_MAX);
+		}
+	}
+}
+
+
+static void box_row(struct vscale_generic_plane *plane,
+		    uint8_t *dst,
+		    unsigned int rows)
+{
+	uint32_t y_recip = ((1 << 16) + rows / 2) / rows;
+
+	if (plane->comps == 1)
+		box_row_comps(plane, dst, y_recip, 1);
+	else
+		box_row_comps(plane, dst, y_recip, 2);
+}
+
+
+/* Scale the destination row y of a plane at dst */
+static void scale_row(struct vscale_generic_plane *plane,
+		      const uint8_t *src,
+		      size_t src_stride,
+		      uint8_t *dst,
+		      unsigned int y)
+{
+	const struct vscale_generic_kernels *k = plane->kernels;
+	size_t row_size = (size_t)plane->src_width * plane->comps;
+	const uint8_t *row;
+	unsigned int index;
+	unsigned int weight;
+	unsigned int end;
+
+	if (plane->src_width == plane->dst_width &&
+	    plane->src_height == plane->dst_height) {
+		memcpy(dst, src + y * src_stride, row_size);
+		return;
+	}
+
+	switch (plane->mode) {
+	case VSCALE_FILTER_MODE_NONE:
+		index = nearest_pos(y, plane->src_height, plane->dst_height);
+		nearest_row(plane, dst, src + index * src_stride);
+		break;
+
+	case VSCALE_FILTER_MODE_LINEAR:
+		index = nearest_pos(y, plane->src_height, plane->dst_height);
+		k->hfilter_row(dst,
+			       src + index * src_stride,
+			       plane->x_offset,
+			       plane->x_weight,
+			       plane->comps,
+			       plane->dst_width,
+			       plane->simd_count);
+		break;
+
+	case VSCALE_FILTER_MODE_BOX:
+		box_range(y,
+			  plane->src_height,
+			  plane->dst_height,
+			  &index,
+			  &end);
+		memset(plane->acc, 0, row_size * sizeof(*plane->acc));
+		for (unsigned int r = index; r < end; r++) {
+			k->accumulate_row(
+				plane->acc, src + r * src_stride, row_size);
+		}
+		box_row(plane, dst, end - index);
+		break;
+
+	default:
+		interp_pos(y,
+			   plane->src_height,
+			   plane->dst_height,
+			   &index,
+			   &weight);
+		row = src + index * src_stride;
+		if (weight == WEIGHT_ONE) {
+			row += src_stride;
+		} else if (weight != 0) {
+			k->blend_row(plane->row,
+				     row,
+				     row + src_stride,
+				     weight,
+				     row_size);
+			row = plane->row;
+		}
+		k->hfilter_row(dst,
+			       row,
+			       plane->x_offset,
+			       plane->x_weight,
+			       plane->comps,
+			       plane->dst_width,
+			       plane->simd_count);
+		break;
+	}
+}
+
+
+/* Scale the destination row y of a plane into its sharpening scratch
+ * row (rows y - 1, y and y + 1 use distinct scratch rows), with the end
+ * pixels replicated on both sides */
+static const uint8_t *scale_sharpen_row(struct vscale_generic_plane *plane,
+					const uint8_t *src,
+					size_t src_stride,
+					unsigned int y)
+{
+	unsigned int comps = plane->comps;
+	size_t row_size = (size_t)plane->dst_width * comps;
+	uint8_t *row = plane->sharpen_rows + comps;
+
+	row += (y % 3) * plane->sharpen_stride;
+
+	scale_row(plane, src, src_stride, row, y);
+	memcpy(row - comps, row, comps);
+	memcpy(row + row_size, row + row_size - comps, comps);
+
+	return row;
+}
+
+
+void vscale_generic_scale_rows(struct vscale_generic_plane *plane,
+			       const uint8_t *src,
+			       size_t src_stride,
+			       uint8_t *dst,
+			       ptrdiff_t dst_stride,
+			       unsigned int y_start,
+			       unsigned int y_end)
+{
+	const uint8_t *up, *cur, *down;
+
+	if (plane->sharpen == 0) {
+		for (unsigned int y = y_start; y < y_end; y++) {
+			scale_row(plane,
+				  src,
+				  src_stride,
+				  dst + (ptrdiff_t)(y - y_start) * dst_stride,
+				  y);
+		}
+		return;
+	}
+
+	if (y_start >= y_end)
+		return;
+
+	/* Each row is sharpened right after the row below it is scaled,
+	 * while the 3 rows are in cache; the plane edges replicate their
+	 * rows */
+	if (y_start > 0) {
+		up = scale_sharpen_row(plane, src, src_stride, y_start - 1);
+		cur = scale_sharpen_row(plane, src, src_stride, y_start);
+	} else {
+		up = scale_sharpen_row(plane, src, src_stride, 0);
+		cur = up;
+	}
+	for (unsigned int y = y_start; y < y_end; y++) {
+		down = cur;
+		if (y + 1 < plane->dst_height)
+			down = scale_sharpen_row(plane, src, src_stride, y + 1);
+		plane->kernels->sharpen_row(
+			dst + (ptrdiff_t)(y - y_start) * dst_stride,
+			up,
+			cur,
+			down,
+			plane->sharpen,
+			plane->comps,
+			(size_t)plane->dst_width * plane->comps);
+		up = cur;
+		cur = down;
+	}
+}
+
+
+/* Bilinear sampling position of a source position on one dimension of a
+ * plane: index of the first source pixel and weight of the second one,
+ * the second pixel is always within the plane */
+static void remap_pos(float pos,
+		      unsigned int len,
+		      unsigned int *index,
+		      unsigned int *weight)
+{
+	if (!(pos > 0.f)) {
+		*index = 0;
+		*weight = 0;
+	} else if (pos >= len - 1) {
+		*index = len - 2;
+		*weight = WEIGHT_ONE;
+	} else {
+		*index = MIN((unsigned int)pos, len - 2);
+		*weight = (pos - *index) * WEIGHT_ONE + 0.5f;
+		*weight = MIN(*weight, WEIGHT_ONE);
+	}
+}
+
+
+int vscale_generic_remap_build(struct vscale_generic_remap *remap,
+			       const struct vscale_generic_kernels *kernels,
+			       const struct vscale_warp *warp,
+			       const struct vdef_dim *frame,
+			       const struct vscale_fit_plane *fit,
+			       unsigned int subsampling,
+			       unsigned int comps,
+			       size_t src_stride)
+{
+	int res;
+	unsigned int width, height, src_width, src_height;
+	size_t count;
+	int64_t limit;
+	float sub, inv_sub, center, x_scale, y_scale;
+	float *pos;
+
+	ULOG_ERRNO_RETURN_ERR_IF(remap == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(kernels == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(warp == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(fit == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(subsampling != 1 && subsampling != 2, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(comps != 1 && comps != 2, EINVAL);
+
+	width = fit->content.width;
+	height = fit->content.height;
+	src_width = (frame->width + subsampling - 1) / subsampling;
+	src_height = (frame->height + subsampling - 1) / subsampling;
+	ULOG_ERRNO_RETURN_ERR_IF(width == 0 || height == 0, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(src_width < 2 || src_height < 2, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(src_stride < (size_t)src_width * comps,
+				 EINVAL);
+
+	/* Offsets and limits are 32-bit values */
+	limit = (int64_t)(src_height - 1) * src_stride +
+		(int64_t)src_width * comps;
+	ULOG_ERRNO_RETURN_ERR_IF(limit > INT32_MAX, E2BIG);
+
+	count = (size_t)width * height;
+	if (count > remap->capacity) {
+		free(remap->offset);
+		free(remap->weight);
+		remap->offset = malloc(count * sizeof(*remap->offset));
+		remap->weight = malloc(count * sizeof(*remap->weight));
+		remap->capacity = count;
+	}
+	if (height > remap->src_rows_capacity) {
+		free(remap->src_rows);
+		remap->src_rows = malloc(height * sizeof(*remap->src_rows));
+		remap->src_rows_capacity = height;
+	}
+	if (remap->offset == NULL || remap->weight == NULL ||
+	    remap->src_rows == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("malloc", -res);
+		vscale_generic_remap_clear(remap);
+		return res;
+	}
+
+	remap->kernels = kernels;
+	remap->width = width;
+	remap->height = height;
+	remap->comps = comps;
+	remap->src_stride = src_stride;
+	/* Both source rows end at most at the plane end */
+	limit -= (int64_t)src_stride + 4;
+	remap->simd_limit = MAX(limit, -1);
+
+	/* Source positions of a row, in luma pixels */
+	pos = malloc((size_t)2 * width * sizeof(*pos));
+	if (pos == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("malloc", -res);
+		return res;
+	}
+
+	/* Content pixel centers map to the crop rectangle like in the
+	 * scaling tables; chroma samples are centered on their 2x2 luma
+	 * samples */
+	sub = subsampling;
+	inv_sub = 1.f / sub;
+	center = (sub - 1.f) / 2;
+	x_scale = (float)fit->crop.width / width;
+	y_scale = (float)fit->crop.height / height;
+
+	for (unsigned int dy = 0; dy < height; dy++) {
+		uint32_t *offset = remap->offset + (size_t)dy * width;
+		uint32_t *weight = remap->weight + (size_t)dy * width;
+		float x = fit->crop.left + 0.5f * x_scale - 0.5f;
+		float y = fit->crop.top + (dy + 0.5f) * y_scale - 0.5f;
+		unsigned int rows = (dy > 0) ? remap->src_rows[dy - 1] : 0;
+
+		vscale_warp_apply_row(warp,
+				      frame,
+				      x * sub + center,
+				      x_scale * sub,
+				      y * sub + center,
+				      width,
+				      pos,
+				      pos + width);
+		for (unsigned int dx = 0; dx < width; dx++) {
+			unsigned int x0, y0, wx, wy;
+			remap_pos((pos[dx] - center) * inv_sub,
+				  src_width,
+				  &x0,
+				  &wx);
+			remap_pos((pos[width + dx] - center) * inv_sub,
+				  src_height,
+				  &y0,
+				  &wy);
+			offset[dx] = y0 * src_stride + x0 * comps;
+			weight[dx] = wx | (wy << 16);
+			rows = MAX(rows, y0 + 2);
+		}
+		remap->src_rows[dy] = rows;
+	}
+
+	free(pos);
+	return 0;
+}
+
+
+void vscale_generic_remap_clear(struct vscale_generic_remap *remap)
+{
+	if (remap == NULL)
+		return;
+
+	free(remap->offset);
+	free(remap->weight);
+	free(remap->src_rows);
+	memset(remap, 0, sizeof(*remap));
+}
+
+
+void vscale_generic_remap_rows(const struct vscale_generic_remap *remap,
+			       const uint8_t *src,
+			       uint8_t *dst,
+			       ptrdiff_t dst_stride,
+			       unsigned int y_start,
+			       unsigned int y_end)
+{
+	const struct vscale_generic_kernels *k = remap->kernels;
+	unsigned int width = remap->width;
+	unsigned int comps = remap->comps;
+
+	for (unsigned int y = y_start; y < y_end; y += REMAP_TILE_ROWS) {
+		unsigned int rows = MIN(REMAP_TILE_ROWS, y_end - y);
+		for (unsigned int x = 0; x < width; x += REMAP_TILE_COLS) {
+			unsigned int count = MIN(REMAP_TILE_COLS, width - x);
+			for (unsigned int r = 0; r < rows; r++) {
+				size_t i = (size_t)(y + r) * width + x;
+				ptrdiff_t row = (ptrdiff_t)(y - y_start + r);
+				k->remap_row(dst + row * dst_stride +
+						     (size_t)x * comps,
+					     src,
+					     remap->src_stride,
+					     remap->offset + i,
+					     remap->weight + i,
+					     comps,
+					     count,
+					     remap->simd_limit);
+			}
+		}
+	}
+}
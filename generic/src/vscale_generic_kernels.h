@@ -0,0 +1,370 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _VSCALE_GENERIC_KERNELS_H_
+#define _VSCALE_GENERIC_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <video-scale/vscale_internal.h>
+
+
+/* Fixed-point interpolation weights are in [0, WEIGHT_ONE] */
+#define VSCALE_GENERIC_WEIGHT_BITS 8
+#define VSCALE_GENERIC_WEIGHT_ONE (1 << VSCALE_GENERIC_WEIGHT_BITS)
+
+/* Maximum sharpening amount, so that amount * 32 fits in 16 bits */
+#define VSCALE_GENERIC_SHARPEN_MAX (4 * VSCALE_GENERIC_WEIGHT_ONE - 1)
+
+
+/* Row kernels; all kernels handle any count (SIMD implementations process
+ * the tail with the C code) */
+struct vscale_generic_kernels {
+	/* Kernels set name */
+	const char *name;
+
+	/* Vertical interpolation:
+	 * dst[i] = (a[i] * (WEIGHT_ONE - w) + b[i] * w + WEIGHT_ONE / 2)
+	 *          >> WEIGHT_BITS, for i in [0, n) */
+	void (*blend_row)(uint8_t *dst,
+			  const uint8_t *a,
+			  const uint8_t *b,
+			  unsigned int w,
+			  size_t n);
+
+	/* Vertical box accumulation: acc[i] += src[i], for i in [0, n) */
+	void (*accumulate_row)(uint16_t *acc, const uint8_t *src, size_t n);
+
+	/* Horizontal interpolation of count pixels of comps interleaved
+	 * components: for each pixel i and component c,
+	 *   a = src[offset[i] + c], b = src[offset[i] + comps + c],
+	 *   dst[i * comps + c] = (a * (WEIGHT_ONE - weight[i]) +
+	 *                         b * weight[i] + WEIGHT_ONE / 2)
+	 *                        >> WEIGHT_BITS
+	 * simd_count is the number of pixels for which reading 4 bytes at
+	 * src + offset[i] is within the source row */
+	void (*hfilter_row)(uint8_t *dst,
+			    const uint8_t *src,
+			    const uint32_t *offset,
+			    const uint16_t *weight,
+			    unsigned int comps,
+			    size_t count,
+			    size_t simd_count);
+
+	/* Bilinear remapping of count pixels of comps interleaved
+	 * components: for each pixel i and component c, with
+	 *   s = src + offset[i], t = s + src_stride,
+	 *   wx = weight[i] & 0xffff, wy = weight[i] >> 16,
+	 *   top = s[c] * (WEIGHT_ONE - wx) + s[comps + c] * wx,
+	 *   bottom = t[c] * (WEIGHT_ONE - wx) + t[comps + c] * wx,
+	 *   dst[i * comps + c] = (top * (WEIGHT_ONE - wy) + bottom * wy +
+	 *                         WEIGHT_ONE * WEIGHT_ONE / 2)
+	 *                        >> (2 * WEIGHT_BITS)
+	 * SIMD kernels only read 4 bytes at s and t for the offsets up to
+	 * simd_limit (negative if none) */
+	void (*remap_row)(uint8_t *dst,
+			  const uint8_t *src,
+			  size_t src_stride,
+			  const uint32_t *offset,
+			  const uint32_t *weight,
+			  unsigned int comps,
+			  size_t count,
+			  int32_t simd_limit);
+
+	/* Unsharp masking of a row of n bytes of comps interleaved
+	 * components, from the rows above and below it: for each i,
+	 *   d = 4 * cur[i] - up[i] - down[i] - cur[i - comps] -
+	 *       cur[i + comps],
+	 *   dst[i] = clamp(cur[i] + ((d * amount + 2 * WEIGHT_ONE)
+	 *                            >> (WEIGHT_BITS + 2)), 0, 255)
+	 * with amount in [0, SHARPEN_MAX]; the comps bytes on each side of
+	 * cur are read */
+	void (*sharpen_row)(uint8_t *dst,
+			    const uint8_t *up,
+			    const uint8_t *cur,
+			    const uint8_t *down,
+			    unsigned int amount,
+			    unsigned int comps,
+			    size_t n);
+};
+
+
+/* Portable C kernels, always available */
+extern const struct vscale_generic_kernels vscale_generic_kernels_c;
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const struct vscale_generic_kernels vscale_generic_kernels_sse4;
+extern const struct vscale_generic_kernels vscale_generic_kernels_avx2;
+#endif /* __x86_64__ || __i386__ */
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+extern const struct vscale_generic_kernels vscale_generic_kernels_neon;
+#endif /* __ARM_NEON || __aarch64__ */
+
+
+/* C kernels, also used by the SIMD implementations for the tails */
+void vscale_generic_blend_row_c(uint8_t *dst,
+				const uint8_t *a,
+				const uint8_t *b,
+				unsigned int w,
+				size_t n);
+
+void vscale_generic_accumulate_row_c(uint16_t *acc,
+				     const uint8_t *src,
+				     size_t n);
+
+void vscale_generic_hfilter_row_c(uint8_t *dst,
+				  const uint8_t *src,
+				  const uint32_t *offset,
+				  const uint16_t *weight,
+				  unsigned int comps,
+				  size_t count,
+				  size_t simd_count);
+
+void vscale_generic_remap_row_c(uint8_t *dst,
+				const uint8_t *src,
+				size_t src_stride,
+				const uint32_t *offset,
+				const uint32_t *weight,
+				unsigned int comps,
+				size_t count,
+				int32_t simd_limit);
+
+void vscale_generic_sharpen_row_c(uint8_t *dst,
+				  const uint8_t *up,
+				  const uint8_t *cur,
+				  const uint8_t *down,
+				  unsigned int amount,
+				  unsigned int comps,
+				  size_t n);
+
+
+/**
+ * Get the best kernels for the running CPU.
+ * The VSCALE_GENERIC_KERNELS environment variable can force a kernels set
+ * by name ("c", "sse4", "avx2" or "neon"), if supported.
+ * @return the kernels set
+ */
+const struct vscale_generic_kernels *vscale_generic_get_kernels(void);
+
+
+/* Plane scaling context: precomputed tables and scratch buffers for the
+ * scaling of one plane; contexts are not shared between threads */
+struct vscale_generic_plane {
+	const struct vscale_generic_kernels *kernels;
+
+	/* Dimensions in pixels */
+	unsigned int src_width;
+	unsigned int src_height;
+	unsigned int dst_width;
+	unsigned int dst_height;
+
+	/* Number of interleaved components per pixel (1 or 2) */
+	unsigned int comps;
+
+	/* Effective filtering mode (NONE, LINEAR, BILINEAR or BOX) */
+	enum vscale_filter_mode mode;
+
+	/* Horizontal tables, per output pixel: source offset in bytes and
+	 * interpolation weight (LINEAR and BILINEAR modes) or box width in
+	 * pixels and its 16-bit reciprocal (BOX mode) */
+	uint32_t *x_offset;
+	uint16_t *x_weight;
+	uint32_t *x_recip;
+	size_t simd_count;
+
+	/* Scratch rows: vertical interpolation, vertical box sums and their
+	 * horizontal prefix sums */
+	uint8_t *row;
+	uint16_t *acc;
+	uint32_t *prefix;
+
+	/* Sharpening amount of the destination rows (0 means none), and
+	 * its 3 scratch rows of sharpen_stride bytes, each with its end
+	 * pixels replicated on both sides */
+	unsigned int sharpen;
+	uint8_t *sharpen_rows;
+	size_t sharpen_stride;
+};
+
+
+/**
+ * Initialize a plane scaling context.
+ * The filtering mode falls back to a lower mode when it does not apply
+ * (e.g. BOX when upscaling, interpolation on 1 pixel wide planes).
+ * @param plane: plane context to initialize
+ * @param kernels: kernels set
+ * @param src_width: source plane width in pixels
+ * @param src_height: source plane height in pixels
+ * @param dst_width: destination plane width in pixels
+ * @param dst_height: destination plane height in pixels
+ * @param comps: number of interleaved components per pixel (1 or 2)
+ * @param mode: filtering mode
+ * @return 0 on success, negative errno value in case of error
+ */
+int vscale_generic_plane_init(struct vscale_generic_plane *plane,
+			      const struct vscale_generic_kernels *kernels,
+			      unsigned int src_width,
+			      unsigned int src_height,
+			      unsigned int dst_width,
+			      unsigned int dst_height,
+			      unsigned int comps,
+			      enum vscale_filter_mode mode);
+
+
+/**
+ * Set the sharpening strength of a plane scaling context.
+ * The destination rows are unsharp masked as they are scaled: each row
+ * gets strength times its difference with the average of its 4 neighbour
+ * pixels, the plane edges replicating their pixels; the strength is
+ * clamped below 4.
+ * @param plane: plane context
+ * @param strength: sharpening strength (0 means none)
+ * @return 0 on success, negative errno value in case of error
+ */
+int vscale_generic_plane_set_sharpen(struct vscale_generic_plane *plane,
+				     float strength);
+
+
+/**
+ * Release the tables and scratch buffers of a plane scaling context.
+ * @param plane: plane context
+ */
+void vscale_generic_plane_clear(struct vscale_generic_plane *plane);
+
+
+/**
+ * Scale the destination rows [y_start, y_end) of a plane.
+ * Each destination row only depends on the source plane (sharpened rows
+ * are scaled with their neighbour rows), so that any band of the
+ * destination plane can be scaled independently.
+ * @param plane: plane context
+ * @param src: source plane
+ * @param src_stride: source plane stride in bytes
+ * @param dst: destination of the row y_start
+ * @param dst_stride: destination stride in bytes (negative for bottom-up
+ *                    destinations)
+ * @param y_start: first destination row
+ * @param y_end: destination row after the last one
+ */
+void vscale_generic_scale_rows(struct vscale_generic_plane *plane,
+			       const uint8_t *src,
+			       size_t src_stride,
+			       uint8_t *dst,
+			       ptrdiff_t dst_stride,
+			       unsigned int y_start,
+			       unsigned int y_end);
+
+
+/* Plane remapping context (input warp): bilinear sampling position of
+ * each pixel of a scaled content rectangle, which combines the fit scaling
+ * and the warp; contexts are not shared between threads */
+struct vscale_generic_remap {
+	const struct vscale_generic_kernels *kernels;
+
+	/* Content rectangle dimensions in pixels */
+	unsigned int width;
+	unsigned int height;
+
+	/* Number of interleaved components per pixel (1 or 2) */
+	unsigned int comps;
+
+	/* Source plane stride in bytes, the offsets depend on it */
+	size_t src_stride;
+
+	/* Tables, per content pixel row after row: byte offset of the
+	 * top-left source pixel in the source plane, and interpolation
+	 * weights (horizontal in the low 16 bits, vertical in the high
+	 * 16 bits); allocated for capacity pixels */
+	uint32_t *offset;
+	uint32_t *weight;
+	size_t capacity;
+
+	/* Per content row: number of source rows needed for the content
+	 * rows up to this one */
+	unsigned int *src_rows;
+	unsigned int src_rows_capacity;
+
+	/* Largest offset for which 4 bytes can be read on both source
+	 * rows (negative if none) */
+	int32_t simd_limit;
+};
+
+
+/**
+ * Build a plane remapping context.
+ * The context tables are reused when their size allows it.
+ * @param remap: remapping context
+ * @param kernels: kernels set
+ * @param warp: input warp
+ * @param frame: input frame dimensions (luma plane)
+ * @param fit: plane fit geometry, the crop rectangle is remapped to the
+ *             content rectangle
+ * @param subsampling: plane subsampling (1 for the luma plane, 2 for the
+ *                     4:2:0 chroma planes)
+ * @param comps: number of interleaved components per pixel (1 or 2)
+ * @param src_stride: source plane stride in bytes
+ * @return 0 on success, negative errno value in case of error
+ */
+int vscale_generic_remap_build(struct vscale_generic_remap *remap,
+			       const struct vscale_generic_kernels *kernels,
+			       const struct vscale_warp *warp,
+			       const struct vdef_dim *frame,
+			       const struct vscale_fit_plane *fit,
+			       unsigned int subsampling,
+			       unsigned int comps,
+			       size_t src_stride);
+
+
+/**
+ * Release the tables of a plane remapping context.
+ * @param remap: remapping context
+ */
+void vscale_generic_remap_clear(struct vscale_generic_remap *remap);
+
+
+/**
+ * Remap the content rows [y_start, y_end) of a plane.
+ * The rows are processed in tiles, so that the source rows read by a
+ * warped tile stay in cache.
+ * @param remap: remapping context
+ * @param src: source plane
+ * @param dst: destination of the content row y_start
+ * @param dst_stride: destination stride in bytes (negative for bottom-up
+ *                    destinations)
+ * @param y_start: first content row
+ * @param y_end: content row after the last one
+ */
+void vscale_generic_remap_rows(const struct vscale_generic_remap *remap,
+			       const uint8_t *src,
+			       uint8_t *dst,
+			       ptrdiff_t dst_stride,
+			       unsigned int y_start,
+			       unsigned int y_end);
+
+
+#endif /* !_VSCALE_GENERIC_KERNELS_H_ */
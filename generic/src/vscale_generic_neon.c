@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+
+#	include <arm_neon.h>
+
+#	include "vscale_generic_kernels.h"
+
+
+static void blend_row_neon(uint8_t *dst,
+			   const uint8_t *a,
+			   const uint8_t *b,
+			   unsigned int w,
+			   size_t n)
+{
+	size_t i = 0;
+	uint16_t wb = w;
+	uint16_t wa = VSCALE_GENERIC_WEIGHT_ONE - w;
+
+	for (; i + 16 <= n; i += 16) {
+		uint8x16_t va = vld1q_u8(a + i);
+		uint8x16_t vb = vld1q_u8(b + i);
+		uint16x8_t lo = vmulq_n_u16(vmovl_u8(vget_low_u8(va)), wa);
+		uint16x8_t hi = vmulq_n_u16(vmovl_u8(vget_high_u8(va)), wa);
+		lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(vb)), wb);
+		hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(vb)), wb);
+		vst1q_u8(dst + i,
+			 vcombine_u8(
+				 vrshrn_n_u16(lo, VSCALE_GENERIC_WEIGHT_BITS),
+				 vrshrn_n_u16(hi, VSCALE_GENERIC_WEIGHT_BITS)));
+	}
+
+	vscale_generic_blend_row_c(dst + i, a + i, b + i, w, n - i);
+}
+
+
+static void accumulate_row_neon(uint16_t *acc, const uint8_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		uint8x16_t v = vld1q_u8(src + i);
+		uint16x8_t lo = vaddw_u8(vld1q_u16(acc + i), vget_low_u8(v));
+		uint16x8_t hi =
+			vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(v));
+		vst1q_u16(acc + i, lo);
+		vst1q_u16(acc + i + 8, hi);
+	}
+
+	vscale_generic_accumulate_row_c(acc + i, src + i, n - i);
+}
+
+
+/* Sharpened 16-bit values of 8 pixels: k is amount * 32, so that the
+ * rounded doubling high product is
+ * (d * amount + 2 * WEIGHT_ONE) >> (WEIGHT_BITS + 2) like in the C kernel */
+static inline int16x8_t sharpen_s16_neon(uint8x8_t c,
+					 uint8x8_t u,
+					 uint8x8_t d,
+					 uint8x8_t l,
+					 uint8x8_t r,
+					 int16_t k)
+{
+	int16x8_t vc = vreinterpretq_s16_u16(vmovl_u8(c));
+	uint16x8_t sum = vaddw_u8(vaddw_u8(vaddl_u8(u, d), l), r);
+	int16x8_t diff =
+		vsubq_s16(vshlq_n_s16(vc, 2), vreinterpretq_s16_u16(sum));
+	return vaddq_s16(vc, vqrdmulhq_n_s16(diff, k));
+}
+
+
+static void sharpen_row_neon(uint8_t *dst,
+			     const uint8_t *up,
+			     const uint8_t *cur,
+			     const uint8_t *down,
+			     unsigned int amount,
+			     unsigned int comps,
+			     size_t n)
+{
+	size_t i = 0;
+	int16_t k = amount * 32;
+
+	for (; i + 16 <= n; i += 16) {
+		uint8x16_t c = vld1q_u8(cur + i);
+		uint8x16_t u = vld1q_u8(up + i);
+		uint8x16_t d = vld1q_u8(down + i);
+		uint8x16_t l = vld1q_u8(cur + i - comps);
+		uint8x16_t r = vld1q_u8(cur + i + comps);
+		int16x8_t lo = sharpen_s16_neon(vget_low_u8(c),
+						vget_low_u8(u),
+						vget_low_u8(d),
+						vget_low_u8(l),
+						vget_low_u8(r),
+						k);
+		int16x8_t hi = sharpen_s16_neon(vget_high_u8(c),
+						vget_high_u8(u),
+						vget_high_u8(d),
+						vget_high_u8(l),
+						vget_high_u8(r),
+						k);
+		vst1q_u8(dst + i,
+			 vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+	}
+
+	vscale_generic_sharpen_row_c(
+		dst + i, up + i, cur + i, down + i, amount, comps, n - i);
+}
+
+
+const struct vscale_generic_kernels vscale_generic_kernels_neon = {
+	.name = "neon",
+	.blend_row = blend_row_neon,
+	.accumulate_row = accumulate_row_neon,
+	.hfilter_row = vscale_generic_hfilter_row_c,
+	.remap_row = vscale_generic_remap_row_c,
+	.sharpen_row = sharpen_row_neon,
+};
+
+#endif /* __ARM_NEON || __aarch64__ */
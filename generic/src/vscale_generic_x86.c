@@ -0,0 +1,481 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#	include <immintrin.h>
+
+#	include "vscale_generic_kernels.h"
+
+
+/* Functions are compiled for their instruction set whatever the compiler
+ * flags; they are only called when the CPU supports it */
+#	define TARGET_SSE4 __attribute__((target("sse4.1")))
+#	define TARGET_AVX2 __attribute__((target("avx2")))
+
+
+TARGET_SSE4 static void blend_row_sse4(uint8_t *dst,
+				       const uint8_t *a,
+				       const uint8_t *b,
+				       unsigned int w,
+				       size_t n)
+{
+	size_t i = 0;
+	__m128i wb = _mm_set1_epi16(w);
+	__m128i wa = _mm_set1_epi16(VSCALE_GENERIC_WEIGHT_ONE - w);
+	__m128i round = _mm_set1_epi16(VSCALE_GENERIC_WEIGHT_ONE / 2);
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i lo = _mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+		__m128i hi = _mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, round),
+				    VSCALE_GENERIC_WEIGHT_BITS);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, round),
+				    VSCALE_GENERIC_WEIGHT_BITS);
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_packus_epi16(lo, hi));
+	}
+
+	vscale_generic_blend_row_c(dst + i, a + i, b + i, w, n - i);
+}
+
+
+TARGET_SSE4 static void
+accumulate_row_sse4(uint16_t *acc, const uint8_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i *p = (__m128i *)(acc + i);
+		__m128i lo = _mm_loadu_si128(p);
+		__m128i hi = _mm_loadu_si128(p + 1);
+		lo = _mm_add_epi16(lo, _mm_cvtepu8_epi16(v));
+		hi = _mm_add_epi16(hi, _mm_cvtepu8_epi16(_mm_srli_si128(v, 8)));
+		_mm_storeu_si128(p, lo);
+		_mm_storeu_si128(p + 1, hi);
+	}
+
+	vscale_generic_accumulate_row_c(acc + i, src + i, n - i);
+}
+
+
+/* Sharpened 16-bit values of 8 pixels: k is amount * 32, so that the
+ * rounded high product is (d * amount + 2 * WEIGHT_ONE) >> (WEIGHT_BITS + 2)
+ * like in the C kernel */
+TARGET_SSE4 static inline __m128i sharpen_epi16_sse4(__m128i c,
+						     __m128i u,
+						     __m128i d,
+						     __m128i l,
+						     __m128i r,
+						     __m128i k)
+{
+	__m128i diff = _mm_sub_epi16(_mm_slli_epi16(c, 2),
+				     _mm_add_epi16(_mm_add_epi16(u, d),
+						   _mm_add_epi16(l, r)));
+	return _mm_add_epi16(c, _mm_mulhrs_epi16(diff, k));
+}
+
+
+TARGET_SSE4 static void sharpen_row_sse4(uint8_t *dst,
+					 const uint8_t *up,
+					 const uint8_t *cur,
+					 const uint8_t *down,
+					 unsigned int amount,
+					 unsigned int comps,
+					 size_t n)
+{
+	size_t i = 0;
+	__m128i k = _mm_set1_epi16(amount * 32);
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(cur + i));
+		__m128i u = _mm_loadu_si128((const __m128i *)(up + i));
+		__m128i d = _mm_loadu_si128((const __m128i *)(down + i));
+		__m128i l =
+			_mm_loadu_si128((const __m128i *)(cur + i - comps));
+		__m128i r =
+			_mm_loadu_si128((const __m128i *)(cur + i + comps));
+		__m128i lo = sharpen_epi16_sse4(_mm_unpacklo_epi8(c, zero),
+						_mm_unpacklo_epi8(u, zero),
+						_mm_unpacklo_epi8(d, zero),
+						_mm_unpacklo_epi8(l, zero),
+						_mm_unpacklo_epi8(r, zero),
+						k);
+		__m128i hi = sharpen_epi16_sse4(_mm_unpackhi_epi8(c, zero),
+						_mm_unpackhi_epi8(u, zero),
+						_mm_unpackhi_epi8(d, zero),
+						_mm_unpackhi_epi8(l, zero),
+						_mm_unpackhi_epi8(r, zero),
+						k);
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_packus_epi16(lo, hi));
+	}
+
+	vscale_generic_sharpen_row_c(
+		dst + i, up + i, cur + i, down + i, amount, comps, n - i);
+}
+
+
+const struct vscale_generic_kernels vscale_generic_kernels_sse4 = {
+	.name = "sse4",
+	.blend_row = blend_row_sse4,
+	.accumulate_row = accumulate_row_sse4,
+	.hfilter_row = vscale_generic_hfilter_row_c,
+	.remap_row = vscale_generic_remap_row_c,
+	.sharpen_row = sharpen_row_sse4,
+};
+
+
+TARGET_AVX2 static void blend_row_avx2(uint8_t *dst,
+				       const uint8_t *a,
+				       const uint8_t *b,
+				       unsigned int w,
+				       size_t n)
+{
+	size_t i = 0;
+	__m256i wb = _mm256_set1_epi16(w);
+	__m256i wa = _mm256_set1_epi16(VSCALE_GENERIC_WEIGHT_ONE - w);
+	__m256i round = _mm256_set1_epi16(VSCALE_GENERIC_WEIGHT_ONE / 2);
+	__m256i zero = _mm256_setzero_si256();
+
+	/* unpack/pack work within 128-bit lanes, so the byte order is
+	 * preserved */
+	for (; i + 32 <= n; i += 32) {
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i lo = _mm256_add_epi16(
+			_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), wa),
+			_mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), wb));
+		__m256i hi = _mm256_add_epi16(
+			_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), wa),
+			_mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), wb));
+		lo = _mm256_srli_epi16(_mm256_add_epi16(lo, round),
+				       VSCALE_GENERIC_WEIGHT_BITS);
+		hi = _mm256_srli_epi16(_mm256_add_epi16(hi, round),
+				       VSCALE_GENERIC_WEIGHT_BITS);
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_packus_epi16(lo, hi));
+	}
+
+	blend_row_sse4(dst + i, a + i, b + i, w, n - i);
+}
+
+
+TARGET_AVX2 static void
+accumulate_row_avx2(uint16_t *acc, const uint8_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		__m256i *p = (__m256i *)(acc + i);
+		_mm256_storeu_si256(
+			p,
+			_mm256_add_epi16(_mm256_loadu_si256(p),
+					 _mm256_cvtepu8_epi16(v)));
+	}
+
+	vscale_generic_accumulate_row_c(acc + i, src + i, n - i);
+}
+
+
+/* Interpolate 8 pixels from the 4 source bytes gathered for each pixel */
+TARGET_AVX2 static void hfilter_row_avx2(uint8_t *dst,
+					 const uint8_t *src,
+					 const uint32_t *offset,
+					 const uint16_t *weight,
+					 unsigned int comps,
+					 size_t count,
+					 size_t simd_count)
+{
+	size_t i = 0;
+	__m256i mask = _mm256_set1_epi32(0xff);
+	__m256i round = _mm256_set1_epi32(VSCALE_GENERIC_WEIGHT_ONE / 2);
+	__m256i first_dwords = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+
+	for (; i + 8 <= simd_count; i += 8) {
+		__m256i idx =
+			_mm256_loadu_si256((const __m256i *)(offset + i));
+		__m256i w = _mm256_cvtepu16_epi32(
+			_mm_loadu_si128((const __m128i *)(weight + i)));
+		__m256i g = _mm256_i32gather_epi32((const int *)src, idx, 1);
+		__m256i r;
+
+		if (comps == 1) {
+			__m256i a = _mm256_and_si256(g, mask);
+			__m256i b =
+				_mm256_and_si256(_mm256_srli_epi32(g, 8), mask);
+			r = _mm256_add_epi32(
+				_mm256_slli_epi32(a,
+						  VSCALE_GENERIC_WEIGHT_BITS),
+				_mm256_mullo_epi32(_mm256_sub_epi32(b, a), w));
+			r = _mm256_srli_epi32(_mm256_add_epi32(r, round),
+					      VSCALE_GENERIC_WEIGHT_BITS);
+			r = _mm256_packus_epi32(r, r);
+			r = _mm256_packus_epi16(r, r);
+			r = _mm256_permutevar8x32_epi32(r, first_dwords);
+			_mm_storel_epi64((__m128i *)(dst + i),
+					 _mm256_castsi256_si128(r));
+		} else {
+			__m256i au = _mm256_and_si256(g, mask);
+			__m256i av =
+				_mm256_and_si256(_mm256_srli_epi32(g, 8), mask);
+			__m256i bu = _mm256_and_si256(
+				_mm256_srli_epi32(g, 16), mask);
+			__m256i bv = _mm256_srli_epi32(g, 24);
+			__m256i du = _mm256_sub_epi32(bu, au);
+			__m256i dv = _mm256_sub_epi32(bv, av);
+			__m256i ru = _mm256_add_epi32(
+				_mm256_slli_epi32(au,
+						  VSCALE_GENERIC_WEIGHT_BITS),
+				_mm256_mullo_epi32(du, w));
+			__m256i rv = _mm256_add_epi32(
+				_mm256_slli_epi32(av,
+						  VSCALE_GENERIC_WEIGHT_BITS),
+				_mm256_mullo_epi32(dv, w));
+			ru = _mm256_srli_epi32(_mm256_add_epi32(ru, round),
+					       VSCALE_GENERIC_WEIGHT_BITS);
+			rv = _mm256_srli_epi32(_mm256_add_epi32(rv, round),
+					       VSCALE_GENERIC_WEIGHT_BITS);
+			/* One U/V pair per 32-bit lane */
+			r = _mm256_or_si256(ru, _mm256_slli_epi32(rv, 8));
+			r = _mm256_packus_epi32(r, r);
+			r = _mm256_permute4x64_epi64(r, 0x08);
+			_mm_storeu_si128((__m128i *)(dst + 2 * i),
+					 _mm256_castsi256_si128(r));
+		}
+	}
+
+	vscale_generic_hfilter_row_c(dst + i * comps,
+				     src,
+				     offset + i,
+				     weight + i,
+				     comps,
+				     count - i,
+				     0);
+}
+
+
+/* a * WEIGHT_ONE + (b - a) * w, i.e. a * (WEIGHT_ONE - w) + b * w */
+TARGET_AVX2 static inline __m256i
+lerp_avx2(__m256i a, __m256i b, __m256i w)
+{
+	return _mm256_add_epi32(
+		_mm256_slli_epi32(a, VSCALE_GENERIC_WEIGHT_BITS),
+		_mm256_mullo_epi32(_mm256_sub_epi32(b, a), w));
+}
+
+
+/* Remap 8 pixels from the 4 source bytes gathered for each pixel on the
+ * two source rows; groups of pixels with offsets beyond simd_limit are
+ * remapped by the C kernel */
+TARGET_AVX2 static void remap_row_avx2(uint8_t *dst,
+				       const uint8_t *src,
+				       size_t src_stride,
+				       const uint32_t *offset,
+				       const uint32_t *weight,
+				       unsigned int comps,
+				       size_t count,
+				       int32_t simd_limit)
+{
+	size_t i = 0;
+	__m256i mask = _mm256_set1_epi32(0xff);
+	__m256i wmask = _mm256_set1_epi32(0xffff);
+	__m256i round =
+		_mm256_set1_epi32(1 << (2 * VSCALE_GENERIC_WEIGHT_BITS - 1));
+	__m256i limit = _mm256_set1_epi32(simd_limit);
+	__m256i stride = _mm256_set1_epi32((int32_t)src_stride);
+	__m256i first_dwords = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i idx =
+			_mm256_loadu_si256((const __m256i *)(offset + i));
+		__m256i w = _mm256_loadu_si256((const __m256i *)(weight + i));
+		__m256i wx = _mm256_and_si256(w, wmask);
+		__m256i wy = _mm256_srli_epi32(w, 16);
+		__m256i over = _mm256_cmpgt_epi32(idx, limit);
+		__m256i g0, g1, s0, s1, r;
+
+		if (!_mm256_testz_si256(over, over)) {
+			vscale_generic_remap_row_c(dst + i * comps,
+						   src,
+						   src_stride,
+						   offset + i,
+						   weight + i,
+						   comps,
+						   8,
+						   -1);
+			continue;
+		}
+
+		g0 = _mm256_i32gather_epi32((const int *)src, idx, 1);
+		g1 = _mm256_i32gather_epi32(
+			(const int *)src, _mm256_add_epi32(idx, stride), 1);
+		s0 = _mm256_srli_epi32(g0, 8);
+		s1 = _mm256_srli_epi32(g1, 8);
+
+		if (comps == 1) {
+			__m256i top = lerp_avx2(_mm256_and_si256(g0, mask),
+						_mm256_and_si256(s0, mask),
+						wx);
+			__m256i bottom = lerp_avx2(_mm256_and_si256(g1, mask),
+						   _mm256_and_si256(s1, mask),
+						   wx);
+			r = _mm256_srli_epi32(
+				_mm256_add_epi32(lerp_avx2(top, bottom, wy),
+						 round),
+				2 * VSCALE_GENERIC_WEIGHT_BITS);
+			r = _mm256_packus_epi32(r, r);
+			r = _mm256_packus_epi16(r, r);
+			r = _mm256_permutevar8x32_epi32(r, first_dwords);
+			_mm_storel_epi64((__m128i *)(dst + i),
+					 _mm256_castsi256_si128(r));
+		} else {
+			__m256i top_u = lerp_avx2(
+				_mm256_and_si256(g0, mask),
+				_mm256_and_si256(_mm256_srli_epi32(g0, 16),
+						 mask),
+				wx);
+			__m256i top_v = lerp_avx2(
+				_mm256_and_si256(s0, mask),
+				_mm256_srli_epi32(g0, 24),
+				wx);
+			__m256i bottom_u = lerp_avx2(
+				_mm256_and_si256(g1, mask),
+				_mm256_and_si256(_mm256_srli_epi32(g1, 16),
+						 mask),
+				wx);
+			__m256i bottom_v = lerp_avx2(
+				_mm256_and_si256(s1, mask),
+				_mm256_srli_epi32(g1, 24),
+				wx);
+			__m256i ru = _mm256_srli_epi32(
+				_mm256_add_epi32(lerp_avx2(top_u, bottom_u, wy),
+						 round),
+				2 * VSCALE_GENERIC_WEIGHT_BITS);
+			__m256i rv = _mm256_srli_epi32(
+				_mm256_add_epi32(lerp_avx2(top_v, bottom_v, wy),
+						 round),
+				2 * VSCALE_GENERIC_WEIGHT_BITS);
+			/* One U/V pair per 32-bit lane */
+			r = _mm256_or_si256(ru, _mm256_slli_epi32(rv, 8));
+			r = _mm256_packus_epi32(r, r);
+			r = _mm256_permute4x64_epi64(r, 0x08);
+			_mm_storeu_si128((__m128i *)(dst + 2 * i),
+					 _mm256_castsi256_si128(r));
+		}
+	}
+
+	vscale_generic_remap_row_c(dst + i * comps,
+				   src,
+				   src_stride,
+				   offset + i,
+				   weight + i,
+				   comps,
+				   count - i,
+				   -1);
+}
+
+
+TARGET_AVX2 static inline __m256i sharpen_epi16_avx2(__m256i c,
+						     __m256i u,
+						     __m256i d,
+						     __m256i l,
+						     __m256i r,
+						     __m256i k)
+{
+	__m256i diff = _mm256_sub_epi16(
+		_mm256_slli_epi16(c, 2),
+		_mm256_add_epi16(_mm256_add_epi16(u, d),
+				 _mm256_add_epi16(l, r)));
+	return _mm256_add_epi16(c, _mm256_mulhrs_epi16(diff, k));
+}
+
+
+TARGET_AVX2 static void sharpen_row_avx2(uint8_t *dst,
+					 const uint8_t *up,
+					 const uint8_t *cur,
+					 const uint8_t *down,
+					 unsigned int amount,
+					 unsigned int comps,
+					 size_t n)
+{
+	size_t i = 0;
+	__m256i k = _mm256_set1_epi16(amount * 32);
+	__m256i zero = _mm256_setzero_si256();
+
+	/* unpack/pack work within 128-bit lanes, so the byte order is
+	 * preserved */
+	for (; i + 32 <= n; i += 32) {
+		__m256i c = _mm256_loadu_si256((const __m256i *)(cur + i));
+		__m256i u = _mm256_loadu_si256((const __m256i *)(up + i));
+		__m256i d = _mm256_loadu_si256((const __m256i *)(down + i));
+		__m256i l = _mm256_loadu_si256(
+			(const __m256i *)(cur + i - comps));
+		__m256i r = _mm256_loadu_si256(
+			(const __m256i *)(cur + i + comps));
+		__m256i lo =
+			sharpen_epi16_avx2(_mm256_unpacklo_epi8(c, zero),
+					   _mm256_unpacklo_epi8(u, zero),
+					   _mm256_unpacklo_epi8(d, zero),
+					   _mm256_unpacklo_epi8(l, zero),
+					   _mm256_unpacklo_epi8(r, zero),
+					   k);
+		__m256i hi =
+			sharpen_epi16_avx2(_mm256_unpackhi_epi8(c, zero),
+					   _mm256_unpackhi_epi8(u, zero),
+					   _mm256_unpackhi_epi8(d, zero),
+					   _mm256_unpackhi_epi8(l, zero),
+					   _mm256_unpackhi_epi8(r, zero),
+					   k);
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_packus_epi16(lo, hi));
+	}
+
+	sharpen_row_sse4(
+		dst + i, up + i, cur + i, down + i, amount, comps, n - i);
+}
+
+
+const struct vscale_generic_kernels vscale_generic_kernels_avx2 = {
+	.name = "avx2",
+	.blend_row = blend_row_avx2,
+	.accumulate_row = accumulate_row_avx2,
+	.hfilter_row = hfilter_row_avx2,
+	.remap_row = remap_row_avx2,
+	.sharpen_row = sharpen_row_avx2,
+};
+
+#endif /* __x86_64__ || __i386__ */
@@ -158,6 +158,26 @@ VSCALE_API struct mbuf_raw_video_frame_queue *
 vscale_get_input_buffer_queue(struct vscale_scaler *self);
 
 
+/**
+ * Report the progress of a progressive input frame.
+ * This function is only relevant if the input.progressive configuration
+ * flag is set: it sets the number of rows available from the top of an
+ * input frame already pushed to (or about to be pushed to) the input
+ * queue. A frame is considered complete once rows reaches the frame
+ * height, or once progress is reported for a later frame.
+ * @note unlike other API functions, this function can be called from any
+ * thread (e.g. from the thread that receives slices from the ISP)
+ * @param self: scaler instance handle
+ * @param frame: input frame
+ * @param rows: number of rows available
+ * @return 0 on success, negative errno value in case of error
+ * (-ENOSYS if the implementation does not support progressive input)
+ */
+VSCALE_API int vscale_set_input_rows(struct vscale_scaler *self,
+				     struct mbuf_raw_video_frame *frame,
+				     unsigned int rows);
+
+
 /**
  * Get the input buffer constraints.
  * The caller must provide a constraints structure to fill.
@@ -173,8 +193,37 @@ VSCALE_API int vscale_get_input_buffer_constraints(
 	struct vscale_input_buffer_constraints *constraints);
 
 
+/**
+ * Get the scaler statistics.
+ * The caller must provide a statistics structure to fill.
+ * @param self: scaler instance handle
+ * @param stats: pointer to a vscale_stats structure (output)
+ * @return 0 on success, negative errno value in case of error
+ * (-ENOSYS if the implementation does not provide statistics)
+ */
+VSCALE_API int vscale_get_stats(struct vscale_scaler *self,
+				struct vscale_stats *stats);
+
+
+/**
+ * Check whether an input frame was rejected by the frame rate decimation.
+ * This function is intended to be called after a failed
+ * mbuf_raw_video_frame_queue_push() of the frame to the input queue, from the
+ * same thread and while still holding a reference on the frame, to tell a
+ * decimated frame from an invalid one.
+ * @param self: scaler instance handle
+ * @param frame: the frame that failed to be pushed
+ * @return true if the last push of the frame was rejected by the frame rate
+ * decimation, false otherwise
+ */
+VSCALE_API bool vscale_is_decimated(struct vscale_scaler *self,
+				    struct mbuf_raw_video_frame *frame);
+
+
 /**
  * Get the scaler implementation used.
+ * If the implementation was VSCALE_SCALER_IMPLEM_AUTO in the configuration,
+ * this is the implementation selected by the calibration.
  * @param self: scaler instance handle
  * @return the scaler implementation used, or VSCALE_SCALER_IMPLEM_AUTO
  * in case of error
@@ -28,19 +28,27 @@
 #include <ulog.h>
 ULOG_DECLARE_TAG(ULOG_TAG);
 
+#include <limits.h>
 #include <stdatomic.h>
 
 #include <pthread.h>
+#include <sys/param.h>
 
 #include <libyuv/convert.h>
 #include <libyuv/convert_from.h>
+#include <libyuv/convert_from_argb.h>
+#include <libyuv/planar_functions.h>
 #include <libyuv/scale.h>
+#include <libyuv/scale_argb.h>
+#include <libyuv/scale_uv.h>
 
+#include <futils/futils.h>
 #include <futils/timetools.h>
 #include <libpomp.h>
 #include <media-buffers/mbuf_mem_generic.h>
 #include <media-buffers/mbuf_raw_video_frame.h>
 #include <video-scale/vscale_internal.h>
+#include <video-scale/vscale_mem.h>
 
 enum state {
 	RUNNING,
@@ -50,6 +58,55 @@ enum state {
 };
 
 
+/* Scaling resources of a thread: RGB scratch rows (see the rgb input of
+ * struct vscale_libyuv), tensor conversion (shared by the threads, it is
+ * only read) and scratch frame (the frame is scaled into it, then
+ * converted to the tensor band by band) */
+struct scale_ctx {
+	uint8_t *rgb_scratch;
+	struct vscale_tensor *tensor;
+	uint8_t *tensor_yuv;
+};
+
+
+/* Output band scaling job; the chroma lines are derived from the luma
+ * lines by band_lines(), the src planes start at the input row src_top */
+struct band_job {
+	/* Luma and chroma planes fit geometry (of the frame or of the
+	 * region of interest), and chroma planes geometry with the crop
+	 * rectangle in the input chroma planes */
+	const struct vscale_fit_plane *fit;
+	struct vscale_fit_plane cfit;
+	const struct vdef_raw_frame *in_info;
+	const uint8_t **src;
+	unsigned int src_top;
+	const struct vdef_raw_frame *out_info;
+	uint8_t **dst;
+	unsigned int y, height;
+	unsigned int cy, cheight;
+	struct scale_ctx *ctx;
+};
+
+
+/* Output frames scaling job of an input frame: the output frames
+ * [start, end) (one per region of interest, if any) in the output
+ * memory; the frame is scaled with the YUV layout of yuv_info, into the
+ * output frame or into the tensor scratch frame */
+struct frame_job {
+	const struct vdef_raw_frame *in_info;
+	const uint8_t **src;
+	const struct vdef_raw_frame *yuv_info;
+	const struct vdef_raw_frame *out_info;
+	uint8_t *mem_data;
+	const size_t *plane_size;
+	unsigned int out_plane_count;
+	size_t out_size;
+	unsigned int roi_count;
+	unsigned int start;
+	unsigned int end;
+};
+
+
 struct vscale_libyuv {
 	struct vscale_scaler *base;
 
@@ -60,22 +117,199 @@ struct vscale_libyuv {
 	bool flush_flag;
 	bool eos_flag;
 
+	/* Failed input frames not reported yet and status of the last
+	 * failure, protected by the mutex (the error event coalesces the
+	 * signals, each failure is reported on its own) */
 	struct pomp_evt *error_event;
 	int status;
+	unsigned int error_count;
 
 	pthread_t thread;
 	bool thread_launched;
 
+	/* Pre-warm done by the scaling thread, protected by the mutex */
+	bool prewarmed;
+
 	enum state state;
 
 	struct mbuf_raw_video_frame_queue *input_queue;
 	struct mbuf_raw_video_frame_queue *output_queue;
 	struct pomp_evt *output_event;
+
+	/* Output buffer pool (NULL for heap memory or a caller-supplied
+	 * pool) */
+	struct vscale_mem_pool *out_pool;
+
+	/* Scaled planes format (the input format for 4:2:0 input, I420
+	 * otherwise, gray for the luma-only output) and color properties
+	 * (BT.601 limited range for RGB input) */
+	struct vdef_raw_format yuv_format;
+	struct vdef_format_info yuv_color;
+
+	/* Luma-only output: the chroma planes are neither scaled nor
+	 * allocated, packed input is only unpacked to the luma plane */
+	bool gray;
+
+	/* Input chroma planes subsampling */
+	bool chroma_sub_x;
+	bool chroma_sub_y;
+
+	/* Packed 4:2:2 input: the input rows of each band are unpacked to
+	 * the I422 unpacked rows (unpacked_capacity rows, the rows of the
+	 * largest band, or the whole frame with regions of interest, which
+	 * share the unpacked rows of the frame), the input rows
+	 * [unpacked_top, unpacked_end) of the current frame are unpacked;
+	 * only written by the scaling thread (the frame is unpacked whole
+	 * before the worker thread scales regions of interest) */
+	bool packed;
+	struct vdef_raw_frame unpacked_info;
+	uint8_t *unpacked;
+	const uint8_t *unpacked_planes[3];
+	unsigned int unpacked_capacity;
+	unsigned int unpacked_top;
+	unsigned int unpacked_end;
+
+	/* RGB input: the content rows of a band are scaled to the RGB
+	 * scratch rows, then converted to the scaled planes */
+	bool rgb;
+
+	/* Output frames layout, tensors excepted */
+	size_t out_plane_stride[VDEF_RAW_MAX_PLANE_COUNT];
+	size_t out_plane_size[VDEF_RAW_MAX_PLANE_COUNT];
+	size_t out_size;
+
+	/* Output band height in lines (output height if slices are not
+	 * enabled) */
+	unsigned int slice_height;
+
+	/* Progressive input: rows available in the frame with the given
+	 * timestamp, protected by the mutex */
+	struct {
+		uint64_t timestamp;
+		unsigned int rows;
+	} input_progress;
+
+	enum vscale_filter_mode filter_mode;
 	enum FilterMode libyuv_mode;
+
+	/* Output orientation, applied through the output strides (only
+	 * the vertical mirror is supported), and scaled planes resolution
+	 * (the output resolution) */
+	enum vscale_orientation orientation;
+	struct vdef_dim scaled;
+
+	/* Slices or bands of packed input: the content rows of a band are
+	 * scaled with margins (see band_extend()) to the luma and chroma
+	 * band scratch rows, then copied without the margins (NULL if the
+	 * frames are scaled whole) */
+	uint8_t *band_scratch[2];
+
+	/* Luma and chroma planes fit geometry, in the scaled planes, and
+	 * pad pixel of each plane (interleaved chroma planes use the
+	 * chroma values in the plane components order) */
+	struct vscale_fit_plane fit[2];
+	uint8_t pad[3];
+
+	/* Regions of interest of the current input frame (max_rois
+	 * entries) */
+	struct vdef_rect *rois;
+
+	/* Scaling resources of the scaling thread, except the chroma
+	 * scratch plane used by the worker thread for the chroma bands */
+	struct scale_ctx ctx;
+
+	/* Output color matrix and range conversion, applied to each band
+	 * once all its planes are scaled */
+	struct vscale_color_conv color_conv;
+
+	/* Tensor output (the scratch frames of the scaling resources have
+	 * the output frame layout) */
+	struct vscale_tensor tensor;
+
+	/* Adaptive filtering mode state, only used by the scaling thread */
+	struct {
+		bool enabled;
+		unsigned int level;
+		unsigned int max_level;
+		uint64_t last_ts_us;
+		uint64_t interval_us;
+		uint64_t scale_time_us;
+		unsigned int over_count;
+		unsigned int under_count;
+	} adaptive;
+
+	/* Statistics, protected by the mutex */
+	struct vscale_stats stats;
+
+	/* NUMA placement; node is -1 until known, only used by the scaling
+	 * thread once started */
+	struct {
+		enum vscale_numa_policy policy;
+		int node;
+	} numa;
+
+	/* Worker thread (preferred_thread_count >= 2): scales the chroma
+	 * planes of a band concurrently with the luma plane, or the last
+	 * regions of interest of a frame concurrently with the first ones
+	 * (if rois is true, with its own scaling resources); the job is
+	 * protected by the worker mutex */
+	struct {
+		pthread_t thread;
+		bool launched;
+		bool rois;
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		bool stop;
+		bool pending;
+		bool rois_job;
+		struct band_job band;
+		struct frame_job frame;
+		int numa_node;
+		int status;
+		struct scale_ctx ctx;
+	} worker;
+};
+
+
+static const struct vdef_raw_format i422_format = {
+	.pix_format = VDEF_RAW_PIX_FORMAT_YUV422,
+	.pix_order = VDEF_RAW_PIX_ORDER_YUV,
+	.pix_layout = VDEF_RAW_PIX_LAYOUT_PLANAR,
+	.pix_size = 8,
+	.data_layout = VDEF_RAW_DATA_LAYOUT_PACKED,
+	.data_pad_low = false,
+	.data_little_endian = false,
+	.data_size = 8,
+};
+
+
+static const struct vdef_raw_format yuy2_format = {
+	.pix_format = VDEF_RAW_PIX_FORMAT_YUV422,
+	.pix_order = VDEF_RAW_PIX_ORDER_YUYV,
+	.pix_layout = VDEF_RAW_PIX_LAYOUT_INTERLEAVED,
+	.pix_size = 8,
+	.data_layout = VDEF_RAW_DATA_LAYOUT_PACKED,
+	.data_pad_low = false,
+	.data_little_endian = false,
+	.data_size = 8,
+};
+
+
+static const struct vdef_raw_format uyvy_format = {
+	.pix_format = VDEF_RAW_PIX_FORMAT_YUV422,
+	.pix_order = VDEF_RAW_PIX_ORDER_UYVY,
+	.pix_layout = VDEF_RAW_PIX_LAYOUT_INTERLEAVED,
+	.pix_size = 8,
+	.data_layout = VDEF_RAW_DATA_LAYOUT_PACKED,
+	.data_pad_low = false,
+	.data_little_endian = false,
+	.data_size = 8,
 };
 
 
-#define NB_SUPPORTED_FORMATS 3
+/* 4:2:0 formats are scaled as is, other formats are scaled to I420 (BGRA
+ * is libyuv ARGB) */
+#define NB_SUPPORTED_FORMATS 8
 static struct vdef_raw_format supported_formats[NB_SUPPORTED_FORMATS];
 static pthread_once_t supported_formats_is_init = PTHREAD_ONCE_INIT;
 static void initialize_supported_formats(void)
@@ -83,9 +317,18 @@ static void initialize_supported_formats(void)
 	supported_formats[0] = vdef_i420;
 	supported_formats[1] = vdef_nv12;
 	supported_formats[2] = vdef_nv21;
+	supported_formats[3] = i422_format;
+	supported_formats[4] = vdef_i444;
+	supported_formats[5] = yuy2_format;
+	supported_formats[6] = uyvy_format;
+	supported_formats[7] = vdef_bgra;
 }
 
 
+/* Default output buffer pool initial count */
+#define DEFAULT_OUT_BUF_COUNT 3
+
+
 static const enum FilterMode HANDLED_FILTER_MODES[] = {
 	[VSCALE_FILTER_MODE_AUTO] = kFilterBilinear,
 	[VSCALE_FILTER_MODE_NONE] = kFilterNone,
@@ -95,6 +338,29 @@ static const enum FilterMode HANDLED_FILTER_MODES[] = {
 };
 
 
+/* Adaptive filtering modes, from the fastest to the highest quality */
+static const enum vscale_filter_mode ADAPTIVE_FILTER_MODES[] = {
+	VSCALE_FILTER_MODE_NONE,
+	VSCALE_FILTER_MODE_LINEAR,
+	VSCALE_FILTER_MODE_BILINEAR,
+	VSCALE_FILTER_MODE_BOX,
+};
+
+
+/* Step down when the scaling time exceeds this percentage of the frame
+ * interval for ADAPTIVE_STEP_DOWN_FRAMES frames in a row */
+#define ADAPTIVE_OVER_BUDGET_PERCENT 90
+#define ADAPTIVE_STEP_DOWN_FRAMES 4
+
+/* Step up when the scaling time is below this percentage of the frame
+ * interval for ADAPTIVE_STEP_UP_FRAMES frames in a row */
+#define ADAPTIVE_HEADROOM_PERCENT 50
+#define ADAPTIVE_STEP_UP_FRAMES 30
+
+/* Weight (1/2^n) of the last value in smoothed times */
+#define SMOOTHING_SHIFT 3
+
+
 static int time_monotonic_us(uint64_t *usec)
 {
 	struct timespec ts;
@@ -119,11 +385,15 @@ static void error_evt_cb(struct pomp_evt *evt, void *userdata)
 	struct vscale_libyuv *self = userdata;
 	pthread_mutex_lock(&self->mutex);
 	int status = self->status;
+	unsigned int error_count = self->error_count;
 	self->status = 0;
+	self->error_count = 0;
 	pthread_mutex_unlock(&self->mutex);
 
-	self->base->cbs.frame_output(
-		self->base, status, NULL, self->base->userdata);
+	for (unsigned int i = 0; i < error_count; i++) {
+		self->base->cbs.frame_output(
+			self->base, status, NULL, self->base->userdata);
+	}
 }
 
 
@@ -244,6 +514,44 @@ static int stop(struct vscale_scaler *base)
 }
 
 
+static void scale_ctx_clear(struct scale_ctx *ctx)
+{
+	free(ctx->rgb_scratch);
+	free(ctx->tensor_yuv);
+}
+
+
+/* Allocate the RGB scratch rows (of the given count) and the tensor
+ * scratch frame of scaling resources */
+static int scale_ctx_init(struct vscale_libyuv *self,
+			  struct scale_ctx *ctx,
+			  unsigned int rgb_rows)
+{
+	int res;
+
+	if (self->rgb) {
+		ctx->rgb_scratch =
+			malloc((size_t)4 * self->scaled.width * rgb_rows);
+		if (ctx->rgb_scratch == NULL) {
+			res = -ENOMEM;
+			ULOG_ERRNO("malloc", -res);
+			return res;
+		}
+	}
+
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		ctx->tensor_yuv = malloc(self->out_size);
+		if (ctx->tensor_yuv == NULL) {
+			res = -ENOMEM;
+			ULOG_ERRNO("malloc", -res);
+			return res;
+		}
+	}
+
+	return 0;
+}
+
+
 static int destroy(struct vscale_scaler *base)
 {
 	struct vscale_libyuv *self = base->derived;
@@ -256,8 +564,20 @@ static int destroy(struct vscale_scaler *base)
 			ULOG_ERRNO("pthread_join", -ret);
 	}
 
+	if (self->worker.launched) {
+		pthread_mutex_lock(&self->worker.mutex);
+		self->worker.stop = true;
+		pthread_cond_broadcast(&self->worker.cond);
+		pthread_mutex_unlock(&self->worker.mutex);
+		ret = pthread_join(self->worker.thread, NULL);
+		if (ret != 0)
+			ULOG_ERRNO("pthread_join", -ret);
+	}
+
 	pthread_mutex_destroy(&self->mutex);
 	pthread_cond_destroy(&self->cond);
+	pthread_mutex_destroy(&self->worker.mutex);
+	pthread_cond_destroy(&self->worker.cond);
 	if (self->output_event != NULL) {
 		if (pomp_evt_is_attached(self->output_event, base->loop)) {
 			ret = pomp_evt_detach_from_loop(self->output_event,
@@ -296,11 +616,44 @@ static int destroy(struct vscale_scaler *base)
 			ULOG_ERRNO("mbuf_raw_video_frame_queue_destroy", -ret);
 	}
 
+	vscale_mem_pool_destroy(self->out_pool);
+	scale_ctx_clear(&self->ctx);
+	scale_ctx_clear(&self->worker.ctx);
+	free(self->unpacked);
+	free(self->band_scratch[0]);
+	free(self->band_scratch[1]);
+	vscale_tensor_clear(&self->tensor);
+	free(self->rois);
+
 	free(self);
 	return 0;
 }
 
 
+/* Input frames with a warp are rejected rather than scaled unwarped */
+static bool has_warp(struct mbuf_raw_video_frame *frame)
+{
+	int res;
+	struct vscale_warp warp;
+	struct mbuf_ancillary_data *data = NULL;
+
+	res = vscale_frame_get_warp(frame, &warp, &data);
+	if (data != NULL)
+		mbuf_ancillary_data_unref(data);
+	if (res == -ENOENT)
+		return false;
+	if (res < 0) {
+		ULOG_ERRNO("vscale_frame_get_warp", -res);
+		return true;
+	}
+	if (warp.type == VSCALE_WARP_TYPE_NONE)
+		return false;
+
+	ULOGE("input frame warp is not supported");
+	return true;
+}
+
+
 static bool input_filter(struct mbuf_raw_video_frame *frame, void *userdata)
 {
 	bool accept;
@@ -309,6 +662,9 @@ static bool input_filter(struct mbuf_raw_video_frame *frame, void *userdata)
 	if (self->state != RUNNING)
 		return false;
 
+	if (has_warp(frame))
+		return false;
+
 	accept = vscale_default_input_filter(frame, self->base);
 
 	if (accept) {
@@ -321,259 +677,1698 @@ static bool input_filter(struct mbuf_raw_video_frame *frame, void *userdata)
 }
 
 
-static void scale_frame(struct vscale_libyuv *self,
-			struct mbuf_raw_video_frame *frame)
+static uint64_t smooth(uint64_t avg, uint64_t val)
 {
-	struct vdef_raw_frame frame_info;
-	unsigned int plane_count;
-	const void *planes[3] = {0};
-	int plane_ratio = 1;
-	size_t offset = 0;
-	struct mbuf_mem *mem = NULL;
-	size_t len;
-	struct timespec cur_ts;
-	uint64_t ts_us;
-	void *mem_data;
-	uint8_t *dst;
-	struct mbuf_raw_video_frame *out_frame = NULL;
-	struct vdef_raw_frame out_frame_info;
-	unsigned int w;
-	unsigned int h;
+	if (avg == 0)
+		return val;
+	return avg - (avg >> SMOOTHING_SHIFT) + (val >> SMOOTHING_SHIFT);
+}
 
-	int res = mbuf_raw_video_frame_get_frame_info(frame, &frame_info);
-	if (res < 0) {
-		ULOG_ERRNO("mbuf_raw_video_frame_get_frame_info", -res);
-		goto end;
-	}
 
-	out_frame_info = frame_info;
+static void set_adaptive_level(struct vscale_libyuv *self, unsigned int level)
+{
+	enum vscale_filter_mode mode = ADAPTIVE_FILTER_MODES[level];
 
-	w = self->base->config.output.info.resolution.width;
-	h = self->base->config.output.info.resolution.height;
-	out_frame_info.info.resolution.width = w;
-	out_frame_info.info.resolution.height = h;
-	out_frame_info.plane_stride[0] = w;
+	ULOGI("adaptive filtering: %s -> %s",
+	      vscale_filter_mode_to_str(self->filter_mode),
+	      vscale_filter_mode_to_str(mode));
 
-	if (vdef_raw_format_cmp(&frame_info.format, &vdef_i420)) {
-		out_frame_info.plane_stride[1] = w / 2;
-		out_frame_info.plane_stride[2] = w / 2;
-	} else if (vdef_raw_format_cmp(&frame_info.format, &vdef_nv12)) {
-		out_frame_info.plane_stride[1] = w;
-	} else if (vdef_raw_format_cmp(&frame_info.format, &vdef_nv21)) {
-		out_frame_info.plane_stride[1] = w;
-	}
-	res = mbuf_raw_video_frame_new(&out_frame_info, &out_frame);
-	if (res < 0) {
-		ULOG_ERRNO("mbuf_raw_video_frame_new", -res);
-		goto end;
+	self->adaptive.level = level;
+	self->adaptive.scale_time_us = 0;
+	self->adaptive.over_count = 0;
+	self->adaptive.under_count = 0;
+	self->filter_mode = mode;
+	self->libyuv_mode = HANDLED_FILTER_MODES[mode];
+
+	pthread_mutex_lock(&self->mutex);
+	self->stats.filter_mode = mode;
+	self->stats.filter_mode_changes++;
+	pthread_mutex_unlock(&self->mutex);
+}
+
+
+static void update_stats(struct vscale_libyuv *self,
+			 const struct vdef_raw_frame *frame_info,
+			 uint64_t scale_time)
+{
+	uint64_t ts_us;
+	uint64_t budget;
+
+	pthread_mutex_lock(&self->mutex);
+	self->stats.frame_count++;
+	self->stats.scale_time_us =
+		smooth(self->stats.scale_time_us, scale_time);
+	pthread_mutex_unlock(&self->mutex);
+
+	if (!self->adaptive.enabled || frame_info->info.timescale == 0)
 		return;
-	}
 
-	time_get_monotonic(&cur_ts);
-	time_timespec_to_us(&cur_ts, &ts_us);
-	res = mbuf_raw_video_frame_add_ancillary_buffer(
-		out_frame,
-		VSCALE_ANCILLARY_KEY_DEQUEUE_TIME,
-		&ts_us,
-		sizeof(ts_us));
-	if (res < 0) {
-		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -res);
-		goto end;
+	/* Frame interval from the input timestamps */
+	ts_us = frame_info->info.timestamp * 1000000 /
+		frame_info->info.timescale;
+	if (self->adaptive.last_ts_us != UINT64_MAX &&
+	    ts_us > self->adaptive.last_ts_us) {
+		self->adaptive.interval_us =
+			smooth(self->adaptive.interval_us,
+			       ts_us - self->adaptive.last_ts_us);
 	}
+	self->adaptive.last_ts_us = ts_us;
+	if (self->adaptive.interval_us == 0)
+		return;
 
-	res = mbuf_mem_generic_new((w * h * 3) / 2, &mem);
-	if (res < 0) {
-		ULOG_ERRNO("mbuf_mem_generic_new", -res);
-		goto end;
+	self->adaptive.scale_time_us =
+		smooth(self->adaptive.scale_time_us, scale_time);
+	budget = self->adaptive.scale_time_us * 100;
+
+	if (budget >
+	    self->adaptive.interval_us * ADAPTIVE_OVER_BUDGET_PERCENT) {
+		self->adaptive.under_count = 0;
+		self->adaptive.over_count++;
+		if (self->adaptive.over_count >= ADAPTIVE_STEP_DOWN_FRAMES &&
+		    self->adaptive.level > 0)
+			set_adaptive_level(self, self->adaptive.level - 1);
+	} else if (budget <
+		   self->adaptive.interval_us * ADAPTIVE_HEADROOM_PERCENT) {
+		self->adaptive.over_count = 0;
+		self->adaptive.under_count++;
+		if (self->adaptive.under_count >= ADAPTIVE_STEP_UP_FRAMES &&
+		    self->adaptive.level < self->adaptive.max_level)
+			set_adaptive_level(self, self->adaptive.level + 1);
+	} else {
+		self->adaptive.over_count = 0;
+		self->adaptive.under_count = 0;
 	}
+}
 
-	res = mbuf_mem_get_data(mem, &mem_data, &len);
-	if (res < 0) {
-		ULOG_ERRNO("mbuf_mem_get_data", -res);
-		goto end;
+
+/* Tightly packed layout of an input frame of a supported format */
+static void input_layout(const struct vdef_raw_format *format,
+			 const struct vdef_dim *resolution,
+			 size_t stride[3],
+			 size_t size[3])
+{
+	unsigned int w = resolution->width;
+	unsigned int h = resolution->height;
+	unsigned int cw = (w + 1) / 2;
+	unsigned int ch = (h + 1) / 2;
+
+	memset(stride, 0, 3 * sizeof(*stride));
+	memset(size, 0, 3 * sizeof(*size));
+	if (vdef_raw_format_cmp(format, &yuy2_format) ||
+	    vdef_raw_format_cmp(format, &uyvy_format)) {
+		stride[0] = (size_t)4 * cw;
+	} else if (vdef_raw_format_cmp(format, &vdef_bgra)) {
+		stride[0] = (size_t)4 * w;
+	} else if (vdef_raw_format_cmp(format, &vdef_i444)) {
+		stride[0] = stride[1] = stride[2] = w;
+		size[1] = size[2] = (size_t)w * h;
+	} else if (vdef_raw_format_cmp(format, &i422_format)) {
+		stride[0] = w;
+		stride[1] = stride[2] = cw;
+		size[1] = size[2] = (size_t)cw * h;
+	} else if (vdef_raw_format_cmp(format, &vdef_i420)) {
+		stride[0] = w;
+		stride[1] = stride[2] = cw;
+		size[1] = size[2] = (size_t)cw * ch;
+	} else {
+		stride[0] = w;
+		stride[1] = (size_t)2 * cw;
+		size[1] = stride[1] * ch;
 	}
-	dst = mem_data;
+	size[0] = stride[0] * h;
+}
 
-	plane_count = vdef_get_raw_frame_plane_count(&frame_info.format);
 
-	for (unsigned int i = 0; i < plane_count; i++) {
-		res = mbuf_raw_video_frame_get_plane(
-			frame, i, &planes[i], &len);
-		if (res < 0) {
-			ULOG_ERRNO("mbuf_raw_video_frame_get_plane", -res);
-			goto end;
-		}
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	while (b != 0) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
 	}
+	return a;
+}
 
-	if (vdef_raw_format_cmp(&frame_info.format, &vdef_i420)) {
-		plane_ratio = 4;
-
-		res = I420Scale(planes[0],
-				frame_info.plane_stride[0],
-				planes[1],
-				frame_info.plane_stride[1],
-				planes[2],
-				frame_info.plane_stride[2],
-				frame_info.info.resolution.width,
-				frame_info.info.resolution.height,
-				dst,
-				w,
-				dst + w * h,
-				w / 2,
-				dst + (w * h * 5) / 4,
-				w / 2,
-				w,
-				h,
-				self->libyuv_mode);
 
-		if (res < 0) {
-			ULOG_ERRNO("I420Scale", -res);
-			goto end;
-		}
-	} else if (vdef_raw_format_cmp(&frame_info.format, &vdef_nv12) ||
-		   vdef_raw_format_cmp(&frame_info.format, &vdef_nv21)) {
-		plane_ratio = 2;
-
-		res = NV12Scale(planes[0],
-				frame_info.plane_stride[0],
-				planes[1],
-				frame_info.plane_stride[1],
-				frame_info.info.resolution.width,
-				frame_info.info.resolution.height,
-				dst,
-				w,
-				dst + w * h,
-				w,
-				w,
-				h,
-				self->libyuv_mode);
-		if (res < 0) {
-			ULOG_ERRNO("NV12Scale", -res);
-			goto end;
-		}
-	}
+/* Output lines period of the bands boundaries that map to whole source
+ * lines on both the luma and chroma planes (src_ch source chroma lines are
+ * scaled to the 4:2:0 output chroma lines) */
+static unsigned int slice_period(unsigned int src_h,
+				 unsigned int src_ch,
+				 unsigned int dst_h)
+{
+	unsigned int period_y = dst_h / gcd(src_h, dst_h);
+	unsigned int period_c =
+		2 * (((dst_h + 1) / 2) / gcd(src_ch, (dst_h + 1) / 2));
 
-	for (unsigned int i = 0; i < plane_count; i++) {
-		size_t len = i ? (w * h) / plane_ratio : (w * h);
-		res = mbuf_raw_video_frame_set_plane(
-			out_frame, i, mem, offset, len);
-		if (res < 0) {
-			ULOG_ERRNO("mbuf_raw_video_frame_set_plane", -res);
-			goto end;
-		}
-		offset += len;
-	}
+	return period_y / gcd(period_y, period_c) * period_c;
+}
 
-	res = mbuf_raw_video_frame_foreach_ancillary_data(
-		frame, mbuf_raw_video_frame_ancillary_data_copier, out_frame);
-	if (res < 0) {
-		ULOG_ERRNO("mbuf_raw_video_frame_foreach_ancillary_data", -res);
-		goto end;
-	}
 
-	struct vmeta_frame *metadata;
-	res = mbuf_raw_video_frame_get_metadata(frame, &metadata);
-	if (res == 0) {
-		res = mbuf_raw_video_frame_set_metadata(out_frame, metadata);
-		vmeta_frame_unref(metadata);
-		if (res < 0) {
-			ULOG_ERRNO("mbuf_raw_video_frame_get_metadata", -res);
-			goto end;
-		}
-	} else if (res == -ENOENT) {
-		/* No metadata, nothing to do */
-		res = 0;
-	} else {
-		ULOG_ERRNO("mbuf_raw_video_frame_get_metadata", -res);
-		goto end;
+/* Output band height so that the bands boundaries map to whole source
+ * lines on both the luma and chroma planes (see slice_period()) */
+static unsigned int compute_slice_height(unsigned int requested,
+					 unsigned int src_h,
+					 unsigned int src_ch,
+					 unsigned int dst_h)
+{
+	unsigned int period = slice_period(src_h, src_ch, dst_h);
+
+	if (requested == 0)
+		return dst_h;
+	if (period >= dst_h) {
+		ULOGW("no slice boundary maps to whole source lines "
+		      "(%u -> %u lines), frames are scaled whole",
+		      src_h,
+		      dst_h);
+		return dst_h;
 	}
+	requested = (requested + period - 1) / period * period;
+	return MIN(requested, dst_h);
+}
 
-	time_get_monotonic(&cur_ts);
-	time_timespec_to_us(&cur_ts, &ts_us);
-	res = mbuf_raw_video_frame_add_ancillary_buffer(
-		out_frame,
-		VSCALE_ANCILLARY_KEY_OUTPUT_TIME,
-		&ts_us,
-		sizeof(ts_us));
-	if (res < 0) {
-		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -res);
-		goto end;
-	}
 
-	res = mbuf_raw_video_frame_finalize(out_frame);
-	if (res < 0) {
-		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -res);
-		goto end;
-	}
+/* Source lines [*src_start, *src_end) needed for the output lines
+ * [dst_start, dst_end) */
+static void band_src_lines(unsigned int dst_start,
+			   unsigned int dst_end,
+			   unsigned int src_h,
+			   unsigned int dst_h,
+			   unsigned int *src_start,
+			   unsigned int *src_end)
+{
+	*src_start = (uint64_t)dst_start * src_h / dst_h;
+	*src_end = ((uint64_t)dst_end * src_h + dst_h - 1) / dst_h;
+	*src_end = MIN(*src_end, src_h);
+}
 
-end:
-	if (res == 0) {
-		mbuf_raw_video_frame_queue_push(self->output_queue, out_frame);
-		pomp_evt_signal(self->output_event);
-	} else {
-		pomp_evt_signal(self->error_event);
-	}
 
-	for (int i = 0; i < 3; i++) {
-		if (planes[i])
-			mbuf_raw_video_frame_release_plane(frame, i, planes[i]);
-	}
-	mbuf_raw_video_frame_unref(frame);
-	if (out_frame)
-		mbuf_raw_video_frame_unref(out_frame);
-	if (mem)
-		mbuf_mem_unref(mem);
+/* Source lines of filter support kept on each side of a band */
+#define BAND_FILTER_LINES 2
+
+
+/* Minimum height of the bands of packed input (the bands are scaled with
+ * margins, see band_extend()) */
+#define PACKED_BAND_LINES 64
+
+
+/* Scaled lines period (scaled lines that map to whole source lines) and
+ * margin (whole periods covering BAND_FILTER_LINES source lines) of the
+ * content of a plane */
+static void band_period(const struct vscale_fit_plane *fit,
+			unsigned int *period,
+			unsigned int *margin)
+{
+	unsigned int g = gcd(fit->crop.height, fit->content.height);
+	unsigned int step = fit->crop.height / g;
+
+	*period = fit->content.height / g;
+	*margin = *period * ((BAND_FILTER_LINES + step - 1) / step);
 }
 
 
-static void *work_routine(void *userdata)
+/* Scaled lines [*ext_start, *ext_end) to scale for the content lines
+ * [start, end) of a plane: libyuv clamps the filter at the edges of the
+ * source it is given, so the band is extended to lines mapping to whole
+ * source lines (which keeps the sampling phase of the whole plane) with
+ * margins of filter support, and the extra lines are dropped */
+static void band_extend(const struct vscale_fit_plane *fit,
+			unsigned int start,
+			unsigned int end,
+			unsigned int *ext_start,
+			unsigned int *ext_end)
 {
-	struct vscale_libyuv *self = userdata;
+	unsigned int top = fit->content.top;
+	unsigned int period, margin, s, e;
+
+	band_period(fit, &period, &margin);
+	s = (start - top) / period * period;
+	e = (end - top + period - 1) / period * period;
+	*ext_start = top + ((s > margin) ? s - margin : 0);
+	*ext_end = top + MIN(e + margin, fit->content.height);
+}
 
-	pthread_mutex_lock(&self->mutex);
-	while (true) {
-		if (self->stop_flag) {
-			self->stop_flag = false;
-			pomp_evt_signal(self->output_event);
-			pthread_mutex_unlock(&self->mutex);
-			break;
-		}
 
-		if (self->flush_flag) {
-			self->flush_flag = false;
-			pomp_evt_signal(self->output_event);
-			pthread_cond_wait(&self->cond, &self->mutex);
-			continue;
-		}
+/* Maximum number of extended lines of a band of rows scaled lines */
+static unsigned int band_extend_max(const struct vscale_fit_plane *fit,
+				    unsigned int rows)
+{
+	unsigned int period, margin;
 
-		struct mbuf_raw_video_frame *frame;
-		int res = mbuf_raw_video_frame_queue_pop(self->input_queue,
-							 &frame);
-		if (res < 0) {
-			if (res == -EAGAIN) {
-				if (self->eos_flag) {
-					self->eos_flag = false;
-					pomp_evt_signal(self->output_event);
-				}
-			} else {
-				ULOG_ERRNO("mbuf_raw_video_frame_pop", -res);
-			}
-			pthread_cond_wait(&self->cond, &self->mutex);
-		} else {
-			pthread_mutex_unlock(&self->mutex);
-			scale_frame(self, frame);
-			pthread_mutex_lock(&self->mutex);
+	band_period(fit, &period, &margin);
+	return MIN(rows + 2 * (period + margin), fit->content.height);
+}
+
+
+static unsigned int input_rows_locked(struct vscale_libyuv *self,
+				      uint64_t timestamp)
+{
+	if (self->input_progress.timestamp == UINT64_MAX ||
+	    self->input_progress.timestamp < timestamp)
+		return 0;
+	else if (self->input_progress.timestamp > timestamp)
+		return UINT_MAX; /* a later frame is already in progress */
+	else
+		return self->input_progress.rows;
+}
+
+
+static int wait_input_rows(struct vscale_libyuv *self,
+			   uint64_t timestamp,
+			   unsigned int rows)
+{
+	int res = 0;
+
+	pthread_mutex_lock(&self->mutex);
+	while (input_rows_locked(self, timestamp) < rows) {
+		if (self->stop_flag || self->flush_flag) {
+			res = -ECANCELED;
+			break;
 		}
+		pthread_cond_wait(&self->cond, &self->mutex);
 	}
+	pthread_mutex_unlock(&self->mutex);
 
-	return NULL;
+	return res;
 }
 
 
-static int create(struct vscale_scaler *base)
+/* Chroma lines of a band of scaled lines */
+static void band_lines(struct band_job *job)
 {
-	struct vscale_libyuv *self;
-	int ret;
+	unsigned int dh = job->fit[0].height;
+	unsigned int cdh = job->fit[1].height;
+
+	job->cy = job->y / 2;
+	job->cheight = (job->y + job->height == dh) ? cdh - job->cy
+						    : job->height / 2;
+}
+
+
+/* Chroma planes geometry with the crop rectangle in the input chroma
+ * planes, which are not subsampled horizontally and/or vertically for
+ * 4:2:2 and 4:4:4 input */
+static void chroma_src_fit(struct vscale_libyuv *self,
+			   const struct vscale_fit_plane *fit,
+			   struct vscale_fit_plane *cfit)
+{
+	*cfit = fit[1];
+	if (!self->chroma_sub_x) {
+		cfit->crop.left = fit[0].crop.left;
+		cfit->crop.width = fit[0].crop.width;
+	}
+	if (!self->chroma_sub_y) {
+		cfit->crop.top = fit[0].crop.top;
+		cfit->crop.height = fit[0].crop.height;
+	}
+}
+
+
+/* Source lines [*start, *end) needed for the scaled lines [y, y + rows)
+ * of a plane (none if the lines are only padding) */
+static void band_src_range(const struct vscale_fit_plane *fit,
+			   unsigned int y,
+			   unsigned int rows,
+			   unsigned int *start,
+			   unsigned int *end)
+{
+	unsigned int top = fit->content.top;
+	unsigned int c0 = MAX(y, top);
+	unsigned int c1 = MIN(y + rows, top + fit->content.height);
+	unsigned int s0, s1;
+
+	if (c1 <= c0) {
+		*start = 0;
+		*end = 0;
+		return;
+	}
+	band_extend(fit, c0, c1, &c0, &c1);
+	band_src_lines(c0 - top,
+		       c1 - top,
+		       fit->crop.height,
+		       fit->content.height,
+		       &s0,
+		       &s1);
+	*start = fit->crop.top + s0;
+	*end = fit->crop.top + s1;
+}
+
+
+/* Input rows [*start, *end) needed by the luma and chroma lines of a
+ * band */
+static void band_input_rows(struct vscale_libyuv *self,
+			    const struct band_job *job,
+			    unsigned int *start,
+			    unsigned int *end)
+{
+	unsigned int h = job->in_info->info.resolution.height;
+	unsigned int ls, le, cs = 0, ce = 0;
+
+	band_src_range(&job->fit[0], job->y, job->height, &ls, &le);
+	if (!self->gray)
+		band_src_range(&job->cfit, job->cy, job->cheight, &cs, &ce);
+	if (self->chroma_sub_y) {
+		cs *= 2;
+		ce = MIN(2 * ce, h);
+	}
+	if (le == 0)
+		ls = cs;
+	else if (ce == 0)
+		cs = ls;
+	*start = MIN(ls, cs);
+	*end = MAX(le, ce);
+}
+
+
+/* Destination of the scaled rows starting at y of a plane, with the
+ * orientation applied through the stride */
+static uint8_t *scaled_rows_dst(struct vscale_libyuv *self,
+				uint8_t *plane,
+				size_t stride,
+				unsigned int height,
+				unsigned int y,
+				int *dst_stride)
+{
+	if (self->orientation == VSCALE_ORIENTATION_MIRROR_V) {
+		/* Bottom-up destination */
+		*dst_stride = -(int)stride;
+		return plane + (height - 1 - y) * stride;
+	}
+
+	*dst_stride = stride;
+	return plane + y * stride;
+}
+
+
+/* Scale the scaled lines [y, y + rows) of a plane: the source crop
+ * rectangle is scaled to the content rectangle, the rest of the lines is
+ * padded */
+static int scale_plane_band(struct vscale_libyuv *self,
+			    const struct vscale_fit_plane *fit,
+			    unsigned int pixel_size,
+			    uint8_t *band_scratch,
+			    const uint8_t *pad,
+			    const uint8_t *src,
+			    unsigned int src_top,
+			    size_t src_stride,
+			    uint8_t *plane,
+			    size_t stride,
+			    unsigned int y,
+			    unsigned int rows)
+{
+	int res;
+	unsigned int top = fit->content.top;
+	unsigned int c0, c1, e0, e1, s0, s1;
+	const uint8_t *crop;
+	uint8_t *dst;
+	int dst_stride;
+	uint8_t *scaled;
+	int scaled_stride;
+
+	if (rows == 0)
+		return 0;
+
+	dst = scaled_rows_dst(
+		self, plane, stride, fit->height, y, &dst_stride);
+
+	/* Only the borders are padded */
+	vscale_fit_pad_rows(
+		fit, dst, dst_stride, y, rows, pad, pixel_size, &c0, &c1);
+
+	if (c1 > c0) {
+		band_extend(fit, c0, c1, &e0, &e1);
+		band_src_lines(e0 - top,
+			       e1 - top,
+			       fit->crop.height,
+			       fit->content.height,
+			       &s0,
+			       &s1);
+		crop = src + (fit->crop.top + s0 - src_top) * src_stride +
+		       fit->crop.left * pixel_size;
+		dst += (ptrdiff_t)(c0 - y) * dst_stride +
+		       fit->content.left * pixel_size;
+		if (e0 == c0 && e1 == c1) {
+			scaled = dst;
+			scaled_stride = dst_stride;
+		} else {
+			scaled = band_scratch;
+			scaled_stride = fit->content.width * pixel_size;
+		}
+		if (pixel_size == 1) {
+			ScalePlane(crop,
+				   src_stride,
+				   fit->crop.width,
+				   s1 - s0,
+				   scaled,
+				   scaled_stride,
+				   fit->content.width,
+				   e1 - e0,
+				   self->libyuv_mode);
+		} else {
+			res = UVScale(crop,
+				      src_stride,
+				      fit->crop.width,
+				      s1 - s0,
+				      scaled,
+				      scaled_stride,
+				      fit->content.width,
+				      e1 - e0,
+				      self->libyuv_mode);
+			if (res < 0) {
+				ULOG_ERRNO("UVScale", -res);
+				return res;
+			}
+		}
+		if (scaled != dst) {
+			CopyPlane(scaled + (size_t)(c0 - e0) * scaled_stride,
+				  scaled_stride,
+				  dst,
+				  dst_stride,
+				  fit->content.width * pixel_size,
+				  c1 - c0);
+		}
+	}
+
+	return 0;
+}
+
+
+static int scale_luma_band(struct vscale_libyuv *self,
+			   const struct band_job *job)
+{
+	return scale_plane_band(self,
+				&job->fit[0],
+				1,
+				self->band_scratch[0],
+				&self->pad[0],
+				job->src[0],
+				job->src_top,
+				job->in_info->plane_stride[0],
+				job->dst[0],
+				job->out_info->plane_stride[0],
+				job->y,
+				job->height);
+}
+
+
+/* Called on the scaling thread or on the chroma thread */
+static int scale_chroma_band(struct vscale_libyuv *self,
+			     const struct band_job *job)
+{
+	int res;
+
+	if (!vdef_raw_format_cmp(&job->out_info->format, &vdef_i420)) {
+		/* Interleaved chroma plane, the pad pixel is in the plane
+		 * components order */
+		return scale_plane_band(self,
+					&job->cfit,
+					2,
+					self->band_scratch[1],
+					&self->pad[1],
+					job->src[1],
+					job->src_top,
+					job->in_info->plane_stride[1],
+					job->dst[1],
+					job->out_info->plane_stride[1],
+					job->cy,
+					job->cheight);
+	}
+
+	/* The U and V planes share the chroma scratch plane */
+	for (unsigned int i = 1; i < 3; i++) {
+		res = scale_plane_band(self,
+				       &job->cfit,
+				       1,
+				       self->band_scratch[1],
+				       &self->pad[i],
+				       job->src[i],
+				       job->src_top,
+				       job->in_info->plane_stride[i],
+				       job->dst[i],
+				       job->out_info->plane_stride[i],
+				       job->cy,
+				       job->cheight);
+		if (res < 0)
+			return res;
+	}
+
+	return 0;
+}
+
+
+/* Start a chroma band job (band is not NULL) or a regions of interest
+ * job on the worker thread; called on the scaling thread */
+static void worker_start(struct vscale_libyuv *self,
+			 const struct band_job *band,
+			 const struct frame_job *frame)
+{
+	pthread_mutex_lock(&self->worker.mutex);
+	self->worker.rois_job = (band == NULL);
+	if (band != NULL)
+		self->worker.band = *band;
+	else
+		self->worker.frame = *frame;
+	self->worker.numa_node = self->numa.node;
+	self->worker.status = 0;
+	self->worker.pending = true;
+	pthread_cond_broadcast(&self->worker.cond);
+	pthread_mutex_unlock(&self->worker.mutex);
+}
+
+
+/* Wait for the end of the worker thread job and return its status;
+ * called on the scaling thread */
+static int worker_join(struct vscale_libyuv *self)
+{
+	int res;
+
+	pthread_mutex_lock(&self->worker.mutex);
+	while (self->worker.pending)
+		pthread_cond_wait(&self->worker.cond, &self->worker.mutex);
+	res = self->worker.status;
+	pthread_mutex_unlock(&self->worker.mutex);
+
+	return res;
+}
+
+
+/* Convert the output lines of a band to the output color properties or
+ * to the tensor, while they are still in cache; unless the orientation
+ * keeps the rows, the whole frame is converted after its last band */
+static void convert_band(struct vscale_libyuv *self,
+			 struct scale_ctx *ctx,
+			 const struct vdef_raw_frame *yuv_info,
+			 uint8_t **dst,
+			 uint8_t **tensor_dst,
+			 unsigned int y,
+			 unsigned int height)
+{
+	unsigned int h = yuv_info->info.resolution.height;
+
+	if (!self->color_conv.enabled &&
+	    self->tensor.format == VSCALE_TENSOR_FORMAT_NONE)
+		return;
+
+	if (!vscale_orientation_keeps_rows(self->orientation)) {
+		if (y + height < h)
+			return;
+		y = 0;
+		height = h;
+	}
+
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		vscale_tensor_convert_rows(ctx->tensor,
+					   &yuv_info->format,
+					   (const uint8_t *const *)dst,
+					   yuv_info->plane_stride,
+					   h,
+					   tensor_dst,
+					   y,
+					   height);
+		return;
+	}
+
+	vscale_color_conv_rows(&self->color_conv,
+			       &yuv_info->format,
+			       dst,
+			       yuv_info->plane_stride,
+			       yuv_info->info.resolution.width,
+			       h,
+			       y,
+			       height);
+}
+
+
+/* Scale the scaled lines of a band of RGB input: the content rows are
+ * scaled in RGB, then converted to the I420 planes (the luma plane only
+ * for the gray output), so that the conversion only runs on the scaled
+ * pixels; the luma and chroma planes are written together, on the calling
+ * thread */
+static int scale_rgb_band(struct vscale_libyuv *self,
+			  const struct band_job *job)
+{
+	int res;
+	const struct vscale_fit_plane *fit = job->fit;
+	const struct vdef_rect *crop = &fit[0].crop;
+	const struct vdef_rect *content = &fit[0].content;
+	size_t src_stride = job->in_info->plane_stride[0];
+	size_t rgb_stride = (size_t)content->width * 4;
+	uint8_t *dst[3];
+	int dst_stride[3];
+	unsigned int c0, c1, cc0, cc1, e0, e1, s0, s1;
+	const uint8_t *rgb;
+
+	if (job->height == 0)
+		return 0;
+
+	dst[0] = scaled_rows_dst(self,
+				 job->dst[0],
+				 job->out_info->plane_stride[0],
+				 fit[0].height,
+				 job->y,
+				 &dst_stride[0]);
+	vscale_fit_pad_rows(&fit[0],
+			    dst[0],
+			    dst_stride[0],
+			    job->y,
+			    job->height,
+			    &self->pad[0],
+			    1,
+			    &c0,
+			    &c1);
+	for (unsigned int i = 1; i < 3 && !self->gray; i++) {
+		dst[i] = scaled_rows_dst(self,
+					 job->dst[i],
+					 job->out_info->plane_stride[i],
+					 fit[1].height,
+					 job->cy,
+					 &dst_stride[i]);
+		vscale_fit_pad_rows(&fit[1],
+				    dst[i],
+				    dst_stride[i],
+				    job->cy,
+				    job->cheight,
+				    &self->pad[i],
+				    1,
+				    &cc0,
+				    &cc1);
+	}
+
+	/* The content rows start on even rows, so that they map to whole
+	 * chroma rows */
+	if (c1 > c0) {
+		band_extend(&fit[0], c0, c1, &e0, &e1);
+		band_src_lines(e0 - content->top,
+			       e1 - content->top,
+			       crop->height,
+			       content->height,
+			       &s0,
+			       &s1);
+		res = ARGBScale(job->src[0] + (crop->top + s0) * src_stride +
+					crop->left * 4,
+				src_stride,
+				crop->width,
+				s1 - s0,
+				job->ctx->rgb_scratch,
+				rgb_stride,
+				content->width,
+				e1 - e0,
+				self->libyuv_mode);
+		if (res < 0) {
+			ULOG_ERRNO("ARGBScale", -res);
+			return res;
+		}
+		rgb = job->ctx->rgb_scratch + (size_t)(c0 - e0) * rgb_stride;
+	}
+	if (c1 > c0 && self->gray) {
+		res = ARGBToI400(
+			rgb,
+			rgb_stride,
+			dst[0] + (ptrdiff_t)(c0 - job->y) * dst_stride[0] +
+				content->left,
+			dst_stride[0],
+			content->width,
+			c1 - c0);
+		if (res < 0) {
+			ULOG_ERRNO("ARGBToI400", -res);
+			return res;
+		}
+	} else if (c1 > c0) {
+		res = ARGBToI420(
+			rgb,
+			rgb_stride,
+			dst[0] + (ptrdiff_t)(c0 - job->y) * dst_stride[0] +
+				content->left,
+			dst_stride[0],
+			dst[1] + (ptrdiff_t)(c0 / 2 - job->cy) * dst_stride[1] +
+				content->left / 2,
+			dst_stride[1],
+			dst[2] + (ptrdiff_t)(c0 / 2 - job->cy) * dst_stride[2] +
+				content->left / 2,
+			dst_stride[2],
+			content->width,
+			c1 - c0);
+		if (res < 0) {
+			ULOG_ERRNO("ARGBToI420", -res);
+			return res;
+		}
+	}
+
+	return 0;
+}
+
+
+/* Unpack the input rows [start, end) of packed 4:2:2 input to the
+ * unpacked rows (their luma plane only for the gray output); the rows
+ * already unpacked are kept if the new rows follow them within the
+ * capacity, otherwise the unpacked rows restart at start (the few margin
+ * rows shared by consecutive bands are unpacked again) */
+static int unpack_rows(struct vscale_libyuv *self,
+		       const struct vdef_raw_frame *in_info,
+		       const uint8_t *src,
+		       unsigned int start,
+		       unsigned int end)
+{
+	int res;
+	const size_t *stride = self->unpacked_info.plane_stride;
+	uint8_t *dst[3];
+
+	if (end <= start)
+		return 0;
+
+	if (start < self->unpacked_top || start > self->unpacked_end ||
+	    end - self->unpacked_top > self->unpacked_capacity) {
+		self->unpacked_top = start;
+		self->unpacked_end = start;
+	}
+	if (end <= self->unpacked_end)
+		return 0;
+	start = self->unpacked_end;
+
+	src += start * in_info->plane_stride[0];
+	for (unsigned int i = 0; i < 3; i++)
+		dst[i] = (uint8_t *)self->unpacked_planes[i] +
+			 (start - self->unpacked_top) * stride[i];
+	if (self->gray &&
+	    vdef_raw_format_cmp(&in_info->format, &yuy2_format)) {
+		res = YUY2ToY(src,
+			      in_info->plane_stride[0],
+			      dst[0],
+			      stride[0],
+			      in_info->info.resolution.width,
+			      end - start);
+		if (res < 0) {
+			ULOG_ERRNO("YUY2ToY", -res);
+			return res;
+		}
+	} else if (self->gray) {
+		res = UYVYToY(src,
+			      in_info->plane_stride[0],
+			      dst[0],
+			      stride[0],
+			      in_info->info.resolution.width,
+			      end - start);
+		if (res < 0) {
+			ULOG_ERRNO("UYVYToY", -res);
+			return res;
+		}
+	} else if (vdef_raw_format_cmp(&in_info->format, &yuy2_format)) {
+		res = YUY2ToI422(src,
+				 in_info->plane_stride[0],
+				 dst[0],
+				 stride[0],
+				 dst[1],
+				 stride[1],
+				 dst[2],
+				 stride[2],
+				 in_info->info.resolution.width,
+				 end - start);
+		if (res < 0) {
+			ULOG_ERRNO("YUY2ToI422", -res);
+			return res;
+		}
+	} else {
+		res = UYVYToI422(src,
+				 in_info->plane_stride[0],
+				 dst[0],
+				 stride[0],
+				 dst[1],
+				 stride[1],
+				 dst[2],
+				 stride[2],
+				 in_info->info.resolution.width,
+				 end - start);
+		if (res < 0) {
+			ULOG_ERRNO("UYVYToI422", -res);
+			return res;
+		}
+	}
+	self->unpacked_end = end;
+
+	return 0;
+}
+
+
+/* Scale the scaled lines [y, y + height) (luma lines, y and height are
+ * even except for the last band) with the scaling resources of the
+ * calling thread; the chroma planes are scaled on the worker thread while
+ * the luma plane is scaled on the calling thread if use_worker is true
+ * (scaling thread only) */
+static int scale_band(struct vscale_libyuv *self,
+		      struct scale_ctx *ctx,
+		      bool use_worker,
+		      const struct vscale_fit_plane *fit,
+		      const struct vdef_raw_frame *in_info,
+		      const uint8_t **src,
+		      const struct vdef_raw_frame *out_info,
+		      uint8_t **dst,
+		      unsigned int y,
+		      unsigned int height)
+{
+	int res, chroma_res;
+	unsigned int start, end;
+	struct band_job job = {
+		.fit = fit,
+		.in_info = in_info,
+		.src = src,
+		.out_info = out_info,
+		.dst = dst,
+		.y = y,
+		.height = height,
+		.ctx = ctx,
+	};
+
+	band_lines(&job);
+	chroma_src_fit(self, fit, &job.cfit);
+
+	/* Input rows needed by the band */
+	band_input_rows(self, &job, &start, &end);
+
+	if (self->base->config.input.progressive) {
+		res = wait_input_rows(self, in_info->info.timestamp, end);
+		if (res < 0)
+			return res;
+	}
+
+	if (self->rgb)
+		return scale_rgb_band(self, &job);
+
+	/* Packed input is scaled from the unpacked rows */
+	if (self->packed) {
+		res = unpack_rows(self, in_info, src[0], start, end);
+		if (res < 0)
+			return res;
+		job.in_info = &self->unpacked_info;
+		job.src = self->unpacked_planes;
+		job.src_top = self->unpacked_top;
+	}
+
+	if (self->gray)
+		return scale_luma_band(self, &job);
+
+	if (!use_worker || job.cheight == 0) {
+		res = scale_luma_band(self, &job);
+		if (res < 0)
+			return res;
+		res = scale_chroma_band(self, &job);
+	} else {
+		worker_start(self, &job, NULL);
+
+		res = scale_luma_band(self, &job);
+
+		/* Join the chroma job before the output frame is
+		 * finalized */
+		chroma_res = worker_join(self);
+		if (res == 0)
+			res = chroma_res;
+	}
+
+	return res;
+}
+
+
+/* Called on the scaling thread */
+static void numa_place(struct vscale_libyuv *self, unsigned int node)
+{
+	int res;
+
+	res = vscale_numa_bind_thread(node);
+	if (res < 0)
+		ULOG_ERRNO("vscale_numa_bind_thread:%u", -res, node);
+
+	if (self->out_pool != NULL) {
+		res = vscale_mem_pool_set_numa_node(self->out_pool, node);
+		if (res < 0)
+			ULOG_ERRNO("vscale_mem_pool_set_numa_node", -res);
+	}
+
+	self->numa.node = node;
+	ULOGI("NUMA node: %u", node);
+}
+
+
+/* Scale the output frame k of a frame job (region of interest k, if any)
+ * with the scaling resources of the calling thread; the chroma planes are
+ * scaled on the worker thread if use_worker is true (scaling thread
+ * only) */
+static int scale_output(struct vscale_libyuv *self,
+			struct scale_ctx *ctx,
+			bool use_worker,
+			const struct frame_job *job,
+			unsigned int k)
+{
+	int res;
+	const struct vscale_fit_plane *fit = self->fit;
+	struct vscale_fit_plane roi_fit[2];
+	unsigned int slice_height = self->slice_height;
+	unsigned int yuv_plane_count =
+		vdef_get_raw_frame_plane_count(&self->yuv_format);
+	uint8_t *dst = job->mem_data + k * job->out_size;
+	uint8_t *dst_planes[3] = {0};
+	uint8_t *tensor_planes[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	uint8_t **out_planes = dst_planes;
+
+	/* The regions are scaled whole, without slices */
+	if (job->roi_count > 0) {
+		res = vscale_roi_fit_compute(
+			self->base->config.output.fit_mode,
+			&self->rois[k],
+			&self->scaled,
+			&roi_fit[0],
+			&roi_fit[1]);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_roi_fit_compute", -res);
+			return res;
+		}
+		fit = roi_fit;
+		slice_height = self->scaled.height;
+	}
+
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		for (unsigned int i = 0; i < job->out_plane_count; i++) {
+			tensor_planes[i] = dst;
+			dst += job->plane_size[i];
+		}
+		dst = ctx->tensor_yuv;
+		out_planes = tensor_planes;
+	}
+	for (unsigned int i = 0; i < yuv_plane_count; i++) {
+		dst_planes[i] = dst;
+		dst += self->out_plane_size[i];
+	}
+
+	/* Bands of scaled lines, output lines unless rotated */
+	for (unsigned int y = 0; y < self->scaled.height; y += slice_height) {
+		unsigned int height =
+			MIN(slice_height, self->scaled.height - y);
+
+		res = scale_band(self,
+				 ctx,
+				 use_worker,
+				 fit,
+				 job->in_info,
+				 job->src,
+				 job->yuv_info,
+				 dst_planes,
+				 y,
+				 height);
+		if (res < 0)
+			return res;
+
+		convert_band(self,
+			     ctx,
+			     job->yuv_info,
+			     dst_planes,
+			     tensor_planes,
+			     y,
+			     height);
+
+		if (job->roi_count == 0 &&
+		    self->base->config.output.slice_height != 0 &&
+		    vscale_orientation_keeps_rows(self->orientation) &&
+		    self->base->cbs.slice_output != NULL) {
+			self->base->cbs.slice_output(
+				self->base,
+				job->out_info,
+				(const uint8_t *const *)out_planes,
+				y,
+				height,
+				self->base->userdata);
+		}
+	}
+
+	return 0;
+}
+
+
+static void *worker_routine(void *userdata)
+{
+	struct vscale_libyuv *self = userdata;
+	int node = -1;
+
+	pthread_mutex_lock(&self->worker.mutex);
+	while (!self->worker.stop) {
+		if (!self->worker.pending) {
+			pthread_cond_wait(&self->worker.cond,
+					  &self->worker.mutex);
+			continue;
+		}
+
+		bool rois_job = self->worker.rois_job;
+		struct band_job band = self->worker.band;
+		struct frame_job frame = self->worker.frame;
+		int numa_node = self->worker.numa_node;
+		int res = 0;
+		pthread_mutex_unlock(&self->worker.mutex);
+
+		/* Follow the scaling thread NUMA placement */
+		if (numa_node >= 0 && numa_node != node) {
+			res = vscale_numa_bind_thread(numa_node);
+			if (res < 0) {
+				ULOG_ERRNO("vscale_numa_bind_thread:%d",
+					   -res,
+					   numa_node);
+			}
+			node = numa_node;
+			res = 0;
+		}
+
+		if (rois_job) {
+			for (unsigned int k = frame.start;
+			     k < frame.end && res == 0;
+			     k++) {
+				res = scale_output(
+					self, &self->worker.ctx, false, &frame, k);
+			}
+		} else {
+			res = scale_chroma_band(self, &band);
+		}
+
+		pthread_mutex_lock(&self->worker.mutex);
+		self->worker.status = res;
+		self->worker.pending = false;
+		pthread_cond_broadcast(&self->worker.cond);
+	}
+	pthread_mutex_unlock(&self->worker.mutex);
+
+	return NULL;
+}
+
+
+/* Finalize the output frame of the output slot at offset in the output
+ * memory, and push it to the output queue; roi is NULL unless the input
+ * frame has regions of interest; the stages are accounted to timer */
+static int output_frame(struct vscale_libyuv *self,
+			struct mbuf_raw_video_frame *frame,
+			struct vdef_raw_frame *out_info,
+			struct mbuf_mem *mem,
+			const struct vscale_memfd *mem_memfd,
+			size_t offset,
+			const size_t *plane_size,
+			unsigned int plane_count,
+			const struct vscale_roi *roi,
+			struct vscale_timestamps *ts,
+			struct vscale_frame_timer *timer)
+{
+	int res;
+	struct mbuf_raw_video_frame *out_frame = NULL;
+	struct vscale_memfd memfd = *mem_memfd;
+	struct vmeta_frame *metadata;
+
+	res = mbuf_raw_video_frame_new(out_info, &out_frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_new", -res);
+		return res;
+	}
+
+	for (unsigned int i = 0; i < plane_count; i++) {
+		res = mbuf_raw_video_frame_set_plane(
+			out_frame, i, mem, offset, plane_size[i]);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_set_plane", -res);
+			goto out;
+		}
+		memfd.plane_offset[i] = offset;
+		offset += plane_size[i];
+	}
+
+	if (memfd.fd >= 0) {
+		res = mbuf_raw_video_frame_add_ancillary_buffer(
+			out_frame,
+			VSCALE_ANCILLARY_KEY_MEMFD,
+			&memfd,
+			sizeof(memfd));
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer",
+				   -res);
+			goto out;
+		}
+	}
+
+	vscale_frame_timer_lap(timer, VSCALE_STAGE_OUTPUT);
+
+	/* Share the input ancillary data by reference */
+	res = mbuf_raw_video_frame_foreach_ancillary_data(
+		frame, vscale_ancillary_data_sharer, out_frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_foreach_ancillary_data", -res);
+		goto out;
+	}
+
+	res = mbuf_raw_video_frame_get_metadata(frame, &metadata);
+	if (res == 0) {
+		res = mbuf_raw_video_frame_set_metadata(out_frame, metadata);
+		vmeta_frame_unref(metadata);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_get_metadata", -res);
+			goto out;
+		}
+	} else if (res == -ENOENT) {
+		/* No metadata, nothing to do */
+		res = 0;
+	} else {
+		ULOG_ERRNO("mbuf_raw_video_frame_get_metadata", -res);
+		goto out;
+	}
+
+	vscale_frame_timer_lap(timer, VSCALE_STAGE_COPY);
+
+	if (roi != NULL) {
+		res = mbuf_raw_video_frame_add_ancillary_buffer(
+			out_frame, VSCALE_ANCILLARY_KEY_ROI, roi, sizeof(*roi));
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer",
+				   -res);
+			goto out;
+		}
+	}
+
+	time_monotonic_us(&ts->output_time);
+	res = mbuf_raw_video_frame_add_ancillary_buffer(
+		out_frame, VSCALE_ANCILLARY_KEY_TIMESTAMPS, ts, sizeof(*ts));
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -res);
+		goto out;
+	}
+
+	vscale_frame_timer_lap(timer, VSCALE_STAGE_OUTPUT);
+	res = vscale_frame_timer_set(timer, out_frame);
+	if (res < 0)
+		goto out;
+
+	res = mbuf_raw_video_frame_finalize(out_frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_add_ancillary_buffer", -res);
+		goto out;
+	}
+
+	/* Direct output from the scaling thread, or through the loop */
+	if (self->base->cbs.frame_output_direct != NULL) {
+		self->base->cbs.frame_output_direct(
+			self->base, out_frame, self->base->userdata);
+	} else {
+		mbuf_raw_video_frame_queue_push(self->output_queue, out_frame);
+		pomp_evt_signal(self->output_event);
+	}
+
+out:
+	mbuf_raw_video_frame_unref(out_frame);
+	return res;
+}
+
+
+/* Scale an input frame to one output frame, or to one output frame per
+ * region of interest; the output frames of an input frame are packed in
+ * one output memory */
+static void scale_frame(struct vscale_libyuv *self,
+			struct mbuf_raw_video_frame *frame)
+{
+	struct vdef_raw_frame frame_info;
+	unsigned int plane_count;
+	const void *planes[3] = {0};
+	struct mbuf_mem *mem = NULL;
+	size_t len;
+	struct vscale_timestamps ts = {0};
+	uint64_t dequeue_time = 0;
+	struct vscale_frame_timer timer;
+	struct vscale_memfd memfd = {.fd = -1};
+	void *mem_data;
+	struct vdef_raw_frame out_frame_info;
+	struct vdef_raw_frame yuv_info;
+	size_t out_size, mem_size;
+	size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	unsigned int out_plane_count;
+	unsigned int roi_count = 0;
+	unsigned int out_count;
+	struct frame_job job;
+	bool worker_busy = false;
+	unsigned int w;
+	unsigned int h;
+	uint64_t scale_start = 0;
+	uint64_t scale_end = 0;
+	uint64_t scale_time = 0;
+
+	/* The frame is dequeued, before any work on it */
+	time_monotonic_us(&dequeue_time);
+	vscale_frame_timer_start(&timer, self->base->config.timings);
+
+	int res = mbuf_raw_video_frame_get_frame_info(frame, &frame_info);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_get_frame_info", -res);
+		goto end;
+	}
+
+	(void)vscale_frame_get_timestamps(frame, &ts);
+	ts.dequeue_time = dequeue_time;
+
+	/* The scaling paths and buffers are set up for the configured
+	 * input format */
+	if (!vdef_raw_format_cmp(&frame_info.format,
+				 &self->base->config.input.format)) {
+		res = -EPROTO;
+		ULOG_ERRNO("input format " VDEF_RAW_FORMAT_TO_STR_FMT,
+			   -res,
+			   VDEF_RAW_FORMAT_TO_STR_ARG(&frame_info.format));
+		goto end;
+	}
+
+	if (self->base->config.output.max_rois > 0) {
+		res = vscale_frame_get_input_rois(
+			frame,
+			&frame_info.info.resolution,
+			self->rois,
+			self->base->config.output.max_rois);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_frame_get_input_rois", -res);
+			goto end;
+		}
+		roi_count = res;
+		res = 0;
+	}
+	out_count = MAX(roi_count, 1);
+
+	out_frame_info = frame_info;
+	out_frame_info.format = self->yuv_format;
+	if (self->rgb) {
+		out_frame_info.info.matrix_coefs = self->yuv_color.matrix_coefs;
+		out_frame_info.info.full_range = self->yuv_color.full_range;
+	}
+	if (self->base->config.output.info.matrix_coefs !=
+	    VDEF_MATRIX_COEFS_UNKNOWN) {
+		out_frame_info.info.matrix_coefs =
+			self->base->config.output.info.matrix_coefs;
+		out_frame_info.info.full_range =
+			self->base->config.output.info.full_range;
+	}
+
+	w = self->base->config.output.info.resolution.width;
+	h = self->base->config.output.info.resolution.height;
+	out_frame_info.info.resolution.width = w;
+	out_frame_info.info.resolution.height = h;
+	memcpy(out_frame_info.plane_stride,
+	       self->out_plane_stride,
+	       sizeof(out_frame_info.plane_stride));
+	memcpy(plane_size, self->out_plane_size, sizeof(plane_size));
+
+	plane_count = vdef_get_raw_frame_plane_count(&frame_info.format);
+	out_plane_count = vdef_get_raw_frame_plane_count(&self->yuv_format);
+
+	/* The frame is scaled with the YUV layout, into the output buffer
+	 * or into the tensor scratch frame */
+	yuv_info = out_frame_info;
+	out_size = self->out_size;
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		out_frame_info.format = self->tensor.raw_format;
+		out_frame_info.info.matrix_coefs = VDEF_MATRIX_COEFS_IDENTITY;
+		out_frame_info.info.full_range = true;
+		memcpy(out_frame_info.plane_stride,
+		       self->tensor.plane_stride,
+		       sizeof(out_frame_info.plane_stride));
+		memcpy(plane_size,
+		       self->tensor.plane_size,
+		       sizeof(self->tensor.plane_size));
+		out_plane_count = self->tensor.plane_count;
+		out_size = self->tensor.size;
+	}
+	mem_size = out_count * out_size;
+
+	for (unsigned int i = 0; i < plane_count; i++) {
+		res = mbuf_raw_video_frame_get_plane(
+			frame, i, &planes[i], &len);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_get_plane", -res);
+			goto end;
+		}
+	}
+
+	vscale_frame_timer_lap(&timer, VSCALE_STAGE_MAP);
+
+	/* Follow the first input frame memory, before getting the output
+	 * buffer so that it is allocated on the same node */
+	if (self->numa.policy == VSCALE_NUMA_POLICY_AUTO &&
+	    self->numa.node < 0) {
+		res = vscale_numa_get_mem_node(planes[0]);
+		if (res >= 0)
+			numa_place(self, res);
+		else
+			self->numa.policy = VSCALE_NUMA_POLICY_NONE;
+	}
+
+	if (self->base->cbs.get_output_mem != NULL) {
+		res = self->base->cbs.get_output_mem(self->base,
+						     &out_frame_info,
+						     mem_size,
+						     &mem,
+						     self->base->userdata);
+		if (res < 0) {
+			ULOG_ERRNO("get_output_mem", -res);
+			goto end;
+		}
+	} else if (self->out_pool != NULL) {
+		res = vscale_mem_pool_get(self->out_pool, &mem, &memfd.fd);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_mem_pool_get", -res);
+			goto end;
+		}
+	} else if (self->base->config.output.pool != NULL) {
+		res = mbuf_pool_get(self->base->config.output.pool, &mem);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_pool_get", -res);
+			goto end;
+		}
+	} else {
+		res = mbuf_mem_generic_new(mem_size, &mem);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_mem_generic_new", -res);
+			goto end;
+		}
+	}
+
+	vscale_frame_timer_lap(&timer, VSCALE_STAGE_ALLOC);
+
+	res = mbuf_mem_get_data(mem, &mem_data, &len);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_mem_get_data", -res);
+		goto end;
+	}
+	memfd.size = len;
+	if (len < mem_size) {
+		res = -ENOBUFS;
+		ULOGE("output memory too small: %zu < %zu", len, mem_size);
+		goto end;
+	}
+
+	vscale_frame_timer_lap(&timer, VSCALE_STAGE_MAP);
+
+	/* The regions of interest share the unpacked rows of the frame */
+	self->unpacked_top = 0;
+	self->unpacked_end = 0;
+
+	job.in_info = &frame_info;
+	job.src = (const uint8_t **)planes;
+	job.yuv_info = &yuv_info;
+	job.out_info = &out_frame_info;
+	job.mem_data = mem_data;
+	job.plane_size = plane_size;
+	job.out_plane_count = out_plane_count;
+	job.out_size = out_size;
+	job.roi_count = roi_count;
+	job.start = 0;
+	job.end = out_count;
+
+	/* The last half of the regions of interest is scaled on the worker
+	 * thread while the first half is scaled and output; packed input is
+	 * unpacked whole first, as both threads read the unpacked rows */
+	if (self->worker.rois && roi_count >= 2) {
+		struct frame_job worker_job = job;
+		if (self->packed) {
+			if (self->base->config.input.progressive) {
+				res = wait_input_rows(
+					self,
+					frame_info.info.timestamp,
+					frame_info.info.resolution.height);
+				if (res < 0)
+					goto end;
+			}
+			res = unpack_rows(self,
+					  &frame_info,
+					  planes[0],
+					  0,
+					  frame_info.info.resolution.height);
+			if (res < 0)
+				goto end;
+		}
+		job.end = (roi_count + 1) / 2;
+		worker_job.start = job.end;
+		worker_start(self, NULL, &worker_job);
+		worker_busy = true;
+	}
+
+	for (unsigned int k = 0; k < out_count; k++) {
+		struct vscale_roi roi = {
+			.index = k,
+			.count = roi_count,
+			.offset = k * out_size,
+			.size = out_size,
+		};
+
+		time_monotonic_us(&scale_start);
+		if (k < job.end) {
+			res = scale_output(self,
+					   &self->ctx,
+					   self->worker.launched && !worker_busy,
+					   &job,
+					   k);
+		} else if (worker_busy) {
+			res = worker_join(self);
+			worker_busy = false;
+		}
+		time_monotonic_us(&scale_end);
+		scale_time += scale_end - scale_start;
+		if (res < 0)
+			break;
+		vscale_frame_timer_lap(&timer, VSCALE_STAGE_SCALE);
+
+		if (roi_count > 0)
+			roi.rect = self->rois[k];
+		res = output_frame(self,
+				   frame,
+				   &out_frame_info,
+				   mem,
+				   &memfd,
+				   roi.offset,
+				   plane_size,
+				   out_plane_count,
+				   (roi_count > 0) ? &roi : NULL,
+				   &ts,
+				   &timer);
+		if (res < 0)
+			break;
+	}
+
+	/* The worker thread uses the input and output frames */
+	if (worker_busy)
+		(void)worker_join(self);
+
+end:
+	if (res == 0) {
+		update_stats(self, &frame_info, scale_time);
+	} else if (res != -ECANCELED) {
+		pthread_mutex_lock(&self->mutex);
+		self->status = res;
+		self->error_count++;
+		pthread_mutex_unlock(&self->mutex);
+		pomp_evt_signal(self->error_event);
+	}
+
+	for (int i = 0; i < 3; i++) {
+		if (planes[i])
+			mbuf_raw_video_frame_release_plane(frame, i, planes[i]);
+	}
+	mbuf_raw_video_frame_unref(frame);
+	if (mem)
+		mbuf_mem_unref(mem);
+}
+
+
+/* Scale a dummy frame with the configured geometry into an output buffer,
+ * so that the first frames do not pay for the lazy initializations (libyuv
+ * CPU detection, threads stacks, page faults); called on the scaling
+ * thread before the first frame */
+static int prewarm(struct vscale_libyuv *self)
+{
+	int res;
+	const struct vscale_config *config = &self->base->config;
+	unsigned int plane_count =
+		vdef_get_raw_frame_plane_count(&self->yuv_format);
+	struct vdef_raw_frame in_info = {0};
+	struct vdef_raw_frame yuv_info = {0};
+	size_t src_plane_size[3];
+	size_t src_size = 0;
+	uint8_t *src;
+	const uint8_t *src_planes[3] = {0};
+	struct mbuf_mem *mem = NULL;
+	void *mem_data;
+	size_t len;
+	uint8_t *dst;
+	uint8_t *dst_planes[3] = {0};
+	uint8_t *tensor_planes[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	size_t mem_size = (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE)
+				  ? self->tensor.size
+				  : self->out_size;
+
+	in_info.format = config->input.format;
+	in_info.info.resolution = config->input.info.resolution;
+	input_layout(&in_info.format,
+		     &in_info.info.resolution,
+		     in_info.plane_stride,
+		     src_plane_size);
+	for (unsigned int i = 0; i < 3; i++)
+		src_size += src_plane_size[i];
+
+	src = calloc(src_size, 1);
+	if (src == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("calloc", -res);
+		return res;
+	}
+	src_planes[0] = src;
+	for (unsigned int i = 1; i < 3; i++)
+		src_planes[i] = src_planes[i - 1] + src_plane_size[i - 1];
+
+	yuv_info.format = self->yuv_format;
+	yuv_info.info.resolution = config->output.info.resolution;
+	memcpy(yuv_info.plane_stride,
+	       self->out_plane_stride,
+	       sizeof(yuv_info.plane_stride));
+
+	if (self->out_pool != NULL) {
+		res = vscale_mem_pool_get(self->out_pool, &mem, NULL);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_mem_pool_get", -res);
+			goto out;
+		}
+	} else {
+		res = mbuf_pool_get(config->output.pool, &mem);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_pool_get", -res);
+			goto out;
+		}
+	}
+	res = mbuf_mem_get_data(mem, &mem_data, &len);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_mem_get_data", -res);
+		goto out;
+	}
+	if (len < mem_size) {
+		res = -ENOBUFS;
+		ULOGE("output memory too small: %zu < %zu", len, mem_size);
+		goto out;
+	}
+	dst = mem_data;
+	if (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		for (unsigned int i = 0; i < self->tensor.plane_count; i++) {
+			tensor_planes[i] = dst;
+			dst += self->tensor.plane_size[i];
+		}
+		dst = self->ctx.tensor_yuv;
+	}
+	for (unsigned int i = 0; i < plane_count; i++) {
+		dst_planes[i] = dst;
+		dst += self->out_plane_size[i];
+	}
+
+	/* Progressive input: all the rows of the dummy frame are
+	 * available */
+	pthread_mutex_lock(&self->mutex);
+	self->input_progress.timestamp = in_info.info.timestamp;
+	self->input_progress.rows = UINT_MAX;
+	pthread_mutex_unlock(&self->mutex);
+
+	self->unpacked_top = 0;
+	self->unpacked_end = 0;
+	for (unsigned int y = 0; y < self->scaled.height;
+	     y += self->slice_height) {
+		unsigned int height =
+			MIN(self->slice_height, self->scaled.height - y);
+
+		res = scale_band(self,
+				 &self->ctx,
+				 self->worker.launched,
+				 self->fit,
+				 &in_info,
+				 src_planes,
+				 &yuv_info,
+				 dst_planes,
+				 y,
+				 height);
+		if (res < 0)
+			break;
+
+		convert_band(self,
+			     &self->ctx,
+			     &yuv_info,
+			     dst_planes,
+			     tensor_planes,
+			     y,
+			     height);
+	}
+
+	pthread_mutex_lock(&self->mutex);
+	self->input_progress.timestamp = UINT64_MAX;
+	self->input_progress.rows = 0;
+	pthread_mutex_unlock(&self->mutex);
+
+out:
+	if (mem)
+		mbuf_mem_unref(mem);
+	free(src);
+	return res;
+}
+
+
+static void *work_routine(void *userdata)
+{
+	struct vscale_libyuv *self = userdata;
+
+	if (self->numa.policy == VSCALE_NUMA_POLICY_NODE)
+		numa_place(self, self->base->config.numa.node);
+
+	if (self->base->config.prewarm) {
+		int res = prewarm(self);
+		if (res < 0)
+			ULOG_ERRNO("prewarm", -res);
+		pthread_mutex_lock(&self->mutex);
+		self->prewarmed = true;
+		pthread_cond_broadcast(&self->cond);
+		pthread_mutex_unlock(&self->mutex);
+	}
+
+	pthread_mutex_lock(&self->mutex);
+	while (true) {
+		if (self->stop_flag) {
+			self->stop_flag = false;
+			pomp_evt_signal(self->output_event);
+			pthread_mutex_unlock(&self->mutex);
+			break;
+		}
+
+		if (self->flush_flag) {
+			self->flush_flag = false;
+			pomp_evt_signal(self->output_event);
+			pthread_cond_wait(&self->cond, &self->mutex);
+			continue;
+		}
+
+		struct mbuf_raw_video_frame *frame;
+		int res = mbuf_raw_video_frame_queue_pop(self->input_queue,
+							 &frame);
+		if (res < 0) {
+			if (res == -EAGAIN) {
+				if (self->eos_flag) {
+					self->eos_flag = false;
+					pomp_evt_signal(self->output_event);
+				}
+			} else {
+				ULOG_ERRNO("mbuf_raw_video_frame_pop", -res);
+			}
+			pthread_cond_wait(&self->cond, &self->mutex);
+		} else {
+			pthread_mutex_unlock(&self->mutex);
+			scale_frame(self, frame);
+			pthread_mutex_lock(&self->mutex);
+		}
+	}
+
+	return NULL;
+}
+
+
+static int create(struct vscale_scaler *base)
+{
+	struct vscale_libyuv *self;
+	int ret;
+	unsigned int rgb_rows;
 
 	self = calloc(1, sizeof(*self));
 	if (self == NULL) {
@@ -586,6 +2381,8 @@ static int create(struct vscale_scaler *base)
 
 	pthread_mutex_init(&self->mutex, NULL);
 	pthread_cond_init(&self->cond, NULL);
+	pthread_mutex_init(&self->worker.mutex, NULL);
+	pthread_cond_init(&self->worker.cond, NULL);
 	self->state = RUNNING;
 
 	ret = mbuf_raw_video_frame_queue_new_with_args(
@@ -633,6 +2430,378 @@ static int create(struct vscale_scaler *base)
 		goto err;
 	}
 
+	self->numa.policy = base->config.numa.policy;
+	self->numa.node = -1;
+	if (self->numa.policy != VSCALE_NUMA_POLICY_NONE) {
+		unsigned int node_count = vscale_numa_node_count();
+		if (node_count <= 1) {
+			/* Nothing to place on single-node machines */
+			self->numa.policy = VSCALE_NUMA_POLICY_NONE;
+		} else if (self->numa.policy == VSCALE_NUMA_POLICY_NODE &&
+			   !vscale_numa_node_is_online(
+				   base->config.numa.node)) {
+			ret = -EINVAL;
+			ULOGE("invalid NUMA node: %u (not online)",
+			      base->config.numa.node);
+			goto err;
+		}
+	}
+
+	/* 4:2:0 input is scaled as is, other input is scaled to I420 */
+	const struct vdef_raw_format *format = &base->config.input.format;
+	self->yuv_format = *format;
+	self->yuv_color = base->config.input.info;
+	self->chroma_sub_x = true;
+	self->chroma_sub_y = true;
+	if (vdef_raw_format_cmp(format, &i422_format) ||
+	    vdef_raw_format_cmp(format, &yuy2_format) ||
+	    vdef_raw_format_cmp(format, &uyvy_format)) {
+		self->yuv_format = vdef_i420;
+		self->chroma_sub_y = false;
+	} else if (vdef_raw_format_cmp(format, &vdef_i444)) {
+		self->yuv_format = vdef_i420;
+		self->chroma_sub_x = false;
+		self->chroma_sub_y = false;
+	} else if (vdef_raw_format_cmp(format, &vdef_bgra)) {
+		/* libyuv RGB to YUV conversion */
+		self->yuv_format = vdef_i420;
+		self->yuv_color.matrix_coefs = VDEF_MATRIX_COEFS_BT601_525;
+		self->yuv_color.full_range = false;
+		self->chroma_sub_x = false;
+		self->chroma_sub_y = false;
+		self->rgb = true;
+	} else if (!vdef_raw_format_cmp(format, &vdef_i420) &&
+		   !vdef_raw_format_cmp(format, &vdef_nv12) &&
+		   !vdef_raw_format_cmp(format, &vdef_nv21)) {
+		ret = -ENOSYS;
+		ULOGE("unsupported input format: " VDEF_RAW_FORMAT_TO_STR_FMT,
+		      VDEF_RAW_FORMAT_TO_STR_ARG(format));
+		goto err;
+	}
+
+	if (base->config.input.warp.type != VSCALE_WARP_TYPE_NONE ||
+	    base->config.input.frame_warps) {
+		ret = -ENOSYS;
+		ULOGE("input warp is not supported");
+		goto err;
+	}
+	/* Rotations and the horizontal mirror would need a scratch copy of
+	 * the scaled planes, the generic implementation writes them
+	 * oriented by blocks of rows */
+	if (base->config.output.orientation != VSCALE_ORIENTATION_NORMAL &&
+	    base->config.output.orientation != VSCALE_ORIENTATION_MIRROR_V) {
+		ret = -ENOSYS;
+		ULOGE("orientation %s is not supported",
+		      vscale_orientation_to_str(
+			      base->config.output.orientation));
+		goto err;
+	}
+	if (base->config.output.sharpen > 0.f)
+		ULOGW("sharpening is not supported, ignored");
+
+	/* Luma-only output, tensors need the chroma planes */
+	if (vdef_raw_format_cmp(&base->config.output.preferred_format,
+				&vdef_gray)) {
+		if (base->config.output.tensor.format !=
+		    VSCALE_TENSOR_FORMAT_NONE) {
+			ULOGW("gray output ignored with tensor output");
+		} else {
+			self->gray = true;
+			self->yuv_format = vdef_gray;
+			ULOGI("luma-only (gray) output");
+		}
+	}
+
+	if (vdef_raw_format_cmp(format, &yuy2_format) ||
+	    vdef_raw_format_cmp(format, &uyvy_format)) {
+		size_t size[3];
+		/* The unpacked rows are allocated once the bands are
+		 * known */
+		self->packed = true;
+		self->unpacked_info.format = i422_format;
+		self->unpacked_info.info.resolution =
+			base->config.input.info.resolution;
+		input_layout(&i422_format,
+			     &base->config.input.info.resolution,
+			     self->unpacked_info.plane_stride,
+			     size);
+	}
+
+	/* Contiguous output planes, aligned as configured */
+	ret = vscale_output_layout_compute(&base->config,
+					   &self->yuv_format,
+					   self->out_plane_stride,
+					   self->out_plane_size,
+					   &self->out_size);
+	if (ret < 0) {
+		ULOG_ERRNO("vscale_output_layout_compute", -ret);
+		goto err;
+	}
+
+	if (base->config.output.tensor.format != VSCALE_TENSOR_FORMAT_NONE) {
+		/* The tensor is converted from the scaled planes */
+		struct vscale_config tensor_config = base->config;
+		tensor_config.input.info = self->yuv_color;
+		ret = vscale_tensor_init(&self->tensor, &tensor_config);
+		if (ret < 0) {
+			ULOG_ERRNO("vscale_tensor_init", -ret);
+			goto err;
+		}
+		ULOGI("tensor output: %s",
+		      vscale_tensor_format_to_str(self->tensor.format));
+		if (base->config.output.info.matrix_coefs !=
+		    VDEF_MATRIX_COEFS_UNKNOWN)
+			ULOGW("output color matrix ignored with tensor output");
+	}
+
+	if (base->config.output.max_rois > 0) {
+		self->rois = calloc(base->config.output.max_rois,
+				    sizeof(*self->rois));
+		if (self->rois == NULL) {
+			ret = -ENOMEM;
+			ULOG_ERRNO("calloc", -ret);
+			goto err;
+		}
+	}
+
+	/* Output buffers are pooled for NUMA placement too, so that they
+	 * can be bound to the node, and for pre-warming, so that they can
+	 * be allocated in advance; they hold the tensor when enabled, and
+	 * the output frames of all the regions of interest of a frame;
+	 * a caller-supplied pool is used as is */
+	if (base->config.output.pool == NULL &&
+	    (base->config.output.mem_type != VSCALE_MEM_TYPE_GENERIC ||
+	     self->numa.policy != VSCALE_NUMA_POLICY_NONE ||
+	     base->config.prewarm)) {
+		size_t size = (self->tensor.format != VSCALE_TENSOR_FORMAT_NONE)
+				      ? self->tensor.size
+				      : self->out_size;
+		struct vscale_mem_pool_config pool_cfg = {
+			.name = base->config.name,
+			.type = base->config.output.mem_type,
+			.size = MAX(base->config.output.max_rois, 1) * size,
+			.initial_count =
+				base->config.output.preferred_min_buf_count
+					? base->config.output
+						  .preferred_min_buf_count
+					: DEFAULT_OUT_BUF_COUNT,
+			.numa_bind = (self->numa.policy ==
+				      VSCALE_NUMA_POLICY_NODE),
+			.numa_node = base->config.numa.node,
+			.prefault = base->config.prewarm,
+		};
+		/* The node is not known yet: allocate on demand */
+		if (self->numa.policy == VSCALE_NUMA_POLICY_AUTO)
+			pool_cfg.initial_count = 0;
+		ret = vscale_mem_pool_new(&pool_cfg, &self->out_pool);
+		if (ret < 0) {
+			ULOG_ERRNO("vscale_mem_pool_new", -ret);
+			goto err;
+		}
+	}
+
+	self->input_progress.timestamp = UINT64_MAX;
+	self->orientation = base->config.output.orientation;
+	self->scaled = base->config.output.info.resolution;
+
+	ret = vscale_fit_compute(base->config.output.fit_mode,
+				 &base->config.input.info.resolution,
+				 &self->scaled,
+				 &self->fit[0],
+				 &self->fit[1]);
+	if (ret < 0)
+		goto err;
+	if (base->config.output.fit_mode != VSCALE_FIT_MODE_STRETCH) {
+		const struct vscale_fit_plane *fit = &self->fit[0];
+		ULOGI("fit mode %s: %ux%u+%d+%d scaled to %ux%u+%d+%d",
+		      vscale_fit_mode_to_str(base->config.output.fit_mode),
+		      fit->crop.width,
+		      fit->crop.height,
+		      fit->crop.left,
+		      fit->crop.top,
+		      fit->content.width,
+		      fit->content.height,
+		      fit->content.left,
+		      fit->content.top);
+	}
+
+	/* The pad pixels are written with the input color properties,
+	 * before the color conversion if any */
+	vscale_rgb_to_yuv(base->config.output.pad_color,
+			  &self->yuv_color,
+			  self->pad);
+	if (vdef_raw_format_cmp(&base->config.input.format, &vdef_nv21)) {
+		uint8_t u = self->pad[1];
+		self->pad[1] = self->pad[2];
+		self->pad[2] = u;
+	}
+
+	if (self->tensor.format == VSCALE_TENSOR_FORMAT_NONE &&
+	    base->config.output.info.matrix_coefs !=
+		    VDEF_MATRIX_COEFS_UNKNOWN) {
+		ret = vscale_color_conv_init(&self->color_conv,
+					     &self->yuv_color,
+					     &base->config.output.info);
+		if (ret < 0) {
+			ULOG_ERRNO("vscale_color_conv_init", -ret);
+			goto err;
+		}
+		ULOGI("color conversion: %s %s to %s %s%s",
+		      vdef_matrix_coefs_to_str(self->yuv_color.matrix_coefs),
+		      self->yuv_color.full_range ? "full" : "limited",
+		      vdef_matrix_coefs_to_str(
+			      base->config.output.info.matrix_coefs),
+		      base->config.output.info.full_range ? "full"
+							  : "limited",
+		      self->color_conv.enabled ? "" : " (none)");
+	}
+
+	self->slice_height = self->scaled.height;
+	if (base->config.output.slice_height != 0 &&
+	    !vscale_orientation_keeps_rows(self->orientation)) {
+		ULOGW("slices are not supported with orientation %s, "
+		      "ignored",
+		      vscale_orientation_to_str(self->orientation));
+	} else if (base->config.output.slice_height != 0) {
+		unsigned int src_h = self->fit[0].crop.height;
+		self->slice_height = compute_slice_height(
+			base->config.output.slice_height,
+			src_h,
+			self->chroma_sub_y ? (src_h + 1) / 2 : src_h,
+			self->fit[0].content.height);
+		ULOGI("output slice height: %u (requested: %u)",
+		      self->slice_height,
+		      base->config.output.slice_height);
+	}
+
+	/* Packed input without regions of interest is scaled by bands of
+	 * PACKED_BAND_LINES lines at least, so that only the input rows of
+	 * a band are unpacked at once */
+	if (self->packed && base->config.output.max_rois == 0 &&
+	    self->slice_height == self->scaled.height) {
+		unsigned int src_h = self->fit[0].crop.height;
+		unsigned int dst_h = self->fit[0].content.height;
+		unsigned int period = slice_period(src_h, src_h, dst_h);
+		if (period < dst_h) {
+			self->slice_height =
+				MIN((PACKED_BAND_LINES + period - 1) / period *
+					    period,
+				    self->scaled.height);
+		}
+	}
+
+	/* Extended band rows of the bands (see band_extend()) */
+	if (self->slice_height < self->scaled.height && !self->rgb) {
+		struct vscale_fit_plane cfit;
+		unsigned int rows =
+			band_extend_max(&self->fit[0], self->slice_height);
+		self->band_scratch[0] = malloc((size_t)self->scaled.width *
+					       rows);
+		chroma_src_fit(self, self->fit, &cfit);
+		rows = band_extend_max(&cfit, self->slice_height);
+		if (!self->gray) {
+			self->band_scratch[1] =
+				malloc((size_t)2 * cfit.content.width * rows);
+		}
+		if (self->band_scratch[0] == NULL ||
+		    (!self->gray && self->band_scratch[1] == NULL)) {
+			ret = -ENOMEM;
+			ULOG_ERRNO("malloc", -ret);
+			goto err;
+		}
+	}
+
+	/* Unpacked rows of packed input: the input rows of the largest
+	 * band, or of the whole frame with regions of interest */
+	if (self->packed) {
+		const size_t *stride = self->unpacked_info.plane_stride;
+		unsigned int capacity = base->config.input.info.resolution.height;
+		size_t size[3];
+		if (base->config.output.max_rois == 0) {
+			struct band_job job = {
+				.fit = self->fit,
+				.in_info = &self->unpacked_info,
+			};
+			chroma_src_fit(self, self->fit, &job.cfit);
+			capacity = 1;
+			for (unsigned int y = 0; y < self->scaled.height;
+			     y += self->slice_height) {
+				unsigned int start, end;
+				job.y = y;
+				job.height = MIN(self->slice_height,
+						 self->scaled.height - y);
+				band_lines(&job);
+				band_input_rows(self, &job, &start, &end);
+				capacity = MAX(capacity, end - start);
+			}
+		}
+		size[0] = stride[0] * capacity;
+		size[1] = self->gray ? 0 : stride[1] * capacity;
+		size[2] = self->gray ? 0 : stride[2] * capacity;
+		self->unpacked = malloc(size[0] + size[1] + size[2]);
+		if (self->unpacked == NULL) {
+			ret = -ENOMEM;
+			ULOG_ERRNO("malloc", -ret);
+			goto err;
+		}
+		self->unpacked_planes[0] = self->unpacked;
+		self->unpacked_planes[1] = self->unpacked + size[0];
+		self->unpacked_planes[2] = self->unpacked + size[0] + size[1];
+		self->unpacked_capacity = capacity;
+	}
+
+	/* RGB scratch rows for the extended content rows of a band; the
+	 * regions of interest are scaled whole */
+	rgb_rows = (base->config.output.max_rois > 0)
+			   ? self->scaled.height
+			   : band_extend_max(&self->fit[0], self->slice_height);
+	self->ctx.tensor = &self->tensor;
+	ret = scale_ctx_init(self, &self->ctx, rgb_rows);
+	if (ret < 0)
+		goto err;
+
+	/* Scale the regions of interest concurrently on the worker
+	 * thread */
+	if (base->config.preferred_thread_count >= 2 &&
+	    base->config.output.max_rois >= 2) {
+		self->worker.ctx.tensor = &self->tensor;
+		ret = scale_ctx_init(self, &self->worker.ctx, rgb_rows);
+		if (ret < 0)
+			goto err;
+		self->worker.rois = true;
+	}
+
+	self->filter_mode = base->config.filter_mode;
+	if (self->filter_mode == VSCALE_FILTER_MODE_AUTO)
+		self->filter_mode = VSCALE_FILTER_MODE_BILINEAR;
+	self->libyuv_mode = HANDLED_FILTER_MODES[self->filter_mode];
+	self->stats.filter_mode = self->filter_mode;
+
+	self->adaptive.enabled = base->config.adaptive_filter_mode;
+	self->adaptive.last_ts_us = UINT64_MAX;
+	for (unsigned int i = 0; i < SIZEOF_ARRAY(ADAPTIVE_FILTER_MODES); i++) {
+		if (ADAPTIVE_FILTER_MODES[i] == self->filter_mode) {
+			self->adaptive.level = i;
+			self->adaptive.max_level = i;
+		}
+	}
+
+	/* Scale the chroma planes concurrently with the luma plane, and the
+	 * regions of interest concurrently with each other */
+	if (base->config.preferred_thread_count >= 2 &&
+	    (!self->gray || self->worker.rois)) {
+		ret = pthread_create(&self->worker.thread,
+				     NULL,
+				     &worker_routine,
+				     self);
+		if (ret != 0) {
+			ret = -ret;
+			ULOG_ERRNO("pthread_create", ret);
+			goto err;
+		}
+		self->worker.launched = true;
+	}
+
 	ret = pthread_create(&self->thread, NULL, &work_routine, self);
 	if (ret != 0) {
 		ret = -ret;
@@ -642,7 +2811,11 @@ static int create(struct vscale_scaler *base)
 
 	self->thread_launched = true;
 
-	self->libyuv_mode = HANDLED_FILTER_MODES[base->config.filter_mode];
+	/* Ready once the scaling thread is warmed up */
+	pthread_mutex_lock(&self->mutex);
+	while (base->config.prewarm && !self->prewarmed)
+		pthread_cond_wait(&self->cond, &self->mutex);
+	pthread_mutex_unlock(&self->mutex);
 
 	return 0;
 err:
@@ -652,6 +2825,42 @@ err:
 }
 
 
+static int get_stats(struct vscale_scaler *base, struct vscale_stats *stats)
+{
+	struct vscale_libyuv *self = base->derived;
+
+	pthread_mutex_lock(&self->mutex);
+	*stats = self->stats;
+	pthread_mutex_unlock(&self->mutex);
+
+	return 0;
+}
+
+
+static int set_input_rows(struct vscale_scaler *base,
+			  struct mbuf_raw_video_frame *frame,
+			  unsigned int rows)
+{
+	int res;
+	struct vscale_libyuv *self = base->derived;
+	struct vdef_raw_frame frame_info;
+
+	res = mbuf_raw_video_frame_get_frame_info(frame, &frame_info);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_get_frame_info", -res);
+		return res;
+	}
+
+	pthread_mutex_lock(&self->mutex);
+	self->input_progress.timestamp = frame_info.info.timestamp;
+	self->input_progress.rows = rows;
+	pthread_cond_signal(&self->cond);
+	pthread_mutex_unlock(&self->mutex);
+
+	return 0;
+}
+
+
 static struct mbuf_pool *get_input_buffer_pool(const struct vscale_scaler *base)
 {
 	return NULL;
@@ -675,4 +2884,6 @@ VSCALE_API const struct vscale_ops vscale_libyuv_ops = {
 	.destroy = destroy,
 	.get_input_buffer_pool = get_input_buffer_pool,
 	.get_input_buffer_queue = get_input_buffer_queue,
+	.get_stats = get_stats,
+	.set_input_rows = set_input_rows,
 };
@@ -29,7 +29,7 @@
 ULOG_DECLARE_TAG(ULOG_TAG);
 
 
-static const struct vscale_ops *implem_ops(enum vscale_scaler_implem implem)
+const struct vscale_ops *vscale_implem_ops(enum vscale_scaler_implem implem)
 {
 	switch (implem) {
 
@@ -48,6 +48,11 @@ static const struct vscale_ops *implem_ops(enum vscale_scaler_implem implem)
 		return &vscale_qcom_ops;
 #endif /* BUILD_LIBVIDEO_SCALE_QCOM */
 
+#ifdef BUILD_LIBVIDEO_SCALE_GENERIC
+	case VSCALE_SCALER_IMPLEM_GENERIC:
+		return &vscale_generic_ops;
+#endif /* BUILD_LIBVIDEO_SCALE_GENERIC */
+
 	default:
 		return NULL;
 	}
@@ -82,6 +87,17 @@ static int vscale_get_implem(enum vscale_scaler_implem *implem)
 	}
 #endif /* BUILD_LIBVIDEO_SCALE_QCOM */
 
+	/* Lowest priority of the static fallback order; vscale_new() selects
+	 * it before this order for the features only it supports, and the
+	 * calibration can also select it */
+#ifdef BUILD_LIBVIDEO_SCALE_GENERIC
+	if ((*implem == VSCALE_SCALER_IMPLEM_AUTO) ||
+	    (*implem == VSCALE_SCALER_IMPLEM_GENERIC)) {
+		*implem = VSCALE_SCALER_IMPLEM_GENERIC;
+		return 0;
+	}
+#endif /* BUILD_LIBVIDEO_SCALE_GENERIC */
+
 	return -ENOSYS;
 }
 
@@ -96,7 +112,7 @@ int vscale_get_supported_input_formats(enum vscale_scaler_implem implem,
 	ret = vscale_get_implem(&implem);
 	ULOG_ERRNO_RETURN_VAL_IF(ret < 0, -ret, 0);
 
-	return implem_ops(implem)->get_supported_input_formats(formats);
+	return vscale_implem_ops(implem)->get_supported_input_formats(formats);
 }
 
 
@@ -108,6 +124,7 @@ int vscale_new(struct pomp_loop *loop,
 {
 	int ret;
 	struct vscale_scaler *self;
+	size_t mesh_size;
 
 	ULOG_ERRNO_RETURN_ERR_IF(loop == NULL, EINVAL);
 	ULOG_ERRNO_RETURN_ERR_IF(config == NULL, EINVAL);
@@ -125,7 +142,9 @@ int vscale_new(struct pomp_loop *loop,
 	self->cbs = *cbs;
 	self->userdata = userdata;
 	self->config = *config;
+	self->config.input.warp.mesh = NULL;
 	self->last_timestamp = UINT64_MAX;
+	self->decimation.last_us = UINT64_MAX;
 	if (config->name) {
 		self->config.name = strdup(config->name);
 		if (self->config.name == NULL) {
@@ -135,6 +154,58 @@ int vscale_new(struct pomp_loop *loop,
 		}
 	}
 
+	ret = vscale_warp_check(&config->input.warp);
+	if (ret < 0)
+		goto error;
+	mesh_size = vscale_warp_mesh_size(&config->input.warp);
+	if (mesh_size > 0) {
+		float *mesh = malloc(mesh_size);
+		if (mesh == NULL) {
+			ret = -ENOMEM;
+			ULOG_ERRNO("malloc", -ret);
+			goto error;
+		}
+		memcpy(mesh, config->input.warp.mesh, mesh_size);
+		self->config.input.warp.mesh = mesh;
+	}
+
+	if (vdef_dim_is_null(&self->config.input.info.resolution) ||
+	    vdef_dim_is_null(&self->config.output.info.resolution)) {
+		ULOGE("invalid input or output dimensions: %ux%u -> %ux%u",
+		      self->config.input.info.resolution.width,
+		      self->config.input.info.resolution.height,
+		      self->config.output.info.resolution.width,
+		      self->config.output.info.resolution.height);
+		ret = -EINVAL;
+		goto error;
+	}
+
+	if (!(self->config.output.sharpen >= 0.f)) {
+		ULOGE("invalid sharpening strength: %f",
+		      self->config.output.sharpen);
+		ret = -EINVAL;
+		goto error;
+	}
+
+	/* Only the generic implementation supports input warps,
+	 * sharpening, rotations and the horizontal mirror */
+	if (self->config.implem == VSCALE_SCALER_IMPLEM_AUTO &&
+	    (self->config.input.warp.type != VSCALE_WARP_TYPE_NONE ||
+	     self->config.input.frame_warps ||
+	     self->config.output.sharpen > 0.f ||
+	     (self->config.output.orientation != VSCALE_ORIENTATION_NORMAL &&
+	      self->config.output.orientation !=
+		      VSCALE_ORIENTATION_MIRROR_V)))
+		self->config.implem = VSCALE_SCALER_IMPLEM_GENERIC;
+
+	/* AUTO: use the fastest implementation for this configuration,
+	 * otherwise the default one */
+	if (self->config.implem == VSCALE_SCALER_IMPLEM_AUTO) {
+		ret = vscale_calib_select(&self->config, &self->config.implem);
+		if (ret < 0)
+			self->config.implem = VSCALE_SCALER_IMPLEM_AUTO;
+	}
+
 	ret = vscale_get_implem(&self->config.implem);
 	if (ret < 0) {
 		if (ret == -ENOSYS)
@@ -142,7 +213,7 @@ int vscale_new(struct pomp_loop *loop,
 		goto error;
 	}
 
-	self->ops = implem_ops(self->config.implem);
+	self->ops = vscale_implem_ops(self->config.implem);
 	if (self->ops->get_supported_input_formats == NULL ||
 	    self->ops->create == NULL || self->ops->flush == NULL ||
 	    self->ops->stop == NULL || self->ops->destroy == NULL ||
@@ -153,17 +224,6 @@ int vscale_new(struct pomp_loop *loop,
 		goto error;
 	}
 
-	if (vdef_dim_is_null(&self->config.input.info.resolution) ||
-	    vdef_dim_is_null(&self->config.output.info.resolution)) {
-		ULOGE("invalid input or output dimensions: %ux%u -> %ux%u",
-		      self->config.input.info.resolution.width,
-		      self->config.input.info.resolution.height,
-		      self->config.output.info.resolution.width,
-		      self->config.output.info.resolution.height);
-		ret = -EINVAL;
-		goto error;
-	}
-
 	ret = self->ops->create(self);
 	if (ret < 0)
 		goto error;
@@ -205,6 +265,7 @@ int vscale_destroy(struct vscale_scaler *self)
 
 	if (ret == 0) {
 		free((void *)self->config.name);
+		free((void *)self->config.input.warp.mesh);
 		free(self);
 	}
 
@@ -229,6 +290,21 @@ vscale_get_input_buffer_queue(struct vscale_scaler *self)
 }
 
 
+int vscale_set_input_rows(struct vscale_scaler *self,
+			  struct mbuf_raw_video_frame *frame,
+			  unsigned int rows)
+{
+	ULOG_ERRNO_RETURN_ERR_IF(self == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(frame == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(!self->config.input.progressive, EINVAL);
+
+	if (self->ops->set_input_rows == NULL)
+		return -ENOSYS;
+
+	return self->ops->set_input_rows(self, frame, rows);
+}
+
+
 int vscale_get_input_buffer_constraints(
 	enum vscale_scaler_implem implem,
 	const struct vdef_raw_format *format,
@@ -243,8 +319,8 @@ int vscale_get_input_buffer_constraints(
 	ret = vscale_get_implem(&implem);
 	ULOG_ERRNO_RETURN_VAL_IF(ret < 0, -ret, 0);
 
-	if (implem_ops(implem)->get_input_buffer_constraints != NULL) {
-		return implem_ops(implem)->get_input_buffer_constraints(
+	if (vscale_implem_ops(implem)->get_input_buffer_constraints != NULL) {
+		return vscale_implem_ops(implem)->get_input_buffer_constraints(
 			format, constraints);
 	} else {
 		nb_planes = vdef_get_raw_frame_plane_count(format);
@@ -263,6 +339,35 @@ int vscale_get_input_buffer_constraints(
 }
 
 
+int vscale_get_stats(struct vscale_scaler *self, struct vscale_stats *stats)
+{
+	int ret;
+
+	ULOG_ERRNO_RETURN_ERR_IF(self == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(stats == NULL, EINVAL);
+
+	if (self->ops->get_stats == NULL)
+		return -ENOSYS;
+
+	ret = self->ops->get_stats(self, stats);
+	if (ret < 0)
+		return ret;
+	stats->decimated_count = self->decimation.count;
+
+	return 0;
+}
+
+
+bool vscale_is_decimated(struct vscale_scaler *self,
+			 struct mbuf_raw_video_frame *frame)
+{
+	ULOG_ERRNO_RETURN_VAL_IF(self == NULL, EINVAL, false);
+	ULOG_ERRNO_RETURN_VAL_IF(frame == NULL, EINVAL, false);
+
+	return self->decimation.dropped == frame;
+}
+
+
 enum vscale_scaler_implem vscale_get_used_implem(struct vscale_scaler *self)
 {
 	ULOG_ERRNO_RETURN_VAL_IF(
@@ -0,0 +1,622 @@
+/**
+ * Copyright (c) 2019 Parrot Drones SAS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Parrot Drones SAS Company nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE PARROT DRONES SAS COMPANY BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define ULOG_TAG vscale
+#include "vscale_priv.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <futils/timetools.h>
+#include <libpomp.h>
+#include <media-buffers/mbuf_mem_generic.h>
+#include <media-buffers/mbuf_raw_video_frame.h>
+
+
+/* Calibration frames: the first frames are not measured */
+#define CALIB_WARMUP_FRAMES 2
+#define CALIB_FRAMES 8
+
+/* Maximum time to wait for a frame output or the scaler stop */
+#define CALIB_TIMEOUT_MS 1000
+
+/* Number of calibration results kept in memory */
+#define CALIB_CACHE_SIZE 16
+
+/* Calibration profile file (optional): results are read from and
+ * appended to it, so that calibration only runs once per configuration */
+#define CALIB_FILE_ENV "VSCALE_CALIBRATION_FILE"
+
+/* Last implementation in enum vscale_scaler_implem */
+#define IMPLEM_LAST VSCALE_SCALER_IMPLEM_GENERIC
+
+
+/* Everything in the configuration that changes the work done per frame */
+struct calib_key {
+	char format[64];
+	char output_format[64];
+	struct vdef_dim input;
+	struct vdef_dim output;
+	enum vscale_filter_mode filter_mode;
+	bool adaptive_filter_mode;
+	enum vdef_matrix_coefs input_matrix_coefs;
+	bool input_full_range;
+	enum vdef_matrix_coefs matrix_coefs;
+	bool full_range;
+	enum vscale_orientation orientation;
+	enum vscale_fit_mode fit_mode;
+	enum vscale_tensor_format tensor_format;
+	unsigned int max_rois;
+};
+
+
+struct calib_entry {
+	struct calib_key key;
+	enum vscale_scaler_implem implem;
+};
+
+
+struct calib_run {
+	struct pomp_loop *loop;
+	unsigned int output_count;
+	int status;
+	bool stopped;
+};
+
+
+static struct {
+	pthread_mutex_t mutex;
+	struct calib_entry entries[CALIB_CACHE_SIZE];
+	unsigned int count;
+	unsigned int next;
+	bool file_loaded;
+} s_calib = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+
+static int time_monotonic_us(uint64_t *usec)
+{
+	struct timespec ts;
+	int ret;
+
+	ret = time_get_monotonic(&ts);
+	if (ret < 0) {
+		ULOG_ERRNO("time_get_monotonic", -ret);
+		return ret;
+	}
+	ret = time_timespec_to_us(&ts, usec);
+	if (ret < 0) {
+		ULOG_ERRNO("time_timespec_to_us", -ret);
+		return ret;
+	}
+	return 0;
+}
+
+
+static void format_to_word(const struct vdef_raw_format *format,
+			   char *str,
+			   size_t len)
+{
+	snprintf(str,
+		 len,
+		 VDEF_RAW_FORMAT_TO_STR_FMT,
+		 VDEF_RAW_FORMAT_TO_STR_ARG(format));
+	/* Formats are single words in the profile file */
+	for (char *c = str; *c != '\0'; c++) {
+		if (isspace((unsigned char)*c))
+			*c = '_';
+	}
+}
+
+
+static void make_key(const struct vscale_config *config,
+		     struct calib_key *key)
+{
+	memset(key, 0, sizeof(*key));
+	format_to_word(&config->input.format, key->format, sizeof(key->format));
+	format_to_word(&config->output.preferred_format,
+		       key->output_format,
+		       sizeof(key->output_format));
+	key->input = config->input.info.resolution;
+	key->output = config->output.info.resolution;
+	key->filter_mode = config->filter_mode;
+	key->adaptive_filter_mode = config->adaptive_filter_mode;
+	key->input_matrix_coefs = config->input.info.matrix_coefs;
+	key->input_full_range = config->input.info.full_range;
+	key->matrix_coefs = config->output.info.matrix_coefs;
+	key->full_range = config->output.info.full_range;
+	key->orientation = config->output.orientation;
+	key->fit_mode = config->output.fit_mode;
+	key->tensor_format = config->output.tensor.format;
+	key->max_rois = config->output.max_rois;
+}
+
+
+static bool key_equal(const struct calib_key *a, const struct calib_key *b)
+{
+	return strcmp(a->format, b->format) == 0 &&
+	       strcmp(a->output_format, b->output_format) == 0 &&
+	       vdef_dim_cmp(&a->input, &b->input) &&
+	       vdef_dim_cmp(&a->output, &b->output) &&
+	       a->filter_mode == b->filter_mode &&
+	       a->adaptive_filter_mode == b->adaptive_filter_mode &&
+	       a->input_matrix_coefs == b->input_matrix_coefs &&
+	       a->input_full_range == b->input_full_range &&
+	       a->matrix_coefs == b->matrix_coefs &&
+	       a->full_range == b->full_range &&
+	       a->orientation == b->orientation &&
+	       a->fit_mode == b->fit_mode &&
+	       a->tensor_format == b->tensor_format &&
+	       a->max_rois == b->max_rois;
+}
+
+
+/* Implementations that would ignore or reject a requested feature do not
+ * compete (warps, sharpening and orientations other than the vertical
+ * mirror already force the generic implementation, see vscale_new()) */
+static bool implem_supports(const struct vscale_config *config,
+			    enum vscale_scaler_implem implem)
+{
+	switch (implem) {
+	case VSCALE_SCALER_IMPLEM_LIBYUV:
+		return config->input.warp.type == VSCALE_WARP_TYPE_NONE &&
+		       !config->input.frame_warps &&
+		       config->output.sharpen == 0.f &&
+		       (config->output.orientation ==
+				VSCALE_ORIENTATION_NORMAL ||
+			config->output.orientation ==
+				VSCALE_ORIENTATION_MIRROR_V);
+	case VSCALE_SCALER_IMPLEM_GENERIC:
+		return !config->adaptive_filter_mode;
+	default:
+		return true;
+	}
+}
+
+
+static const struct calib_entry *cache_find_locked(const struct calib_key *key)
+{
+	for (unsigned int i = 0; i < s_calib.count; i++) {
+		if (key_equal(&s_calib.entries[i].key, key))
+			return &s_calib.entries[i];
+	}
+	return NULL;
+}
+
+
+static void cache_add_locked(const struct calib_key *key,
+			     enum vscale_scaler_implem implem)
+{
+	struct calib_entry *entry =
+		(struct calib_entry *)cache_find_locked(key);
+
+	if (entry == NULL) {
+		entry = &s_calib.entries[s_calib.next];
+		s_calib.next = (s_calib.next + 1) % CALIB_CACHE_SIZE;
+		if (s_calib.count < CALIB_CACHE_SIZE)
+			s_calib.count++;
+	}
+	entry->key = *key;
+	entry->implem = implem;
+}
+
+
+/* Profile file lines: "<format> <output_format> <w>x<h> <w>x<h>
+ * <filter_mode> <adaptive> <matrix_coefs> <orientation> <fit_mode>
+ * <tensor_format> <max_rois> <implem>"; lines in another format (e.g.
+ * from an older version) are ignored */
+static void load_file_locked(const char *path)
+{
+	FILE *f;
+	char line[256];
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		if (errno != ENOENT)
+			ULOG_ERRNO("fopen:'%s'", errno, path);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		struct calib_key key = {0};
+		char mode[32];
+		unsigned int adaptive;
+		char input_matrix[32];
+		unsigned int input_full_range;
+		char matrix[32];
+		unsigned int full_range;
+		char orientation[32];
+		char fit[32];
+		char tensor[32];
+		char implem[32];
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line,
+			   "%63s %63s %ux%u %ux%u %31s %u %31s %u %31s %u "
+			   "%31s %31s %31s %u %31s",
+			   key.format,
+			   key.output_format,
+			   &key.input.width,
+			   &key.input.height,
+			   &key.output.width,
+			   &key.output.height,
+			   mode,
+			   &adaptive,
+			   input_matrix,
+			   &input_full_range,
+			   matrix,
+			   &full_range,
+			   orientation,
+			   fit,
+			   tensor,
+			   &key.max_rois,
+			   implem) != 17)
+			continue;
+		key.filter_mode = vscale_filter_mode_from_str(mode);
+		key.adaptive_filter_mode = (adaptive != 0);
+		key.input_matrix_coefs =
+			vdef_matrix_coefs_from_str(input_matrix);
+		key.input_full_range = (input_full_range != 0);
+		key.matrix_coefs = vdef_matrix_coefs_from_str(matrix);
+		key.full_range = (full_range != 0);
+		key.orientation = vscale_orientation_from_str(orientation);
+		key.fit_mode = vscale_fit_mode_from_str(fit);
+		key.tensor_format = vscale_tensor_format_from_str(tensor);
+		cache_add_locked(&key, vscale_scaler_implem_from_str(implem));
+	}
+
+	fclose(f);
+}
+
+
+static void save_file(const char *path, const struct calib_entry *entry)
+{
+	FILE *f;
+
+	f = fopen(path, "a");
+	if (f == NULL) {
+		ULOG_ERRNO("fopen:'%s'", errno, path);
+		return;
+	}
+
+	fprintf(f,
+		"%s %s %ux%u %ux%u %s %u %s %u %s %u %s %s %s %u %s\n",
+		entry->key.format,
+		entry->key.output_format,
+		entry->key.input.width,
+		entry->key.input.height,
+		entry->key.output.width,
+		entry->key.output.height,
+		vscale_filter_mode_to_str(entry->key.filter_mode),
+		entry->key.adaptive_filter_mode ? 1 : 0,
+		vdef_matrix_coefs_to_str(entry->key.input_matrix_coefs),
+		entry->key.input_full_range ? 1 : 0,
+		vdef_matrix_coefs_to_str(entry->key.matrix_coefs),
+		entry->key.full_range ? 1 : 0,
+		vscale_orientation_to_str(entry->key.orientation),
+		vscale_fit_mode_to_str(entry->key.fit_mode),
+		vscale_tensor_format_to_str(entry->key.tensor_format),
+		entry->key.max_rois,
+		vscale_scaler_implem_to_str(entry->implem));
+
+	fclose(f);
+}
+
+
+static void calib_frame_output_cb(struct vscale_scaler *scaler,
+				  int status,
+				  struct mbuf_raw_video_frame *frame,
+				  void *userdata)
+{
+	struct calib_run *run = userdata;
+
+	run->output_count++;
+	if (status < 0)
+		run->status = status;
+}
+
+
+static void calib_stop_cb(struct vscale_scaler *scaler, void *userdata)
+{
+	struct calib_run *run = userdata;
+
+	run->stopped = true;
+}
+
+
+static int push_frame(struct vscale_scaler *scaler,
+		      const struct vscale_config *config,
+		      unsigned int index)
+{
+	int res;
+	struct mbuf_pool *pool;
+	struct mbuf_raw_video_frame_queue *queue;
+	struct mbuf_mem *mem = NULL;
+	struct mbuf_raw_video_frame *frame = NULL;
+	struct vdef_raw_frame frame_info = {0};
+	size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT] = {0};
+	size_t frame_size = 0;
+	size_t offset = 0;
+	unsigned int plane_count;
+	void *data;
+	size_t len;
+
+	frame_info.format = config->input.format;
+	frame_info.info.resolution = config->input.info.resolution;
+	frame_info.info.bit_depth = config->input.info.bit_depth;
+	frame_info.info.full_range = config->input.info.full_range;
+	frame_info.info.timestamp = index + 1;
+	frame_info.info.timescale = 1000000;
+	res = vdef_calc_raw_frame_size(&frame_info.format,
+				       &frame_info.info.resolution,
+				       frame_info.plane_stride,
+				       NULL,
+				       NULL,
+				       NULL,
+				       plane_size,
+				       NULL);
+	if (res < 0) {
+		ULOG_ERRNO("vdef_calc_raw_frame_size", -res);
+		return res;
+	}
+	plane_count = vdef_get_raw_frame_plane_count(&frame_info.format);
+	for (unsigned int i = 0; i < plane_count; i++)
+		frame_size += plane_size[i];
+
+	pool = vscale_get_input_buffer_pool(scaler);
+	if (pool != NULL)
+		res = mbuf_pool_get(pool, &mem);
+	else
+		res = mbuf_mem_generic_new(frame_size, &mem);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_mem_get", -res);
+		return res;
+	}
+	res = mbuf_mem_get_data(mem, &data, &len);
+	if (res < 0 || len < frame_size) {
+		res = (res < 0) ? res : -ENOBUFS;
+		ULOG_ERRNO("mbuf_mem_get_data", -res);
+		goto out;
+	}
+	/* Mid-gray: the content does not matter, but pages must be
+	 * touched */
+	memset(data, 0x80, frame_size);
+
+	res = mbuf_raw_video_frame_new(&frame_info, &frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_new", -res);
+		goto out;
+	}
+	for (unsigned int i = 0; i < plane_count; i++) {
+		res = mbuf_raw_video_frame_set_plane(
+			frame, i, mem, offset, plane_size[i]);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_set_plane", -res);
+			goto out;
+		}
+		offset += plane_size[i];
+	}
+	res = mbuf_raw_video_frame_finalize(frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_finalize", -res);
+		goto out;
+	}
+
+	queue = vscale_get_input_buffer_queue(scaler);
+	res = mbuf_raw_video_frame_queue_push(queue, frame);
+	if (res < 0)
+		ULOG_ERRNO("mbuf_raw_video_frame_queue_push", -res);
+
+out:
+	if (frame != NULL)
+		mbuf_raw_video_frame_unref(frame);
+	mbuf_mem_unref(mem);
+	return res;
+}
+
+
+/* Run the loop until the scaler is stopped (stop is true) or until
+ * output_count frames are output, or until the timeout expires */
+static int calib_wait(struct calib_run *run, bool stop, unsigned int count)
+{
+	uint64_t start = 0;
+	uint64_t now = 0;
+
+	time_monotonic_us(&start);
+	while (stop ? !run->stopped : run->output_count < count) {
+		pomp_loop_wait_and_process(run->loop, CALIB_TIMEOUT_MS);
+		time_monotonic_us(&now);
+		if (now - start > CALIB_TIMEOUT_MS * 1000)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+
+/* Scale CALIB_FRAMES frames with an implementation, one at a time */
+static int calibrate_implem(const struct vscale_config *config,
+			    enum vscale_scaler_implem implem,
+			    uint64_t *time_us)
+{
+	int res;
+	struct vscale_config cfg = *config;
+	struct vscale_scaler *scaler = NULL;
+	struct calib_run run = {0};
+	const struct vscale_cbs cbs = {
+		.frame_output = calib_frame_output_cb,
+		.stop = calib_stop_cb,
+	};
+	uint64_t start = 0;
+	uint64_t end = 0;
+
+	cfg.name = "vscale_calib";
+	cfg.implem = implem;
+	/* The calibration frames are complete, 1 us apart and scaled by a
+	 * throw-away scaler: no progressive input, decimation, slices, caller
+	 * pool, pre-warm, memory type nor NUMA placement */
+	cfg.input.progressive = false;
+	memset(&cfg.input.decimation, 0, sizeof(cfg.input.decimation));
+	cfg.output.slice_height = 0;
+	cfg.output.pool = NULL;
+	cfg.output.mem_type = VSCALE_MEM_TYPE_GENERIC;
+	cfg.prewarm = false;
+	memset(&cfg.numa, 0, sizeof(cfg.numa));
+	if (cfg.implem_cfg != NULL && cfg.implem_cfg->implem != implem)
+		cfg.implem_cfg = NULL;
+
+	run.loop = pomp_loop_new();
+	if (run.loop == NULL) {
+		res = -ENOMEM;
+		ULOG_ERRNO("pomp_loop_new", -res);
+		return res;
+	}
+
+	res = vscale_new(run.loop, &cfg, &cbs, &run, &scaler);
+	if (res < 0)
+		goto out;
+
+	*time_us = 0;
+	for (unsigned int i = 0; i < CALIB_WARMUP_FRAMES + CALIB_FRAMES; i++) {
+		time_monotonic_us(&start);
+		res = push_frame(scaler, &cfg, i);
+		if (res < 0)
+			goto out;
+		res = calib_wait(&run, false, i + 1);
+		if (res < 0)
+			goto out;
+		if (run.status < 0) {
+			res = run.status;
+			goto out;
+		}
+		time_monotonic_us(&end);
+		if (i >= CALIB_WARMUP_FRAMES)
+			*time_us += end - start;
+	}
+
+out:
+	if (scaler != NULL) {
+		if (vscale_stop(scaler) == 0)
+			(void)calib_wait(&run, true, 0);
+		vscale_destroy(scaler);
+	}
+	/* Process the events left by the scaler before destroying the
+	 * loop */
+	pomp_loop_idle_flush(run.loop);
+	pomp_loop_destroy(run.loop);
+	return res;
+}
+
+
+int vscale_calib_select(const struct vscale_config *config,
+			enum vscale_scaler_implem *implem)
+{
+	int res;
+	struct calib_key key;
+	const struct calib_entry *entry;
+	struct calib_entry result;
+	const char *path = getenv(CALIB_FILE_ENV);
+	enum vscale_scaler_implem candidates[IMPLEM_LAST + 1];
+	unsigned int candidate_count = 0;
+	enum vscale_scaler_implem best = VSCALE_SCALER_IMPLEM_AUTO;
+	uint64_t best_time = UINT64_MAX;
+
+	ULOG_ERRNO_RETURN_ERR_IF(config == NULL, EINVAL);
+	ULOG_ERRNO_RETURN_ERR_IF(implem == NULL, EINVAL);
+
+	make_key(config, &key);
+
+	pthread_mutex_lock(&s_calib.mutex);
+	if (!s_calib.file_loaded && path != NULL)
+		load_file_locked(path);
+	s_calib.file_loaded = true;
+	entry = cache_find_locked(&key);
+	if (entry != NULL && vscale_implem_ops(entry->implem) != NULL &&
+	    implem_supports(config, entry->implem)) {
+		*implem = entry->implem;
+		pthread_mutex_unlock(&s_calib.mutex);
+		return 0;
+	}
+	pthread_mutex_unlock(&s_calib.mutex);
+
+	/* Only the implementations supporting the input format and the
+	 * requested features compete */
+	for (int i = VSCALE_SCALER_IMPLEM_LIBYUV; i <= IMPLEM_LAST; i++) {
+		const struct vscale_ops *ops = vscale_implem_ops(i);
+		const struct vdef_raw_format *formats;
+		int count;
+		if (ops == NULL || !implem_supports(config, i))
+			continue;
+		count = ops->get_supported_input_formats(&formats);
+		if (count <= 0 ||
+		    !vdef_raw_format_intersect(
+			    &config->input.format, formats, count))
+			continue;
+		candidates[candidate_count++] = i;
+	}
+	if (candidate_count <= 1) {
+		/* Nothing to compare (not cached, this is cheap) */
+		if (candidate_count == 0)
+			return -ENOSYS;
+		*implem = candidates[0];
+		return 0;
+	}
+
+	for (unsigned int c = 0; c < candidate_count; c++) {
+		enum vscale_scaler_implem i = candidates[c];
+		uint64_t time_us = 0;
+		res = calibrate_implem(config, i, &time_us);
+		if (res < 0) {
+			ULOGI("calibration: %s: unavailable (%d)",
+			      vscale_scaler_implem_to_str(i),
+			      res);
+			continue;
+		}
+		ULOGI("calibration: %s: %" PRIu64 " us/frame",
+		      vscale_scaler_implem_to_str(i),
+		      time_us / CALIB_FRAMES);
+		if (time_us < best_time) {
+			best_time = time_us;
+			best = i;
+		}
+	}
+	if (best == VSCALE_SCALER_IMPLEM_AUTO)
+		return -ENOSYS;
+
+	result.key = key;
+	result.implem = best;
+	pthread_mutex_lock(&s_calib.mutex);
+	cache_add_locked(&key, best);
+	pthread_mutex_unlock(&s_calib.mutex);
+	if (path != NULL)
+		save_file(path, &result);
+
+	*implem = best;
+	return 0;
+}
@@ -46,4 +46,32 @@
 #	include <video-scale/vscale_qcom.h>
 #endif /* BUILD_LIBVIDEO_SCALE_QCOM */
 
+#ifdef BUILD_LIBVIDEO_SCALE_GENERIC
+#	include <video-scale/vscale_generic.h>
+#endif /* BUILD_LIBVIDEO_SCALE_GENERIC */
+
+
+/**
+ * Get the operations of an implementation.
+ * @param implem: implementation
+ * @return the implementation operations, or NULL if the implementation is
+ *         not built
+ */
+const struct vscale_ops *vscale_implem_ops(enum vscale_scaler_implem implem);
+
+
+/**
+ * Select the fastest implementation for a configuration.
+ * Each built implementation supporting the input format scales a few
+ * frames of the configuration; results are cached in memory and in the
+ * profile file set in the VSCALE_CALIBRATION_FILE environment variable,
+ * if any.
+ * @param config: scaler configuration
+ * @param implem: selected implementation (output)
+ * @return 0 on success, negative errno value in case of error
+ */
+int vscale_calib_select(const struct vscale_config *config,
+			enum vscale_scaler_implem *implem);
+
+
 #endif /* !_VSCALE_PRIV_H_ */
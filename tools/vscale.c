@@ -29,13 +29,18 @@
 ULOG_DECLARE_TAG(ULOG_TAG);
 
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <signal.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <futils/futils.h>
 #include <libpomp.h>
@@ -43,6 +48,7 @@ ULOG_DECLARE_TAG(ULOG_TAG);
 #include <media-buffers/mbuf_raw_video_frame.h>
 #include <video-raw/vraw.h>
 #include <video-scale/vscale.h>
+#include <video-scale/vscale_mem.h>
 
 
 struct vscale_prog {
@@ -52,9 +58,22 @@ struct vscale_prog {
 
 	struct vscale_scaler *scaler;
 
+	bool mmap;
+
 	struct {
 		struct vraw_reader *reader;
 		int count;
+		/* Input buffer pool (if the memory type is not generic) */
+		struct vscale_mem_pool *pool;
+		/* Memory-mapped input file (mmap mode) */
+		uint8_t *map;
+		size_t map_size;
+		size_t frame_size;
+		size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT];
+		unsigned int frame_count;
+		unsigned int index;
+		struct vdef_raw_frame frame_info;
+		struct vdef_frac framerate;
 	} in;
 
 	struct {
@@ -63,15 +82,60 @@ struct vscale_prog {
 		int count;
 		unsigned int width;
 		unsigned int height;
+		/* Memory-mapped output file (mmap mode) */
+		int fd;
+		uint8_t *map;
+		size_t map_size;
+		size_t frame_size;
+		atomic_uint map_index;
+		/* Raw tensor output file (tensor mode) */
+		bool tensor;
+		FILE *tensor_file;
+		/* Luma-only output */
+		bool gray;
 	} out;
+
+	/* In-flight window: input frames pushed to the scaler and not
+	 * output yet (max is 0 if unbounded); an input frame is done on
+	 * its first output frame (ROI output frames share the timestamp
+	 * of their input frame) or on its error */
+	struct {
+		unsigned int max;
+		unsigned int count;
+		bool has_last_ts;
+		uint64_t last_ts;
+		unsigned int warmup;
+		unsigned int steady_count;
+		uint64_t steady_start;
+		uint64_t steady_end;
+		uint64_t latency_sum;
+		uint64_t latency_min;
+		uint64_t latency_max;
+	} inflight;
 };
 
 
+/* Number of output frames ignored in steady-state statistics when the
+ * in-flight window is unbounded */
+#define STEADY_STATE_WARMUP_FRAMES 10
+
+
 atomic_bool s_stopping;
 struct pomp_loop *s_loop;
 struct vscale_prog *s_prog;
 
 
+static uint64_t time_us(void)
+{
+	struct timespec x;
+	time_get_monotonic(&x);
+	uint64_t y;
+	time_timespec_to_us(&x, &y);
+
+	return y;
+}
+
+
 static void finish_idle(void *userdata)
 {
 	int res;
@@ -93,6 +157,179 @@ static void finish_idle(void *userdata)
 }
 
 
+static int read_frame(struct vscale_prog *self,
+		      struct mbuf_raw_video_frame **ret_frame)
+{
+	int res;
+	struct mbuf_mem *mem = NULL;
+	void *data;
+	size_t size;
+	struct vraw_frame raw_frame;
+	struct mbuf_raw_video_frame *frame = NULL;
+	size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT];
+	int plane_count;
+	struct mbuf_pool *pool = NULL;
+
+	pool = vscale_get_input_buffer_pool(self->scaler);
+	if (pool) {
+		res = mbuf_pool_get(pool, &mem);
+		if (res < 0)
+			goto out;
+	} else if (self->in.pool) {
+		res = vscale_mem_pool_get(self->in.pool, &mem, NULL);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_mem_pool_get", -res);
+			goto out;
+		}
+	} else {
+		ssize_t size = vraw_reader_get_min_buf_size(self->in.reader);
+		if (size < 0) {
+			res = size;
+			ULOG_ERRNO("vraw_reader_get_min_buf_size", -res);
+			goto out;
+		}
+		res = mbuf_mem_generic_new(size, &mem);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_mem_generic_new", -res);
+			goto out;
+		}
+	}
+	res = mbuf_mem_get_data(mem, &data, &size);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_mem_get_data", -res);
+		goto out;
+	}
+
+	res = vraw_reader_frame_read(self->in.reader, data, size, &raw_frame);
+	if (res == -ENOENT) {
+		goto out;
+	} else if (res < 0) {
+		ULOG_ERRNO("vraw_reader_frame_read", -res);
+		goto out;
+	}
+
+	res = mbuf_raw_video_frame_new(&raw_frame.frame, &frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_new", -res);
+		goto out;
+	}
+
+	res = vdef_calc_raw_frame_size(&raw_frame.frame.format,
+				       &raw_frame.frame.info.resolution,
+				       NULL,
+				       NULL,
+				       NULL,
+				       NULL,
+				       plane_size,
+				       NULL);
+	if (res < 0) {
+		ULOG_ERRNO("vdef_calc_raw_frame_size", -res);
+		goto out;
+	}
+
+	plane_count = vdef_get_raw_frame_plane_count(&raw_frame.frame.format);
+	for (int i = 0; i < plane_count; i++) {
+		res = mbuf_raw_video_frame_set_plane(
+			frame,
+			i,
+			mem,
+			raw_frame.cdata[i] - (uint8_t *)data,
+			plane_size[i]);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_set_plane", -res);
+			goto out;
+		}
+	}
+
+	res = mbuf_raw_video_frame_finalize(frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_finalize", -res);
+		goto out;
+	}
+
+out:
+	if (mem)
+		mbuf_mem_unref(mem);
+	if (res < 0 && frame) {
+		mbuf_raw_video_frame_unref(frame);
+		frame = NULL;
+	}
+	*ret_frame = frame;
+	return res;
+}
+
+
+static int map_frame(struct vscale_prog *self,
+		     struct mbuf_raw_video_frame **ret_frame)
+{
+	int res;
+	struct mbuf_mem *mem = NULL;
+	struct mbuf_raw_video_frame *frame = NULL;
+	struct vdef_raw_frame frame_info;
+	size_t offset;
+	unsigned int plane_count;
+
+	if (self->in.index >= self->in.frame_count) {
+		res = -ENOENT;
+		goto out;
+	}
+
+	/* Wrap the file pages, no copy */
+	offset = (size_t)self->in.index * self->in.frame_size;
+	res = mbuf_mem_generic_wrap(self->in.map + offset,
+				    self->in.frame_size,
+				    NULL,
+				    NULL,
+				    &mem);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_mem_generic_wrap", -res);
+		goto out;
+	}
+
+	frame_info = self->in.frame_info;
+	frame_info.info.index = self->in.index;
+	frame_info.info.timestamp = (uint64_t)self->in.index *
+				    frame_info.info.timescale *
+				    self->in.framerate.den /
+				    self->in.framerate.num;
+	res = mbuf_raw_video_frame_new(&frame_info, &frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_new", -res);
+		goto out;
+	}
+
+	offset = 0;
+	plane_count = vdef_get_raw_frame_plane_count(&frame_info.format);
+	for (unsigned int i = 0; i < plane_count; i++) {
+		res = mbuf_raw_video_frame_set_plane(
+			frame, i, mem, offset, self->in.plane_size[i]);
+		if (res < 0) {
+			ULOG_ERRNO("mbuf_raw_video_frame_set_plane", -res);
+			goto out;
+		}
+		offset += self->in.plane_size[i];
+	}
+
+	res = mbuf_raw_video_frame_finalize(frame);
+	if (res < 0) {
+		ULOG_ERRNO("mbuf_raw_video_frame_finalize", -res);
+		goto out;
+	}
+
+	self->in.index++;
+
+out:
+	if (mem)
+		mbuf_mem_unref(mem);
+	if (res < 0 && frame) {
+		mbuf_raw_video_frame_unref(frame);
+		frame = NULL;
+	}
+	*ret_frame = frame;
+	return res;
+}
+
+
 static void scale_frame_idle(void *userdata)
 {
 	int res;
@@ -102,115 +339,46 @@ static void scale_frame_idle(void *userdata)
 		return;
 
 	while (!atomic_load(&s_stopping) && !self->input_finished) {
-		struct mbuf_mem *mem = 0;
-		void *data;
-		size_t size;
-		struct vraw_frame raw_frame;
-		struct mbuf_raw_video_frame *frame = 0;
-		size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT];
-		int plane_count;
-		struct mbuf_pool *pool = NULL;
+		struct mbuf_raw_video_frame *frame = NULL;
 
 		if (self->in.count == 0) {
 			self->input_finished = true;
 			break;
 		}
 
-		pool = vscale_get_input_buffer_pool(self->scaler);
-		if (pool) {
-			res = mbuf_pool_get(pool, &mem);
-			if (res < 0)
-				goto next;
-		} else {
-			ssize_t size =
-				vraw_reader_get_min_buf_size(self->in.reader);
-			if (size < 0) {
-				res = size;
-				ULOG_ERRNO("vraw_reader_get_min_buf_size",
-					   -res);
-				goto next;
-			}
-			res = mbuf_mem_generic_new(size, &mem);
-			if (res < 0) {
-				ULOG_ERRNO("mbuf_mem_generic_new", -res);
-				goto next;
-			}
-		}
-		res = mbuf_mem_get_data(mem, &data, &size);
-		if (res < 0) {
-			ULOG_ERRNO("mbuf_mem_get_data", -res);
-			goto next;
+		if (self->inflight.max > 0 &&
+		    self->inflight.count >= self->inflight.max) {
+			/* Window is full, wait for an output frame */
+			return;
 		}
 
-		res = vraw_reader_frame_read(
-			self->in.reader, data, size, &raw_frame);
+		if (self->in.map != NULL)
+			res = map_frame(self, &frame);
+		else
+			res = read_frame(self, &frame);
 		if (res == -ENOENT) {
 			self->input_finished = true;
-			mbuf_mem_unref(mem);
 			break;
 		} else if (res < 0) {
-			ULOG_ERRNO("vraw_reader_frame_read", -res);
-			goto next;
-		}
-
-		res = mbuf_raw_video_frame_new(&raw_frame.frame, &frame);
-		if (res < 0) {
-			ULOG_ERRNO("mbuf_raw_video_frame_new", -res);
-			goto next;
-		}
-
-		res = vdef_calc_raw_frame_size(&raw_frame.frame.format,
-					       &raw_frame.frame.info.resolution,
-					       NULL,
-					       NULL,
-					       NULL,
-					       NULL,
-					       plane_size,
-					       NULL);
-		if (res < 0) {
-			ULOG_ERRNO("vdef_calc_raw_frame_size", -res);
-			goto next;
-		}
-
-		plane_count =
-			vdef_get_raw_frame_plane_count(&raw_frame.frame.format);
-		for (int i = 0; i < plane_count; i++) {
-			res = mbuf_raw_video_frame_set_plane(
-				frame,
-				i,
-				mem,
-				raw_frame.cdata[i] - (uint8_t *)data,
-				plane_size[i]);
-			if (res < 0) {
-				ULOG_ERRNO("mbuf_raw_video_frame_set_plane",
-					   -res);
-				goto next;
-			}
-		}
-
-		res = mbuf_raw_video_frame_finalize(frame);
-		if (res < 0) {
-			ULOG_ERRNO("mbuf_raw_video_frame_finalize", -res);
-			goto next;
+			break;
 		}
 
 		res = mbuf_raw_video_frame_queue_push(
 			vscale_get_input_buffer_queue(self->scaler), frame);
-		if (res < 0) {
+		if (res < 0 && vscale_is_decimated(self->scaler, frame)) {
+			/* Dropped by the frame rate decimation */
+			res = 0;
+			if (self->in.count > 0)
+				self->in.count -= 1;
+		} else if (res < 0) {
 			ULOG_ERRNO("mbuf_raw_video_frame_queue_push", -res);
-			goto next;
+		} else {
+			self->inflight.count++;
+			if (self->in.count > 0)
+				self->in.count -= 1;
 		}
 
-		if (self->in.count > 0)
-			self->in.count -= 1;
-
-		/* clang-format off */
-next:
-		/* clang-format on */
-		if (frame)
-			mbuf_raw_video_frame_unref(frame);
-		if (mem)
-			mbuf_mem_unref(mem);
+		mbuf_raw_video_frame_unref(frame);
 		if (res < 0)
 			break;
 	}
@@ -237,27 +405,66 @@ static int is_suffix(const char *suffix, const char *s)
 }
 
 
-static uint64_t get_timestamp(struct mbuf_raw_video_frame *frame,
-			      const char *key)
+static int get_output_mem_cb(struct vscale_scaler *scaler,
+			     const struct vdef_raw_frame *frame_info,
+			     size_t size,
+			     struct mbuf_mem **mem,
+			     void *userdata)
 {
 	int res;
-	struct mbuf_ancillary_data *data;
-	uint64_t ts = 0;
-	const void *raw_data;
-	size_t len;
-
-	res = mbuf_raw_video_frame_get_ancillary_data(frame, key, &data);
+	struct vscale_prog *self = userdata;
+	unsigned int index;
+
+	if (size > self->out.frame_size)
+		return -EINVAL;
+
+	/* Frames are output in order: hand out the next slot of the
+	 * output file */
+	index = atomic_fetch_add(&self->out.map_index, 1);
+	if ((size_t)(index + 1) * self->out.frame_size > self->out.map_size)
+		return -ENOSPC;
+
+	res = mbuf_mem_generic_wrap(
+		self->out.map + (size_t)index * self->out.frame_size,
+		self->out.frame_size,
+		NULL,
+		NULL,
+		mem);
 	if (res < 0)
-		return 0;
+		ULOG_ERRNO("mbuf_mem_generic_wrap", -res);
+	return res;
+}
 
-	raw_data = mbuf_ancillary_data_get_buffer(data, &len);
-	if (!raw_data || len != sizeof(ts))
-		goto out;
-	memcpy(&ts, raw_data, sizeof(ts));
 
-out:
-	mbuf_ancillary_data_unref(data);
-	return ts;
+/* Tensors are written as raw planes, without header */
+static int write_tensor(struct vscale_prog *self,
+			const struct vraw_frame *raw_frame,
+			const size_t *plane_len,
+			int plane_count)
+{
+	int res;
+
+	if (self->out.tensor_file == NULL) {
+		self->out.tensor_file = fopen(self->out.file, "wb");
+		if (self->out.tensor_file == NULL) {
+			res = -errno;
+			ULOG_ERRNO("fopen:'%s'", -res, self->out.file);
+			return res;
+		}
+	}
+
+	for (int i = 0; i < plane_count; i++) {
+		if (fwrite(raw_frame->cdata[i],
+			   1,
+			   plane_len[i],
+			   self->out.tensor_file) != plane_len[i]) {
+			res = -EIO;
+			ULOG_ERRNO("fwrite", -res);
+			return res;
+		}
+	}
+
+	return 0;
 }
 
 
@@ -269,31 +476,66 @@ static void frame_output_cb(struct vscale_scaler *scaler,
 	int res;
 	struct vscale_prog *self = userdata;
 	struct vdef_raw_frame frame_info;
+	uint64_t now = time_us();
+
+	if (status < 0) {
+		ULOG_ERRNO("scaling failed", -status);
+		if (self->inflight.count > 0)
+			self->inflight.count--;
+		scale_frame_idle(self);
+		return;
+	}
 
 	res = mbuf_raw_video_frame_get_frame_info(frame, &frame_info);
 	if (res < 0) {
 		ULOG_ERRNO("mbuf_raw_video_frame_get_frame_info", -res);
+		if (self->inflight.count > 0)
+			self->inflight.count--;
+		scale_frame_idle(self);
 		return;
 	}
 
+	if (!self->inflight.has_last_ts ||
+	    frame_info.info.timestamp != self->inflight.last_ts) {
+		self->inflight.has_last_ts = true;
+		self->inflight.last_ts = frame_info.info.timestamp;
+		if (self->inflight.count > 0)
+			self->inflight.count--;
+	}
+
 	struct vraw_frame raw_frame = {
 		.frame = frame_info,
 	};
 
 	int plane_count =
 		vdef_get_raw_frame_plane_count(&raw_frame.frame.format);
+	size_t plane_len[VDEF_RAW_MAX_PLANE_COUNT] = {0};
 
 	int i;
 	for (i = 0; i < plane_count; i++) {
-		size_t len;
 		res = mbuf_raw_video_frame_get_plane(
-			frame, i, (const void **)&raw_frame.cdata[i], &len);
+			frame,
+			i,
+			(const void **)&raw_frame.cdata[i],
+			&plane_len[i]);
 		if (res < 0) {
 			ULOG_ERRNO("mbuf_raw_video_frame_get_plane", -res);
 			goto out;
 		}
 	}
 
+	if (self->out.tensor) {
+		res = write_tensor(self, &raw_frame, plane_len, plane_count);
+		if (res < 0)
+			goto out;
+		goto written;
+	}
+
+	if (self->out.map != NULL) {
+		/* The frame has been scaled in place in the output file */
+		goto written;
+	}
+
 	if (!self->out.writer) {
 		struct vraw_writer_config writer_cfg = {
 			.y4m = is_suffix(".y4m", self->out.file),
@@ -321,22 +563,46 @@ static void frame_output_cb(struct vscale_scaler *scaler,
 		ULOG_ERRNO("vraw_writer_frame_write", -res);
 		goto out;
 	}
+
+written:
 	self->out.count += 1;
 
 	{
-		uint64_t input_time =
-			get_timestamp(frame, VSCALE_ANCILLARY_KEY_INPUT_TIME);
-		uint64_t dequeue_time =
-			get_timestamp(frame, VSCALE_ANCILLARY_KEY_DEQUEUE_TIME);
-		uint64_t output_time =
-			get_timestamp(frame, VSCALE_ANCILLARY_KEY_OUTPUT_TIME);
+		struct vscale_timestamps ts = {0};
+		(void)vscale_frame_get_timestamps(frame, &ts);
 
 		ULOGI("scaled frame #%u (dequeue: %.2f ms, scale: %.2f ms"
 		      " overall: %.2f ms)",
 		      frame_info.info.index,
-		      (float)(dequeue_time - input_time) / 1000.,
-		      (float)(output_time - dequeue_time) / 1000.,
-		      (float)(output_time - input_time) / 1000.);
+		      (float)(ts.dequeue_time - ts.input_time) / 1000.,
+		      (float)(ts.output_time - ts.dequeue_time) / 1000.,
+		      (float)(ts.output_time - ts.input_time) / 1000.);
+
+		struct vscale_timings timings;
+		if (vscale_frame_get_timings(frame, &timings) == 0) {
+			for (unsigned int k = 0; k < VSCALE_STAGE_COUNT; k++) {
+				ULOGI("  %-8s wall: %.3f ms, cpu: %.3f ms",
+				      vscale_stage_to_str(k),
+				      (float)timings.stage[k].wall_time / 1000.,
+				      (float)timings.stage[k].cpu_time / 1000.);
+			}
+		}
+
+		/* Steady-state statistics, once the pipeline is filled */
+		if ((unsigned int)self->out.count == self->inflight.warmup) {
+			self->inflight.steady_start = now;
+		} else if ((unsigned int)self->out.count >
+			   self->inflight.warmup) {
+			uint64_t latency = now - ts.input_time;
+			self->inflight.steady_end = now;
+			self->inflight.steady_count++;
+			self->inflight.latency_sum += latency;
+			if (self->inflight.steady_count == 1 ||
+			    latency < self->inflight.latency_min)
+				self->inflight.latency_min = latency;
+			if (latency > self->inflight.latency_max)
+				self->inflight.latency_max = latency;
+		}
 	}
 out:
 	for (i--; 0 <= i; i--)
@@ -394,6 +660,27 @@ static void sighandler(int sig)
 
 enum args_id {
 	ARGS_ID_IMPLEM = 256,
+	ARGS_ID_MMAP,
+	ARGS_ID_INFLIGHT,
+	ARGS_ID_ADAPTIVE,
+	ARGS_ID_MEM,
+	ARGS_ID_NUMA,
+	ARGS_ID_THREADS,
+	ARGS_ID_ORIENTATION,
+	ARGS_ID_FIT,
+	ARGS_ID_PAD,
+	ARGS_ID_MATRIX,
+	ARGS_ID_FULL_RANGE,
+	ARGS_ID_TENSOR,
+	ARGS_ID_MEAN,
+	ARGS_ID_SCALE,
+	ARGS_ID_FPS,
+	ARGS_ID_KEEP_ONE_IN,
+	ARGS_ID_MIN_INTERVAL,
+	ARGS_ID_PREWARM,
+	ARGS_ID_GRAY,
+	ARGS_ID_SHARPEN,
+	ARGS_ID_TIMINGS,
 };
 
 
@@ -408,10 +695,206 @@ static const struct option long_options[] = {
 	{"count", required_argument, NULL, 'n'},
 	{"format", required_argument, NULL, 'f'},
 	{"mode", required_argument, NULL, 'm'},
+	{"mmap", no_argument, NULL, ARGS_ID_MMAP},
+	{"inflight", required_argument, NULL, ARGS_ID_INFLIGHT},
+	{"adaptive", no_argument, NULL, ARGS_ID_ADAPTIVE},
+	{"mem", required_argument, NULL, ARGS_ID_MEM},
+	{"numa", required_argument, NULL, ARGS_ID_NUMA},
+	{"threads", required_argument, NULL, ARGS_ID_THREADS},
+	{"orientation", required_argument, NULL, ARGS_ID_ORIENTATION},
+	{"fit", required_argument, NULL, ARGS_ID_FIT},
+	{"pad", required_argument, NULL, ARGS_ID_PAD},
+	{"matrix", required_argument, NULL, ARGS_ID_MATRIX},
+	{"full-range", no_argument, NULL, ARGS_ID_FULL_RANGE},
+	{"tensor", required_argument, NULL, ARGS_ID_TENSOR},
+	{"mean", required_argument, NULL, ARGS_ID_MEAN},
+	{"scale", required_argument, NULL, ARGS_ID_SCALE},
+	{"fps", required_argument, NULL, ARGS_ID_FPS},
+	{"keep-one-in", required_argument, NULL, ARGS_ID_KEEP_ONE_IN},
+	{"min-interval", required_argument, NULL, ARGS_ID_MIN_INTERVAL},
+	{"prewarm", no_argument, NULL, ARGS_ID_PREWARM},
+	{"gray", no_argument, NULL, ARGS_ID_GRAY},
+	{"sharpen", required_argument, NULL, ARGS_ID_SHARPEN},
+	{"timings", no_argument, NULL, ARGS_ID_TIMINGS},
 	{0, 0, 0, 0},
 };
 
 
+static int calc_frame_size(const struct vdef_raw_format *format,
+			   const struct vdef_dim *resolution,
+			   size_t *plane_stride,
+			   size_t *plane_size,
+			   size_t *frame_size)
+{
+	int res;
+	unsigned int plane_count;
+
+	res = vdef_calc_raw_frame_size(format,
+				       resolution,
+				       plane_stride,
+				       NULL,
+				       NULL,
+				       NULL,
+				       plane_size,
+				       NULL);
+	if (res < 0) {
+		ULOG_ERRNO("vdef_calc_raw_frame_size", -res);
+		return res;
+	}
+
+	*frame_size = 0;
+	plane_count = vdef_get_raw_frame_plane_count(format);
+	for (unsigned int i = 0; i < plane_count; i++)
+		*frame_size += plane_size[i];
+
+	return 0;
+}
+
+
+static int map_input(struct vscale_prog *self,
+		     const char *file,
+		     const struct vraw_reader_config *reader_cfg)
+{
+	int res;
+	int fd;
+	struct stat st;
+	void *map;
+
+	self->in.frame_info.format = reader_cfg->format;
+	self->in.frame_info.info.resolution = reader_cfg->info.resolution;
+	self->in.frame_info.info.timescale = 1000000;
+	self->in.framerate = reader_cfg->info.framerate;
+	if (self->in.framerate.num == 0 || self->in.framerate.den == 0)
+		self->in.framerate = (struct vdef_frac){30, 1};
+	res = calc_frame_size(&reader_cfg->format,
+			      &reader_cfg->info.resolution,
+			      self->in.frame_info.plane_stride,
+			      self->in.plane_size,
+			      &self->in.frame_size);
+	if (res < 0)
+		return res;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		res = -errno;
+		ULOG_ERRNO("open:'%s'", -res, file);
+		return res;
+	}
+	if (fstat(fd, &st) < 0) {
+		res = -errno;
+		ULOG_ERRNO("fstat", -res);
+		goto out;
+	}
+	self->in.frame_count = st.st_size / self->in.frame_size;
+	if (self->in.frame_count == 0) {
+		res = -ENODATA;
+		ULOGE("input file is smaller than one frame");
+		goto out;
+	}
+	self->in.map_size = (size_t)self->in.frame_count * self->in.frame_size;
+
+	map = mmap(NULL, self->in.map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		res = -errno;
+		ULOG_ERRNO("mmap", -res);
+		goto out;
+	}
+	(void)madvise(map, self->in.map_size, MADV_SEQUENTIAL);
+	self->in.map = map;
+	res = 0;
+
+out:
+	/* The mapping remains valid after closing the file */
+	close(fd);
+	return res;
+}
+
+
+static int map_output(struct vscale_prog *self,
+		      const struct vdef_raw_format *format,
+		      unsigned int frame_count)
+{
+	int res;
+	void *map;
+	size_t plane_stride[VDEF_RAW_MAX_PLANE_COUNT];
+	size_t plane_size[VDEF_RAW_MAX_PLANE_COUNT];
+	struct vdef_dim resolution = {
+		.width = self->out.width,
+		.height = self->out.height,
+	};
+
+	res = calc_frame_size(format,
+			      &resolution,
+			      plane_stride,
+			      plane_size,
+			      &self->out.frame_size);
+	if (res < 0)
+		return res;
+	self->out.map_size = (size_t)frame_count * self->out.frame_size;
+
+	self->out.fd = open(self->out.file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (self->out.fd < 0) {
+		res = -errno;
+		ULOG_ERRNO("open:'%s'", -res, self->out.file);
+		return res;
+	}
+	if (ftruncate(self->out.fd, self->out.map_size) < 0) {
+		res = -errno;
+		ULOG_ERRNO("ftruncate", -res);
+		return res;
+	}
+
+	map = mmap(NULL,
+		   self->out.map_size,
+		   PROT_READ | PROT_WRITE,
+		   MAP_SHARED,
+		   self->out.fd,
+		   0);
+	if (map == MAP_FAILED) {
+		res = -errno;
+		ULOG_ERRNO("mmap", -res);
+		return res;
+	}
+	self->out.map = map;
+
+	return 0;
+}
+
+
+static void unmap_files(struct vscale_prog *self)
+{
+	if (self->in.map != NULL) {
+		munmap(self->in.map, self->in.map_size);
+		self->in.map = NULL;
+	}
+
+	if (self->out.map != NULL) {
+		munmap(self->out.map, self->out.map_size);
+		self->out.map = NULL;
+	}
+	if (self->out.fd >= 0) {
+		/* Trim the pre-sized file to the slots handed out: the
+		 * frames are scaled in place in their slot, the slots of the
+		 * failed frames are left zero-filled */
+		unsigned int slots = atomic_load(&self->out.map_index);
+		if (self->out.frame_size > 0 &&
+		    slots > self->out.map_size / self->out.frame_size)
+			slots = self->out.map_size / self->out.frame_size;
+		if (slots > (unsigned int)self->out.count) {
+			ULOGW("%u output frame(s) failed, "
+			      "left zero-filled in '%s'",
+			      slots - (unsigned int)self->out.count,
+			      self->out.file);
+		}
+		if (ftruncate(self->out.fd,
+			      (size_t)slots * self->out.frame_size) < 0)
+			ULOG_ERRNO("ftruncate", errno);
+		close(self->out.fd);
+		self->out.fd = -1;
+	}
+}
+
+
 static void welcome(char *prog_name)
 {
 	printf("\n%s - Video scaling program\n"
@@ -445,23 +928,79 @@ static void usage(char *prog_name)
 	       "  -m | --mode <mode>                 "
 		       "Filtering mode (\"AUTO\", \"NONE\", \"LINEAR\", "
 		       "\"BILINEAR\" or \"BOX\"; optional, defaults to AUTO)\n"
+	       "       --mmap                        "
+		       "Memory-map raw YUV input and output files "
+		       "(zero-copy; ignored for *.y4m files)\n"
+	       "       --inflight <n>                "
+		       "Maximum number of frames between push and output "
+		       "(optional, defaults to unbounded)\n"
+	       "       --adaptive                    "
+		       "Lower the filtering mode when scaling is slower "
+		       "than the frame rate\n"
+	       "       --mem <type>                  "
+		       "Input and output buffers memory type (\"GENERIC\", "
+		       "\"MEMFD\" or \"HUGE_PAGES\"; optional, defaults "
+		       "to GENERIC)\n"
+	       "       --numa <node>                 "
+		       "NUMA node of the scaling thread and output buffers "
+		       "(node number or \"AUTO\" to follow the input "
+		       "buffers; optional)\n"
+	       "       --threads <n>                 "
+		       "Scaling thread count (2 or more scales the luma "
+		       "and chroma planes concurrently; optional)\n"
+	       "       --orientation <orientation>   "
+		       "Output orientation (\"NORMAL\", \"ROTATE_90\", "
+		       "\"ROTATE_180\", \"ROTATE_270\", \"MIRROR_H\" or "
+		       "\"MIRROR_V\"; optional, defaults to NORMAL; the output "
+		       "dimensions are the rotated ones)\n"
+	       "       --fit <mode>                  "
+		       "Fit mode when the aspect ratios differ (\"STRETCH\", "
+		       "\"FIT\" or \"FILL\"; optional, defaults to "
+		       "STRETCH)\n"
+	       "       --pad <color>                 "
+		       "Pad color in FIT mode as 0xRRGGBB (optional, "
+		       "defaults to black)\n"
+	       "       --matrix <matrix>             "
+		       "Output color matrix (e.g. \"BT709\"; optional, the "
+		       "output is converted from the BT.601 limited range "
+		       "input if set)\n"
+	       "       --full-range                  "
+		       "Full range output (only used with --matrix)\n"
+	       "       --tensor <format>             "
+		       "Tensor output (\"RGB8\", \"RGB8_PLANAR\", "
+		       "\"RGB_F16_PLANAR\" or \"RGB_F32_PLANAR\"; optional, "
+		       "written as raw planes)\n"
+	       "       --mean <r,g,b>                "
+		       "Float tensors per-channel mean (optional)\n"
+	       "       --scale <r,g,b>               "
+		       "Float tensors per-channel scale (optional, "
+		       "e.g. 1/std)\n"
+	       "       --fps <num[/den]>             "
+		       "Output frame rate, input frames are dropped before "
+		       "scaling (optional)\n"
+	       "       --keep-one-in <n>             "
+		       "Only scale one input frame in every n (optional)\n"
+	       "       --min-interval <us>           "
+		       "Minimum interval between the scaled frames "
+		       "timestamps in microseconds (optional)\n"
+	       "       --prewarm                     "
+		       "Allocate the buffers and scale a dummy frame before "
+		       "the first frame\n"
+	       "       --gray                        "
+		       "Luma-only output, written as a single-plane gray "
+		       "frame\n"
+	       "       --sharpen <strength>          "
+		       "Output luma sharpening strength (optional, "
+		       "e.g. 0.5)\n"
+	       "       --timings                     "
+		       "Log the wall and CPU time of each scaling stage "
+		       "of the frames\n"
 	       "\n",
 	       prog_name);
 	/* clang-format on */
 }
 
 
-static uint64_t time_us(void)
-{
-	struct timespec x;
-	time_get_monotonic(&x);
-	uint64_t y;
-	time_timespec_to_us(&x, &y);
-
-	return y;
-}
-
-
 int main(int argc, char **argv)
 {
 	int res = 0;
@@ -475,6 +1014,7 @@ int main(int argc, char **argv)
 	const struct vdef_raw_format *formats;
 	struct vscale_config scaler_cfg = {0};
 	struct vscale_input_buffer_constraints constraints;
+	struct vscale_stats stats;
 
 	atomic_init(&s_stopping, false);
 
@@ -484,6 +1024,8 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 	s_prog->in.count = -1;
+	s_prog->out.fd = -1;
+	atomic_init(&s_prog->out.map_index, 0);
 
 	welcome(argv[0]);
 
@@ -536,6 +1078,120 @@ int main(int argc, char **argv)
 				vscale_filter_mode_from_str(optarg);
 			break;
 
+		case ARGS_ID_MMAP:
+			s_prog->mmap = true;
+			break;
+
+		case ARGS_ID_INFLIGHT:
+			sscanf(optarg, "%u", &s_prog->inflight.max);
+			break;
+
+		case ARGS_ID_ADAPTIVE:
+			scaler_cfg.adaptive_filter_mode = true;
+			break;
+
+		case ARGS_ID_MEM:
+			scaler_cfg.output.mem_type =
+				vscale_mem_type_from_str(optarg);
+			break;
+
+		case ARGS_ID_NUMA:
+			if (sscanf(optarg, "%u", &scaler_cfg.numa.node) == 1) {
+				scaler_cfg.numa.policy =
+					VSCALE_NUMA_POLICY_NODE;
+			} else {
+				scaler_cfg.numa.policy =
+					vscale_numa_policy_from_str(optarg);
+			}
+			break;
+
+		case ARGS_ID_THREADS:
+			sscanf(optarg,
+			       "%u",
+			       &scaler_cfg.preferred_thread_count);
+			break;
+
+		case ARGS_ID_ORIENTATION:
+			scaler_cfg.output.orientation =
+				vscale_orientation_from_str(optarg);
+			break;
+
+		case ARGS_ID_FIT:
+			scaler_cfg.output.fit_mode =
+				vscale_fit_mode_from_str(optarg);
+			break;
+
+		case ARGS_ID_PAD:
+			scaler_cfg.output.pad_color = strtoul(optarg, NULL, 16);
+			break;
+
+		case ARGS_ID_MATRIX:
+			scaler_cfg.output.info.matrix_coefs =
+				vdef_matrix_coefs_from_str(optarg);
+			break;
+
+		case ARGS_ID_FULL_RANGE:
+			scaler_cfg.output.info.full_range = true;
+			break;
+
+		case ARGS_ID_TENSOR:
+			scaler_cfg.output.tensor.format =
+				vscale_tensor_format_from_str(optarg);
+			s_prog->out.tensor = (scaler_cfg.output.tensor.format !=
+					      VSCALE_TENSOR_FORMAT_NONE);
+			break;
+
+		case ARGS_ID_MEAN:
+			sscanf(optarg,
+			       "%f,%f,%f",
+			       &scaler_cfg.output.tensor.mean[0],
+			       &scaler_cfg.output.tensor.mean[1],
+			       &scaler_cfg.output.tensor.mean[2]);
+			break;
+
+		case ARGS_ID_SCALE:
+			sscanf(optarg,
+			       "%f,%f,%f",
+			       &scaler_cfg.output.tensor.scale[0],
+			       &scaler_cfg.output.tensor.scale[1],
+			       &scaler_cfg.output.tensor.scale[2]);
+			break;
+
+		case ARGS_ID_FPS:
+			scaler_cfg.input.decimation.framerate.den = 1;
+			sscanf(optarg,
+			       "%u/%u",
+			       &scaler_cfg.input.decimation.framerate.num,
+			       &scaler_cfg.input.decimation.framerate.den);
+			break;
+
+		case ARGS_ID_KEEP_ONE_IN:
+			scaler_cfg.input.decimation.keep_one_in =
+				atoi(optarg);
+			break;
+
+		case ARGS_ID_MIN_INTERVAL:
+			scaler_cfg.input.decimation.min_interval_us =
+				strtoull(optarg, NULL, 10);
+			break;
+
+		case ARGS_ID_PREWARM:
+			scaler_cfg.prewarm = true;
+			break;
+
+		case ARGS_ID_GRAY:
+			scaler_cfg.output.preferred_format = vdef_gray;
+			s_prog->out.gray = true;
+			break;
+
+		case ARGS_ID_SHARPEN:
+			scaler_cfg.output.sharpen = strtof(optarg, NULL);
+			break;
+
+		case ARGS_ID_TIMINGS:
+			scaler_cfg.timings = true;
+			break;
+
 		default:
 			usage(argv[0]);
 			exit(EXIT_FAILURE);
@@ -599,17 +1255,90 @@ int main(int argc, char **argv)
 	scaler_cfg.input.format = reader_cfg.format;
 	scaler_cfg.input.info.resolution = reader_cfg.info.resolution;
 
+	if (s_prog->mmap && !reader_cfg.y4m) {
+		bool aligned = false;
+		unsigned int plane_count =
+			vdef_get_raw_frame_plane_count(&reader_cfg.format);
+		for (unsigned int i = 0; i < plane_count; i++) {
+			if (constraints.plane_stride_align[i] > 1 ||
+			    constraints.plane_scanline_align[i] > 1 ||
+			    constraints.plane_size_align[i] > 1)
+				aligned = true;
+		}
+		if (aligned) {
+			ULOGW("input buffer alignment constraints, "
+			      "mmap disabled for input");
+		} else {
+			res = map_input(s_prog, input_file, &reader_cfg);
+			if (res < 0)
+				goto out;
+		}
+	}
+
+	/* The output frame count is only known without decimation */
+	if (s_prog->mmap && !is_suffix(".y4m", s_prog->out.file) &&
+	    !s_prog->out.tensor &&
+	    scaler_cfg.input.decimation.framerate.num == 0 &&
+	    scaler_cfg.input.decimation.keep_one_in <= 1 &&
+	    scaler_cfg.input.decimation.min_interval_us == 0) {
+		unsigned int frame_count = s_prog->in.frame_count;
+		if (s_prog->in.count > 0 &&
+		    (frame_count == 0 ||
+		     (unsigned int)s_prog->in.count < frame_count))
+			frame_count = s_prog->in.count;
+		if (frame_count == 0) {
+			ULOGW("unknown frame count, "
+			      "mmap disabled for output");
+		} else {
+			/* Input other than 4:2:0 is scaled to I420 */
+			const struct vdef_raw_format *out_format =
+				&scaler_cfg.input.format;
+			if (s_prog->out.gray)
+				out_format = &vdef_gray;
+			else if (!vdef_raw_format_cmp(out_format, &vdef_i420) &&
+				 !vdef_raw_format_cmp(out_format, &vdef_nv12) &&
+				 !vdef_raw_format_cmp(out_format, &vdef_nv21))
+				out_format = &vdef_i420;
+			res = map_output(s_prog, out_format, frame_count);
+			if (res < 0)
+				goto out;
+		}
+	}
+
+	if (scaler_cfg.output.mem_type != VSCALE_MEM_TYPE_GENERIC &&
+	    s_prog->in.map == NULL) {
+		ssize_t size = vraw_reader_get_min_buf_size(s_prog->in.reader);
+		if (size < 0) {
+			res = size;
+			ULOG_ERRNO("vraw_reader_get_min_buf_size", -res);
+			goto out;
+		}
+		res = vscale_mem_pool_new(
+			&(struct vscale_mem_pool_config){
+				.name = "vscale_input",
+				.type = scaler_cfg.output.mem_type,
+				.size = size,
+			},
+			&s_prog->in.pool);
+		if (res < 0) {
+			ULOG_ERRNO("vscale_mem_pool_new", -res);
+			goto out;
+		}
+	}
+
 	printf("Scaling file '%s' to file '%s'\n"
 	       "Input: %ux%u\n"
 	       "Output: %ux%u\n"
-	       "Filter mode: %s\n\n",
+	       "Filter mode: %s\n"
+	       "Memory type: %s\n\n",
 	       input_file,
 	       s_prog->out.file,
 	       scaler_cfg.input.info.resolution.width,
 	       scaler_cfg.input.info.resolution.height,
 	       scaler_cfg.output.info.resolution.width,
 	       scaler_cfg.output.info.resolution.height,
-	       vscale_filter_mode_to_str(scaler_cfg.filter_mode));
+	       vscale_filter_mode_to_str(scaler_cfg.filter_mode),
+	       vscale_mem_type_to_str(scaler_cfg.output.mem_type));
 
 	nb_formats =
 		vscale_get_supported_input_formats(scaler_cfg.implem, &formats);
@@ -632,6 +1361,9 @@ int main(int argc, char **argv)
 			 &scaler_cfg,
 			 &(struct vscale_cbs){
 				 .frame_output = frame_output_cb,
+				 .get_output_mem = s_prog->out.map != NULL
+							   ? get_output_mem_cb
+							   : NULL,
 				 .flush = flush_cb,
 				 .stop = stop_cb,
 			 },
@@ -644,6 +1376,11 @@ int main(int argc, char **argv)
 
 	signal(SIGINT, sighandler);
 
+	/* Skip the pipeline fill-up in steady-state statistics */
+	s_prog->inflight.warmup = (s_prog->inflight.max > 0)
+					  ? 2 * s_prog->inflight.max
+					  : STEADY_STATE_WARMUP_FRAMES;
+
 	start_time = time_us();
 
 	res = pomp_loop_idle_add(s_loop, &scale_frame_idle, s_prog);
@@ -660,14 +1397,50 @@ int main(int argc, char **argv)
 	printf("\nOverall time: %.2fs / %.2ffps\n",
 	       (float)(end_time - start_time) / 1000000.,
 	       s_prog->out.count * 1000000. / (float)(end_time - start_time));
+
+	if (s_prog->inflight.max > 0)
+		printf("In-flight window: %u frames\n", s_prog->inflight.max);
+	else
+		printf("In-flight window: unbounded\n");
+	if (s_prog->inflight.steady_count > 0 &&
+	    s_prog->inflight.steady_end > s_prog->inflight.steady_start) {
+		printf("Steady state: %.2ffps, latency avg: %.2fms "
+		       "min: %.2fms max: %.2fms (%u frames)\n",
+		       s_prog->inflight.steady_count * 1000000. /
+			       (float)(s_prog->inflight.steady_end -
+				       s_prog->inflight.steady_start),
+		       (float)s_prog->inflight.latency_sum /
+			       s_prog->inflight.steady_count / 1000.,
+		       (float)s_prog->inflight.latency_min / 1000.,
+		       (float)s_prog->inflight.latency_max / 1000.,
+		       s_prog->inflight.steady_count);
+	} else {
+		printf("Steady state: not reached\n");
+	}
+
+	if (vscale_get_stats(s_prog->scaler, &stats) == 0) {
+		printf("Scaling time: %.2fms, filter mode: %s "
+		       "(%u changes)\n",
+		       (float)stats.scale_time_us / 1000.,
+		       vscale_filter_mode_to_str(stats.filter_mode),
+		       stats.filter_mode_changes);
+		if (stats.decimated_count > 0) {
+			printf("Decimated frames: %" PRIu64 "\n",
+			       stats.decimated_count);
+		}
+	}
 out:
 	if (s_prog) {
 		vraw_writer_destroy(s_prog->out.writer);
+		if (s_prog->out.tensor_file != NULL)
+			fclose(s_prog->out.tensor_file);
 		if (s_prog->scaler)
 			vscale_destroy(s_prog->scaler);
 		if (s_loop)
 			pomp_loop_destroy(s_loop);
 		vraw_reader_destroy(s_prog->in.reader);
+		vscale_mem_pool_destroy(s_prog->in.pool);
+		unmap_files(s_prog);
 		free(s_prog);
 	}
 